@@ -0,0 +1,348 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Cost of the vdpram recovery paths. vdpram_tty_write() and
+ * vdpram_tty_read() move count messages of size bytes over a pty (the
+ * device opened in emulated mode, a thread on the master side) once per
+ * fault spec, and report throughput, per-call latency and what the
+ * retry/error paths did. Needs an ENABLE_FAULT_INJECTION build.
+ *
+ *	vdpram-bench-fault [-n count] [-s size] [spec ...]
+ *
+ * Without specs a built-in sweep runs; every spec gets "seed=1," in
+ * front unless it sets a seed. The retry paths log to stderr, so
+ * 2>/dev/null keeps the table readable.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "vdpram.h"
+#include "vdpram_fault.h"
+
+#define BENCH_READ_CHUNK	512
+#define BENCH_IDLE_MS		500
+
+static const char *default_specs[] = {
+	"",
+	"write.eagain=0.01",
+	"write.eagain=0.1",
+	"write.eagain=0.5",
+	"write.ebusy=0.1",
+	"write.short=0.1",
+	"write.eio=0.001",
+	"write.eio=0.01",
+	"read.eagain=0.1",
+	"read.short=0.1",
+	"read.eio=0.01",
+	NULL
+};
+
+struct peer {
+	int fd;					/* pty master */
+	unsigned long long bytes;
+	unsigned long long want;
+	unsigned int size;
+	unsigned int count;
+};
+
+struct result {
+	unsigned long calls;
+	unsigned long failed;		/* calls that returned less than asked, or -1 */
+	unsigned long long bytes;	/* accepted by vdpram_tty_write / returned by read */
+	unsigned long long lost;	/* write: handed in but never accepted */
+	double elapsed_s;
+	double *lat_us;
+	struct vdpram_io_stats io;
+};
+
+static double __now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int __cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* master side of the write run: swallow everything until idle */
+static void *__drain(void *arg)
+{
+	struct peer *p = arg;
+	struct pollfd pfd;
+	char buf[4096];
+	ssize_t n;
+
+	pfd.fd = p->fd;
+	pfd.events = POLLIN;
+
+	while (poll(&pfd, 1, BENCH_IDLE_MS) > 0) {
+		n = read(p->fd, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		p->bytes += n;
+	}
+
+	return NULL;
+}
+
+/* master side of the read run: produce count messages */
+static void *__feed(void *arg)
+{
+	struct peer *p = arg;
+	char *msg;
+	unsigned int i;
+	ssize_t n;
+	size_t off;
+
+	msg = malloc(p->size);
+	if (!msg)
+		return NULL;
+	memset(msg, 'A', p->size);
+
+	for (i = 0; i < p->count; i++) {
+		for (off = 0; off < p->size; off += n) {
+			n = write(p->fd, msg + off, p->size - off);
+			if (n <= 0)
+				goto out;
+		}
+	}
+
+out:
+	free(msg);
+	return NULL;
+}
+
+static void __run_write(int fd, struct peer *p, struct result *r)
+{
+	pthread_t thread;
+	char *msg;
+	double t0;
+	double t;
+	unsigned int i;
+	int ret;
+
+	msg = malloc(p->size);
+	memset(msg, 'a', p->size);
+
+	p->bytes = 0;
+	pthread_create(&thread, NULL, __drain, p);
+
+	t0 = __now_us();
+	for (i = 0; i < p->count; i++) {
+		t = __now_us();
+		ret = vdpram_tty_write(fd, msg, p->size);
+		r->lat_us[r->calls++] = __now_us() - t;
+
+		if (ret > 0)
+			r->bytes += ret;
+		if (ret < (int)p->size) {
+			r->failed++;
+			r->lost += p->size - (ret > 0 ? ret : 0);
+		}
+	}
+	r->elapsed_s = (__now_us() - t0) / 1e6;
+
+	pthread_join(thread, NULL);
+
+	/* what the write path claims must have arrived */
+	if (p->bytes != r->bytes)
+		fprintf(stderr, "write: %llu accepted, %llu arrived\n", r->bytes, p->bytes);
+
+	free(msg);
+}
+
+static void __run_read(int fd, struct peer *p, struct result *r, unsigned long max_calls)
+{
+	pthread_t thread;
+	struct pollfd pfd;
+	char buf[BENCH_READ_CHUNK];
+	unsigned long long want = (unsigned long long)p->count * p->size;
+	double t0;
+	double t;
+	int ret;
+
+	pthread_create(&thread, NULL, __feed, p);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	t0 = __now_us();
+	while (r->bytes < want && r->calls < max_calls) {
+		if (poll(&pfd, 1, BENCH_IDLE_MS) <= 0)
+			break;
+
+		t = __now_us();
+		ret = vdpram_tty_read(fd, buf, sizeof(buf));
+		r->lat_us[r->calls++] = __now_us() - t;
+
+		if (ret > 0)
+			r->bytes += ret;
+		else
+			r->failed++;
+	}
+	r->elapsed_s = (__now_us() - t0) / 1e6;
+
+	pthread_join(thread, NULL);
+}
+
+static void __report(const char *spec, const char *op, struct result *r)
+{
+	double sum = 0;
+	unsigned long i;
+
+	if (r->calls == 0)
+		return;
+
+	for (i = 0; i < r->calls; i++)
+		sum += r->lat_us[i];
+	qsort(r->lat_us, r->calls, sizeof(double), __cmp_double);
+
+	printf("%-20s %-5s %7lu %8.2f %8.1f %8.1f %9.1f %6lu %7llu %5llu %8llu\n",
+			*spec ? spec : "none", op, r->calls,
+			r->elapsed_s > 0 ? r->bytes / r->elapsed_s / 1e6 : 0,
+			sum / r->calls, r->lat_us[r->calls * 99 / 100], r->lat_us[r->calls - 1],
+			r->failed, r->io.write_retries, r->io.write_drops, r->lost);
+}
+
+static int __run_spec(int fd, int master, const char *spec, unsigned int count, unsigned int size)
+{
+	char full[256];
+	struct peer p;
+	struct result r;
+	unsigned long max_calls = (unsigned long)count * 16 + 1024;
+
+	if (strstr(spec, "seed="))
+		snprintf(full, sizeof(full), "%s", spec);
+	else
+		snprintf(full, sizeof(full), "seed=1%s%s", *spec ? "," : "", spec);
+
+	if (vdpram_fault_configure(full) < 0) {
+		fprintf(stderr, "bad spec '%s'\n", spec);
+		return -1;
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.fd = master;
+	p.count = count;
+	p.size = size;
+
+	memset(&r, 0, sizeof(r));
+	r.lat_us = calloc(max_calls, sizeof(double));
+	vdpram_reset_io_stats();
+	__run_write(fd, &p, &r);
+	vdpram_get_io_stats(&r.io);
+	__report(spec, "write", &r);
+	free(r.lat_us);
+
+	memset(&r, 0, sizeof(r));
+	r.lat_us = calloc(max_calls, sizeof(double));
+	vdpram_reset_io_stats();
+	__run_read(fd, &p, &r, max_calls);
+	vdpram_get_io_stats(&r.io);
+	__report(spec, "read", &r);
+	free(r.lat_us);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char slave[64];
+	unsigned int count = 5000;
+	unsigned int size = 64;
+	int master;
+	int fd;
+	int opt;
+	int i;
+	int ret = 0;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n count] [-s size] [spec ...]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (count == 0 || size == 0)
+		return 2;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0
+			|| ptsname_r(master, slave, sizeof(slave)) != 0) {
+		fprintf(stderr, "pty setup failed\n");
+		return 1;
+	}
+
+	/* no faults while the device is set up */
+	vdpram_fault_configure(NULL);
+	vdpram_set_emulated(1);
+
+	fd = vdpram_open_path(slave, NULL);
+	if (fd < 0) {
+		fprintf(stderr, "vdpram open %s failed\n", slave);
+		return 1;
+	}
+
+	printf("%u x %u byte messages per op over %s\n", count, size, slave);
+	printf("%-20s %-5s %7s %8s %8s %8s %9s %6s %7s %5s %8s\n", "spec", "op", "calls",
+			"MB/s", "avg us", "p99 us", "max us", "failed", "retries", "drops", "lost B");
+
+	if (optind < argc) {
+		for (i = optind; i < argc; i++)
+			ret |= __run_spec(fd, master, argv[i], count, size);
+	}
+	else {
+		for (i = 0; default_specs[i]; i++)
+			ret |= __run_spec(fd, master, default_specs[i], count, size);
+	}
+
+	vdpram_fault_configure(NULL);
+	vdpram_close(fd);
+	close(master);
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * tty versus shared memory mailbox, through the plugin. The same
+ * responder answers on a pty and behind an emulated mailbox
+ * (vdpram_shm_create_memfd, FIFO doorbells), with no added latency, so
+ * what is measured is the transport and the plugin's handling of it:
+ *
+ *	latency     count sequential AT -> OK round trips
+ *	throughput  reps sequential AT+CPBR=1,500 (about 24 KB each), RX rate
+ *	burst       count AT queued at once, commands per second
+ *
+ *	vmodem-bench-backend [-p plugin.so] [-n count] [-r reps] [-s ring_size] [-v]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_WAIT_MS		10000
+#define BENCH_BULK_CMD		"AT+CPBR=1,500\r"
+
+struct bench {
+	GMainLoop *loop;
+	TcoreHal *hal;
+	GString *line;
+	unsigned int finals;
+	unsigned int want;
+	unsigned long long rx_bytes;
+	gboolean timed_out;
+};
+
+struct result {
+	double rtt_avg_us;
+	double rtt_max_us;
+	double rx_kb_s;
+	double burst_cmd_s;
+	double cpu_ms;
+};
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct bench *b = user_data;
+	const char *p = data;
+	unsigned int i;
+
+	b->rx_bytes += data_len;
+
+	for (i = 0; i < data_len; i++) {
+		if (p[i] != '\r' && p[i] != '\n') {
+			g_string_append_len(b->line, p + i, 1);
+			continue;
+		}
+
+		if (strcmp(b->line->str, "OK") == 0 || strcmp(b->line->str, "ERROR") == 0)
+			b->finals++;
+
+		g_string_truncate(b->line, 0);
+	}
+
+	if (b->finals >= b->want)
+		g_main_loop_quit(b->loop);
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct bench *b = data;
+
+	b->timed_out = TRUE;
+	g_main_loop_quit(b->loop);
+
+	return FALSE;
+}
+
+static gboolean __send(struct bench *b, const char *cmd)
+{
+	return tcore_hal_send_data(b->hal, strlen(cmd), (void *)cmd) == TCORE_RETURN_SUCCESS;
+}
+
+/* until n more final results came in */
+static gboolean __wait(struct bench *b, unsigned int n)
+{
+	guint timer;
+
+	b->want = b->finals + n;
+	if (b->finals >= b->want)
+		return TRUE;
+
+	b->timed_out = FALSE;
+	timer = g_timeout_add(BENCH_WAIT_MS, on_timeout, b);
+	g_main_loop_run(b->loop);
+
+	if (b->timed_out) {
+		fprintf(stderr, "timed out: %u/%u answers\n", b->finals, b->want);
+		return FALSE;
+	}
+
+	g_source_remove(timer);
+	return TRUE;
+}
+
+static double __cpu_ms(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0
+		+ ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+}
+
+static gboolean __run(const char *plugin_path, gboolean mailbox, unsigned int ring_size,
+		unsigned int count, unsigned int reps, struct result *res)
+{
+	struct pty_modem *modem;
+	struct vmodem_host *host;
+	struct bench b;
+	gboolean ok = FALSE;
+	double cpu0;
+	gint64 t0;
+	gint64 t;
+	gint64 rtt;
+	gint64 rtt_total = 0;
+	gint64 rtt_max = 0;
+	unsigned long long bytes0;
+	unsigned int i;
+
+	if (mailbox)
+		modem = pty_modem_new_mailbox(NULL, NULL, ring_size);
+	else
+		modem = pty_modem_new(NULL, NULL);
+	if (!modem)
+		return FALSE;
+
+	host = vmodem_host_new(plugin_path, pty_modem_slave(modem), pty_modem_device_conf(modem));
+	if (!host) {
+		pty_modem_free(modem);
+		return FALSE;
+	}
+
+	memset(&b, 0, sizeof(b));
+	b.loop = g_main_loop_new(NULL, FALSE);
+	b.line = g_string_sized_new(256);
+	b.hal = vmodem_host_hal(host);
+	tcore_hal_add_recv_callback(b.hal, on_recv, &b);
+
+	cpu0 = __cpu_ms();
+
+	for (i = 0; i < count; i++) {
+		t = g_get_monotonic_time();
+		if (!__send(&b, "AT\r") || !__wait(&b, 1))
+			goto out;
+
+		rtt = g_get_monotonic_time() - t;
+		rtt_total += rtt;
+		if (rtt > rtt_max)
+			rtt_max = rtt;
+	}
+
+	bytes0 = b.rx_bytes;
+	t0 = g_get_monotonic_time();
+	for (i = 0; i < reps; i++) {
+		if (!__send(&b, BENCH_BULK_CMD) || !__wait(&b, 1))
+			goto out;
+	}
+	t = g_get_monotonic_time() - t0;
+	res->rx_kb_s = (b.rx_bytes - bytes0) / 1024.0 / (t / 1000000.0);
+
+	t0 = g_get_monotonic_time();
+	for (i = 0; i < count; i++) {
+		if (!__send(&b, "AT\r"))
+			goto out;
+	}
+	if (!__wait(&b, count))
+		goto out;
+	t = g_get_monotonic_time() - t0;
+	res->burst_cmd_s = count / (t / 1000000.0);
+
+	res->cpu_ms = __cpu_ms() - cpu0;
+	res->rtt_avg_us = (double)rtt_total / count;
+	res->rtt_max_us = rtt_max;
+	ok = TRUE;
+
+out:
+	vmodem_host_free(host);
+	pty_modem_free(modem);
+	g_string_free(b.line, TRUE);
+	g_main_loop_unref(b.loop);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *name[2] = { "tty", "mailbox" };
+	struct result res[2];
+	unsigned int ring_size = 65536;
+	unsigned int count = 1000;
+	unsigned int reps = 50;
+	gboolean verbose = FALSE;
+	int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:n:r:s:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		case 's':
+			ring_size = atoi(optarg);
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-n count] [-r reps] [-s ring_size] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (count == 0 || reps == 0)
+		return 2;
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	printf("%u round trips, %u x %s, burst of %u, mailbox rings %u bytes\n",
+			count, reps, "AT+CPBR=1,500", count, ring_size);
+	printf("%-8s %12s %12s %12s %12s %10s\n", "backend", "rtt avg us", "rtt max us",
+			"rx KB/s", "burst cmd/s", "cpu ms");
+
+	for (i = 0; i < 2; i++) {
+		memset(&res[i], 0, sizeof(res[i]));
+
+		if (!__run(plugin_path, i == 1, ring_size, count, reps, &res[i])) {
+			printf("%-8s FAILED\n", name[i]);
+			return 1;
+		}
+
+		printf("%-8s %12.1f %12.1f %12.0f %12.0f %10.1f\n", name[i], res[i].rtt_avg_us,
+				res[i].rtt_max_us, res[i].rx_kb_s, res[i].burst_cmd_s, res[i].cpu_ms);
+	}
+
+	printf("mailbox/tty: latency %.2fx, throughput %.2fx, burst %.2fx\n",
+			res[1].rtt_avg_us / res[0].rtt_avg_us, res[1].rx_kb_s / res[0].rx_kb_s,
+			res[1].burst_cmd_s / res[0].burst_cmd_s);
+
+	return 0;
+}
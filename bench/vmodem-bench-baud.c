@@ -0,0 +1,463 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * TX rate per line speed: the plugin's scheduler, which writes bursts
+ * whenever the fd takes them and otherwise waits on G_IO_OUT, against
+ * the vdpram_tty_write() retry/sleep loop the plugin used before. A pty
+ * ignores its termios speed, so pty-modem paces both directions to the
+ * line rate (baud / 10, 8N1) and the writer backs up on a full pty the
+ * way it does behind a deasserted CTS; RTS/CTS itself cannot be set on a
+ * pty, so [tty] hw_flow stays off. The modem runs in a child process so
+ * that the CPU figures are the writer's alone.
+ *
+ *	sched   count commands queued at once through the HAL, until the last OK
+ *	retry   the same bytes through vdpram_tty_write() with the [retry]
+ *	        defaults, until the modem read them; what it gave up on is lost
+ *
+ * stalls counts EAGAIN retries and waits inside vdpram; the scheduler
+ * only writes once G_IO_OUT reported room, so it should have none.
+ *
+ *	vmodem-bench-baud [-p plugin.so] [-s seconds] [-b baud[,baud...]] [-v]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "vdpram.h"
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_WAIT_MS		60000
+#define BENCH_CHECK_MS		1
+#define BENCH_BAUDS			"115200,460800,921600,3000000"
+#define BENCH_CMD_LEN		100
+
+struct bench {
+	GMainLoop *loop;
+	GString *line;
+	unsigned int finals;
+	unsigned int want;
+	gboolean timed_out;
+};
+
+/* the modem child: c2p carries the slave name, then one byte once done */
+struct child {
+	pid_t pid;
+	int c2p;
+	int p2c;
+	char slave[64];
+};
+
+struct modem_side {
+	GMainLoop *loop;
+	struct pty_modem *modem;
+	int p2c;
+	int c2p;
+	unsigned long long target;
+	int have_target;
+};
+
+struct result {
+	double tx_kb_s;
+	double line_pct;
+	unsigned long long writes;
+	unsigned long long stalls;	/* retries, or waits for room */
+	unsigned long long lost;
+	double cpu_us_kb;
+};
+
+static gboolean on_child_check(gpointer data)
+{
+	struct modem_side *s = data;
+	struct pty_modem_stats st;
+	char done = 1;
+
+	if (!s->have_target
+			&& read(s->p2c, &s->target, sizeof(s->target)) == sizeof(s->target))
+		s->have_target = 1;
+
+	if (!s->have_target)
+		return TRUE;
+
+	pty_modem_get_stats(s->modem, &st);
+	if (st.bytes_in < s->target)
+		return TRUE;
+
+	/* keep the pty open (and read) until killed, the writer still closes it */
+	if (write(s->c2p, &done, 1) != 1)
+		_exit(1);
+
+	return FALSE;
+}
+
+static gboolean __child_start(struct child *c, unsigned int rate)
+{
+	struct modem_side s;
+	int c2p[2];
+	int p2c[2];
+
+	if (pipe(c2p) < 0)
+		return FALSE;
+	if (pipe(p2c) < 0) {
+		close(c2p[0]);
+		close(c2p[1]);
+		return FALSE;
+	}
+
+	c->pid = fork();
+	if (c->pid < 0)
+		return FALSE;
+
+	if (c->pid > 0) {
+		close(c2p[1]);
+		close(p2c[0]);
+		c->c2p = c2p[0];
+		c->p2c = p2c[1];
+
+		return read(c->c2p, c->slave, sizeof(c->slave)) == sizeof(c->slave);
+	}
+
+	close(c2p[0]);
+	close(p2c[1]);
+
+	memset(&s, 0, sizeof(s));
+	s.c2p = c2p[1];
+	s.p2c = p2c[0];
+	fcntl(s.p2c, F_SETFL, O_NONBLOCK);
+
+	s.modem = pty_modem_new(NULL, NULL);
+	if (!s.modem)
+		_exit(1);
+	pty_modem_set_rate(s.modem, rate);
+
+	memset(c->slave, 0, sizeof(c->slave));
+	snprintf(c->slave, sizeof(c->slave), "%s", pty_modem_slave(s.modem));
+	if (write(s.c2p, c->slave, sizeof(c->slave)) != sizeof(c->slave))
+		_exit(1);
+
+	s.loop = g_main_loop_new(NULL, FALSE);
+	g_timeout_add(BENCH_CHECK_MS, on_child_check, &s);
+	g_main_loop_run(s.loop);
+
+	_exit(0);
+}
+
+/* until the child read target bytes */
+static gboolean __child_wait(struct child *c, unsigned long long target)
+{
+	struct pollfd pfd;
+	char done;
+
+	pfd.fd = c->c2p;
+	pfd.events = POLLIN;
+
+	return write(c->p2c, &target, sizeof(target)) == sizeof(target)
+		&& poll(&pfd, 1, BENCH_WAIT_MS) == 1 && read(c->c2p, &done, 1) == 1;
+}
+
+static void __child_stop(struct child *c)
+{
+	kill(c->pid, SIGTERM);
+	waitpid(c->pid, NULL, 0);
+	close(c->c2p);
+	close(c->p2c);
+}
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct bench *b = user_data;
+	const char *p = data;
+	unsigned int i;
+
+	for (i = 0; i < data_len; i++) {
+		if (p[i] != '\r' && p[i] != '\n') {
+			g_string_append_len(b->line, p + i, 1);
+			continue;
+		}
+
+		if (strcmp(b->line->str, "OK") == 0 || strcmp(b->line->str, "ERROR") == 0)
+			b->finals++;
+
+		g_string_truncate(b->line, 0);
+	}
+
+	if (b->finals >= b->want)
+		g_main_loop_quit(b->loop);
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct bench *b = data;
+
+	b->timed_out = TRUE;
+	g_main_loop_quit(b->loop);
+
+	return FALSE;
+}
+
+static double __cpu_ms(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0
+		+ ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+}
+
+/* a phonebook write, padded to BENCH_CMD_LEN bytes */
+static void __command(char *cmd, unsigned int i)
+{
+	int n;
+
+	n = snprintf(cmd, BENCH_CMD_LEN + 1, "AT+CPBW=%05u,\"+8210555%05u\",145,\"", i % 100000,
+			i % 100000);
+	memset(cmd + n, 'x', BENCH_CMD_LEN - n - 2);
+	cmd[BENCH_CMD_LEN - 2] = '"';
+	cmd[BENCH_CMD_LEN - 1] = '\r';
+	cmd[BENCH_CMD_LEN] = '\0';
+}
+
+static void __finish(struct result *res, unsigned int baud, unsigned long long bytes, gint64 t,
+		double cpu_ms)
+{
+	res->tx_kb_s = bytes / 1024.0 / (t / 1000000.0);
+	res->line_pct = bytes * 100.0 / (baud / 10.0 * (t / 1000000.0));
+	res->cpu_us_kb = bytes ? cpu_ms * 1000.0 / (bytes / 1024.0) : 0;
+}
+
+static gboolean __run_sched(const char *plugin_path, unsigned int baud, unsigned int count,
+		struct result *res)
+{
+	void (*get_io_stats)(struct vdpram_io_stats *stats);
+	void (*reset_io_stats)(void);
+	struct vdpram_io_stats io;
+	struct vmodem_host *host;
+	struct child c;
+	struct bench b;
+	TcoreHal *hal;
+	char conf[64];
+	char cmd[BENCH_CMD_LEN + 1];
+	gboolean ok = FALSE;
+	unsigned int i;
+	guint timer;
+	double cpu0;
+	gint64 t0;
+
+	if (!__child_start(&c, baud / 10))
+		return FALSE;
+
+	snprintf(conf, sizeof(conf), "[tty]\nbaudrate=%u\nhw_flow=false\n", baud);
+	host = vmodem_host_new(plugin_path, c.slave, conf);
+	if (!host) {
+		__child_stop(&c);
+		return FALSE;
+	}
+
+	memset(&b, 0, sizeof(b));
+	b.loop = g_main_loop_new(NULL, FALSE);
+	b.line = g_string_sized_new(256);
+	hal = vmodem_host_hal(host);
+	tcore_hal_add_recv_callback(hal, on_recv, &b);
+
+	get_io_stats = vmodem_host_sym(host, "vdpram_get_io_stats");
+	reset_io_stats = vmodem_host_sym(host, "vdpram_reset_io_stats");
+	if (!get_io_stats || !reset_io_stats)
+		goto out;
+
+	reset_io_stats();
+	cpu0 = __cpu_ms();
+	t0 = g_get_monotonic_time();
+
+	for (i = 0; i < count; i++) {
+		__command(cmd, i);
+		if (tcore_hal_send_data(hal, BENCH_CMD_LEN, cmd) != TCORE_RETURN_SUCCESS)
+			goto out;
+	}
+
+	b.want = count;
+	timer = g_timeout_add(BENCH_WAIT_MS, on_timeout, &b);
+	g_main_loop_run(b.loop);
+	if (b.timed_out) {
+		fprintf(stderr, "timed out: %u/%u answers\n", b.finals, b.want);
+		goto out;
+	}
+	g_source_remove(timer);
+
+	get_io_stats(&io);
+	__finish(res, baud, io.write_bytes, g_get_monotonic_time() - t0, __cpu_ms() - cpu0);
+	res->writes = io.writes;
+	res->stalls = io.write_retries + io.waits;
+	res->lost = (unsigned long long)count * BENCH_CMD_LEN - io.write_bytes;
+	ok = TRUE;
+
+out:
+	vmodem_host_free(host);
+	__child_stop(&c);
+	g_string_free(b.line, TRUE);
+	g_main_loop_unref(b.loop);
+
+	return ok;
+}
+
+static gboolean __run_retry(unsigned int baud, unsigned int count, struct result *res)
+{
+	struct vdpram_io_stats io;
+	struct child c;
+	char cmd[BENCH_CMD_LEN + 1];
+	unsigned long long written = 0;
+	gboolean ok;
+	unsigned int i;
+	double cpu0;
+	gint64 t0;
+	int ret;
+	int fd;
+
+	if (!__child_start(&c, baud / 10))
+		return FALSE;
+
+	vdpram_set_emulated(1);
+	fd = vdpram_open_path(c.slave, NULL);
+	if (fd < 0) {
+		__child_stop(&c);
+		return FALSE;
+	}
+
+	vdpram_reset_io_stats();
+	cpu0 = __cpu_ms();
+	t0 = g_get_monotonic_time();
+
+	for (i = 0; i < count; i++) {
+		__command(cmd, i);
+		ret = vdpram_tty_write(fd, cmd, BENCH_CMD_LEN);
+		if (ret > 0)
+			written += ret;
+	}
+
+	ok = __child_wait(&c, written);
+	if (ok) {
+		vdpram_get_io_stats(&io);
+		__finish(res, baud, written, g_get_monotonic_time() - t0, __cpu_ms() - cpu0);
+		res->writes = io.writes;
+		res->stalls = io.write_retries + io.waits;
+		res->lost = (unsigned long long)count * BENCH_CMD_LEN - written;
+	}
+
+	vdpram_close(fd);
+	__child_stop(&c);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *bauds = BENCH_BAUDS;
+	const char *name[2] = { "sched", "retry" };
+	struct result res;
+	double seconds = 1.0;
+	gboolean verbose = FALSE;
+	gboolean ok;
+	unsigned int baud;
+	unsigned int count;
+	gchar **list;
+	int i;
+	int j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:s:b:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 's':
+			seconds = atof(optarg);
+			break;
+		case 'b':
+			bauds = optarg;
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-s seconds] [-b baud[,baud...]] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (seconds <= 0)
+		return 2;
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	printf("%d byte commands, %.1f s of line time per point, paced pty\n", BENCH_CMD_LEN,
+			seconds);
+	printf("%-8s %-6s %10s %10s %7s %8s %8s %10s %10s\n", "baud", "writer", "line KB/s",
+			"tx KB/s", "line %", "writes", "stalls", "lost B", "cpu us/KB");
+
+	list = g_strsplit(bauds, ",", 0);
+	for (i = 0; list[i]; i++) {
+		baud = atoi(list[i]);
+		count = baud / 10 * seconds / BENCH_CMD_LEN;
+		if (count == 0)
+			count = 1;
+
+		for (j = 0; j < 2; j++) {
+			memset(&res, 0, sizeof(res));
+
+			if (j == 0)
+				ok = __run_sched(plugin_path, baud, count, &res);
+			else
+				ok = __run_retry(baud, count, &res);
+
+			if (!ok) {
+				printf("%-8u %-6s FAILED\n", baud, name[j]);
+				g_strfreev(list);
+				return 1;
+			}
+
+			printf("%-8u %-6s %10.1f %10.1f %7.1f %8llu %8llu %10llu %10.1f\n", baud, name[j],
+					baud / 10 / 1024.0, res.tx_kb_s, res.line_pct, res.writes, res.stalls,
+					res.lost, res.cpu_us_kb);
+		}
+	}
+	g_strfreev(list);
+
+	return 0;
+}
@@ -0,0 +1,392 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Data mode passthrough throughput, through the plugin. pty-modem
+ * answers the AT side and, once data mode is entered, loops every byte
+ * back like a modem in a loopback test call. The peer is driven from a
+ * thread of its own, as pppd or the IP stack would:
+ *
+ *	ppp     a pty master from vdpram_data_open_pty(); the bench holds
+ *	        the slave, writes a byte stream and checks it comes back
+ *	packet  a SOCK_SEQPACKET socket standing in for a tun (which needs
+ *	        CAP_NET_ADMIN and routes into the host); every packet has
+ *	        to come back whole and in order through the length framing
+ *
+ * Both directions carry size MB at once; Mbit/s is per direction.
+ * Afterwards the channel has to answer AT again.
+ *
+ *	vmodem-bench-data [-p plugin.so] [-m size_mb] [-l packet_len] [-v]
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "vdpram_data.h"
+#include "vmodem_hal.h"
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_STREAM_CHUNK	4096
+#define BENCH_STALL_MS		5000
+#define BENCH_CHECK_MS		10
+#define BENCH_WAIT_MS		2000
+
+/* the stream pattern repeats at a prime, so a dropped or doubled chunk shows */
+#define BENCH_PATTERN		251
+
+struct peer {
+	int fd;
+	gboolean packet;
+	unsigned int len;	/* packet length, or stream chunk */
+	unsigned long long total;
+
+	unsigned long long sent;
+	unsigned long long received;
+	unsigned long errors;
+	gint64 elapsed_us;
+	int failed;
+	volatile int done;
+};
+
+struct result {
+	double mbit_s;
+	double cpu_ms;
+	unsigned long errors;
+	gboolean at_ok;
+};
+
+static void __fill(struct peer *p, unsigned char *buf, unsigned int len)
+{
+	unsigned long long seq = p->sent / p->len;
+	unsigned int i;
+
+	if (!p->packet) {
+		for (i = 0; i < len; i++)
+			buf[i] = (p->sent + i) % BENCH_PATTERN;
+		return;
+	}
+
+	for (i = 0; i < len; i++)
+		buf[i] = (seq + i) & 0xff;
+	memcpy(buf, &seq, sizeof(seq));
+}
+
+static void __check(struct peer *p, const unsigned char *buf, unsigned int len)
+{
+	unsigned long long seq = p->received / p->len;
+	unsigned long long got;
+	unsigned int i;
+
+	if (!p->packet) {
+		for (i = 0; i < len; i++) {
+			if (buf[i] != (p->received + i) % BENCH_PATTERN) {
+				p->errors++;
+				break;
+			}
+		}
+		return;
+	}
+
+	/* a split or merged packet has the wrong length */
+	memcpy(&got, buf, sizeof(got));
+	if (len != p->len || got != seq)
+		p->errors++;
+}
+
+static void *__peer_thread(void *arg)
+{
+	struct peer *p = arg;
+	struct pollfd pfd;
+	unsigned char *out;
+	unsigned char *in;
+	unsigned int want;
+	gint64 t0;
+	ssize_t n;
+
+	out = malloc(p->len);
+	in = malloc(p->len * 2);
+	if (!out || !in) {
+		p->failed = 1;
+		goto done;
+	}
+
+	pfd.fd = p->fd;
+	t0 = g_get_monotonic_time();
+
+	while (p->received < p->total) {
+		pfd.events = POLLIN | (p->sent < p->total ? POLLOUT : 0);
+		n = poll(&pfd, 1, BENCH_STALL_MS);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+			fprintf(stderr, "peer stalled: %llu/%llu bytes back\n", p->received, p->total);
+			p->failed = 1;
+			break;
+		}
+
+		if (pfd.revents & POLLOUT) {
+			want = p->total - p->sent < p->len ? p->total - p->sent : p->len;
+			__fill(p, out, want);
+			n = write(p->fd, out, want);
+			if (n > 0)
+				p->sent += n;
+		}
+
+		if (pfd.revents & POLLIN) {
+			n = read(p->fd, in, p->len * 2);
+			if (n > 0) {
+				__check(p, in, n);
+				p->received += n;
+			}
+		}
+	}
+
+	p->elapsed_us = g_get_monotonic_time() - t0;
+
+done:
+	free(out);
+	free(in);
+	p->done = 1;
+
+	return NULL;
+}
+
+static gboolean on_check(gpointer data)
+{
+	struct peer *p = data;
+
+	return !p->done;
+}
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	GString *rx = user_data;
+
+	g_string_append_len(rx, data, data_len);
+}
+
+static double __cpu_ms(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0
+		+ ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+}
+
+/* the plugin's end of the peer in p_fd, the bench's end in p->fd */
+static gboolean __open_peer(gboolean packet, int *p_fd, struct peer *p)
+{
+	struct termios tio;
+	char slave[64];
+	int sv[2];
+
+	if (packet) {
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+			return FALSE;
+		*p_fd = sv[0];
+		p->fd = sv[1];
+	}
+	else {
+		*p_fd = vdpram_data_open_pty(slave, sizeof(slave));
+		if (*p_fd < 0)
+			return FALSE;
+
+		p->fd = open(slave, O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (p->fd < 0 || tcgetattr(p->fd, &tio) < 0) {
+			close(*p_fd);
+			return FALSE;
+		}
+		cfmakeraw(&tio);
+		tcsetattr(p->fd, TCSANOW, &tio);
+	}
+
+	fcntl(p->fd, F_SETFL, fcntl(p->fd, F_GETFL) | O_NONBLOCK);
+	fcntl(*p_fd, F_SETFL, fcntl(*p_fd, F_GETFL) | O_NONBLOCK);
+
+	return TRUE;
+}
+
+static gboolean __run(const char *plugin_path, gboolean packet, unsigned int size_mb,
+		unsigned int packet_len, struct result *res)
+{
+	struct pty_modem *modem;
+	struct vmodem_host *host;
+	struct peer p;
+	pthread_t thread;
+	TcoreHal *hal;
+	GString *rx;
+	gboolean ok = FALSE;
+	gint64 end;
+	double cpu0;
+	int peer_fd = -1;
+
+	modem = pty_modem_new(NULL, NULL);
+	if (!modem)
+		return FALSE;
+
+	host = vmodem_host_new(plugin_path, pty_modem_slave(modem), NULL);
+	if (!host) {
+		pty_modem_free(modem);
+		return FALSE;
+	}
+
+	hal = vmodem_host_hal(host);
+	rx = g_string_sized_new(256);
+	tcore_hal_add_recv_callback(hal, on_recv, rx);
+
+	memset(&p, 0, sizeof(p));
+	p.fd = -1;
+	p.packet = packet;
+	p.len = packet ? packet_len : BENCH_STREAM_CHUNK;
+	p.total = (unsigned long long)size_mb << 20;
+	if (packet)
+		p.total -= p.total % p.len;
+
+	if (!__open_peer(packet, &peer_fd, &p))
+		goto out;
+
+	pty_modem_set_loopback(modem, TRUE);
+	if (vmodem_hal_enter_data_mode(hal, peer_fd) != TCORE_RETURN_SUCCESS)
+		goto out;
+
+	cpu0 = __cpu_ms();
+	if (pthread_create(&thread, NULL, __peer_thread, &p) != 0) {
+		vmodem_hal_leave_data_mode(hal);
+		goto out;
+	}
+
+	g_timeout_add(BENCH_CHECK_MS, on_check, &p);
+	while (!p.done)
+		g_main_context_iteration(NULL, TRUE);
+	pthread_join(thread, NULL);
+
+	res->cpu_ms = __cpu_ms() - cpu0;
+	res->errors = p.errors;
+	if (p.elapsed_us > 0)
+		res->mbit_s = p.total * 8.0 / p.elapsed_us;
+
+	vmodem_hal_leave_data_mode(hal);
+
+	/* back in AT mode on the same channel */
+	pty_modem_set_loopback(modem, FALSE);
+	tcore_hal_send_data(hal, 3, "AT\r");
+	end = g_get_monotonic_time() + BENCH_WAIT_MS * 1000LL;
+	while (!strstr(rx->str, "\r\nOK\r\n") && g_get_monotonic_time() < end)
+		g_main_context_iteration(NULL, FALSE);
+	res->at_ok = strstr(rx->str, "\r\nOK\r\n") != NULL;
+
+	ok = !p.failed;
+
+out:
+	if (peer_fd >= 0)
+		close(peer_fd);
+	if (p.fd >= 0)
+		close(p.fd);
+	vmodem_host_free(host);
+	pty_modem_free(modem);
+	g_string_free(rx, TRUE);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *name[2] = { "ppp", "packet" };
+	struct result res;
+	unsigned int size_mb = 64;
+	unsigned int packet_len = 1500;
+	gboolean verbose = FALSE;
+	int failed = 0;
+	int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:m:l:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'm':
+			size_mb = atoi(optarg);
+			break;
+		case 'l':
+			packet_len = atoi(optarg);
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-m size_mb] [-l packet_len] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (size_mb == 0 || packet_len < sizeof(unsigned long long) || packet_len > 65535)
+		return 2;
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	printf("%u MB each way, %u byte packets\n", size_mb, packet_len);
+	printf("%-8s %12s %10s %12s %8s %6s\n", "peer", "Mbit/s", "cpu ms", "cpu ms/MB",
+			"errors", "AT");
+
+	for (i = 0; i < 2; i++) {
+		memset(&res, 0, sizeof(res));
+
+		if (!__run(plugin_path, i == 1, size_mb, packet_len, &res)) {
+			printf("%-8s FAILED\n", name[i]);
+			return 1;
+		}
+
+		printf("%-8s %12.1f %10.1f %12.2f %8lu %6s\n", name[i], res.mbit_s, res.cpu_ms,
+				res.cpu_ms / (size_mb * 2), res.errors, res.at_ok ? "ok" : "FAIL");
+
+		if (res.errors || !res.at_ok)
+			failed = 1;
+	}
+
+	return failed;
+}
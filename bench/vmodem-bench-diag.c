@@ -0,0 +1,352 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Cost of the diagnostics module (vmodem-dump.so), through the plugin.
+ * Each mode runs in a child of its own, so the module is only mapped
+ * where diagnostics were turned on and RSS starts from the same point:
+ *
+ *	off      [debug] dump_level=0, no capture: the module is not loaded
+ *	summary  dump_level=1, one log line per frame
+ *	hex      dump_level=2, plus a hex dump
+ *	capture  dump_level=0, capture=true, every frame appended to a file
+ *
+ * Logging stays on and goes to /dev/null (stderr with -v), so the
+ * formatting is paid as it would be on target. count AT+CPBR=1 round
+ * trips run back to back; CPU is the whole process, pty-modem included,
+ * so the cost of the module is the difference to off.
+ *
+ *	vmodem-bench-diag [-p plugin.so] [-d vmodem-dump.so] [-n count] [-v]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_WAIT_MS	60000
+#define BENCH_WARMUP	200
+#define BENCH_CMD		"AT+CPBR=1\r"
+
+struct bench {
+	GMainLoop *loop;
+	GString *line;
+	unsigned int finals;
+	unsigned int want;
+	gboolean timed_out;
+};
+
+struct result {
+	int ok;
+	int mapped;				/* vmodem-dump.so in /proc/self/maps */
+	double cpu_us_msg;
+	double rtt_us;
+	long rss_kb;
+};
+
+static const struct {
+	const char *name;
+	int dump_level;
+	int capture;
+} modes[] = {
+	{ "off", 0, 0 },
+	{ "summary", 1, 0 },
+	{ "hex", 2, 0 },
+	{ "capture", 0, 1 },
+};
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct bench *b = user_data;
+	const char *p = data;
+	unsigned int i;
+
+	for (i = 0; i < data_len; i++) {
+		if (p[i] != '\r' && p[i] != '\n') {
+			g_string_append_len(b->line, p + i, 1);
+			continue;
+		}
+
+		if (strcmp(b->line->str, "OK") == 0 || strcmp(b->line->str, "ERROR") == 0)
+			b->finals++;
+		g_string_truncate(b->line, 0);
+	}
+
+	if (b->finals >= b->want)
+		g_main_loop_quit(b->loop);
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct bench *b = data;
+
+	b->timed_out = TRUE;
+	g_main_loop_quit(b->loop);
+
+	return FALSE;
+}
+
+static double __cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return ru.ru_utime.tv_sec * 1000000.0 + ru.ru_utime.tv_usec
+		+ ru.ru_stime.tv_sec * 1000000.0 + ru.ru_stime.tv_usec;
+}
+
+/* VmRSS, and whether the diagnostics module is mapped */
+static void __memory(struct result *res)
+{
+	char line[512];
+	FILE *fp;
+
+	fp = fopen("/proc/self/status", "r");
+	if (fp) {
+		while (fgets(line, sizeof(line), fp))
+			if (strncmp(line, "VmRSS:", 6) == 0)
+				res->rss_kb = atol(line + 6);
+		fclose(fp);
+	}
+
+	fp = fopen("/proc/self/maps", "r");
+	if (fp) {
+		while (fgets(line, sizeof(line), fp))
+			if (strstr(line, "vmodem-dump.so"))
+				res->mapped = 1;
+		fclose(fp);
+	}
+}
+
+static gboolean __round_trips(struct bench *b, TcoreHal *hal, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		b->want = b->finals + 1;
+		if (tcore_hal_send_data(hal, strlen(BENCH_CMD), BENCH_CMD) != TCORE_RETURN_SUCCESS)
+			return FALSE;
+
+		g_main_loop_run(b->loop);
+		if (b->timed_out) {
+			fprintf(stderr, "timed out after %u answers\n", b->finals);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void __child(const char *plugin_path, int mode, unsigned int count, const char *cap_path,
+		struct result *res)
+{
+	struct vmodem_host *host;
+	struct pty_modem *modem;
+	struct bench b;
+	char conf[256];
+	double cpu0;
+	gint64 t0;
+
+	memset(&b, 0, sizeof(b));
+
+	modem = pty_modem_new(NULL, NULL);
+	if (!modem)
+		return;
+
+	snprintf(conf, sizeof(conf), "[debug]\ndump_level=%d\ncapture=%s\ncapture_path=%s\n",
+			modes[mode].dump_level, modes[mode].capture ? "true" : "false", cap_path);
+	host = vmodem_host_new(plugin_path, pty_modem_slave(modem), conf);
+	if (!host) {
+		pty_modem_free(modem);
+		return;
+	}
+
+	b.loop = g_main_loop_new(NULL, FALSE);
+	b.line = g_string_sized_new(256);
+	tcore_hal_add_recv_callback(vmodem_host_hal(host), on_recv, &b);
+	g_timeout_add(BENCH_WAIT_MS, on_timeout, &b);
+
+	if (__round_trips(&b, vmodem_host_hal(host), BENCH_WARMUP)) {
+		cpu0 = __cpu_us();
+		t0 = g_get_monotonic_time();
+
+		if (__round_trips(&b, vmodem_host_hal(host), count)) {
+			res->cpu_us_msg = (__cpu_us() - cpu0) / count;
+			res->rtt_us = (double)(g_get_monotonic_time() - t0) / count;
+			__memory(res);
+			res->ok = 1;
+		}
+	}
+
+	vmodem_host_free(host);
+	pty_modem_free(modem);
+	g_string_free(b.line, TRUE);
+	g_main_loop_unref(b.loop);
+}
+
+static gboolean __run(const char *plugin_path, int mode, unsigned int count, gboolean verbose,
+		struct result *res)
+{
+	char cap_path[64];
+	int fds[2];
+	pid_t pid;
+	int null_fd;
+	gboolean ok;
+
+	snprintf(cap_path, sizeof(cap_path), "/tmp/vmodem-bench-diag.%d.cap", (int)getpid());
+
+	if (pipe(fds) < 0)
+		return FALSE;
+
+	/* nothing buffered may be printed twice */
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return FALSE;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		if (!verbose) {
+			null_fd = open("/dev/null", O_WRONLY);
+			if (null_fd >= 0) {
+				dup2(null_fd, STDERR_FILENO);
+				close(null_fd);
+			}
+		}
+
+		memset(res, 0, sizeof(struct result));
+		__child(plugin_path, mode, count, cap_path, res);
+		if (write(fds[1], res, sizeof(struct result)) != sizeof(struct result))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	ok = read(fds[0], res, sizeof(struct result)) == sizeof(struct result) && res->ok;
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+	unlink(cap_path);
+
+	return ok;
+}
+
+static long __file_kb(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0)
+		return -1;
+
+	return (long)((st.st_size + 1023) / 1024);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *module_path = "./vmodem-dump.so";
+	char *module_abs;
+	struct result res;
+	struct result off;
+	unsigned int count = 20000;
+	gboolean verbose = FALSE;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:d:n:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'd':
+			module_path = optarg;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-d vmodem-dump.so] [-n count] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (count == 0)
+		return 2;
+
+	/* a relative path would be looked up in the library path by dlopen */
+	module_abs = realpath(module_path, NULL);
+	if (!module_abs) {
+		fprintf(stderr, "no diagnostics module %s\n", module_path);
+		return 2;
+	}
+	setenv("VMODEM_DUMP_MODULE", module_abs, 1);
+
+	printf("%s %ld KB, %s %ld KB; %u x %s", plugin_path, __file_kb(plugin_path),
+			module_path, __file_kb(module_abs), count, BENCH_CMD);
+	free(module_abs);
+	printf("\n%-8s %6s %8s %10s %12s %12s %10s\n", "diag", "module", "rss KB", "rss +KB",
+			"cpu us/msg", "cpu +us/msg", "rtt us");
+
+	memset(&off, 0, sizeof(off));
+	for (i = 0; i < G_N_ELEMENTS(modes); i++) {
+		if (!__run(plugin_path, i, count, verbose, &res)) {
+			printf("%-8s FAILED\n", modes[i].name);
+			return 1;
+		}
+
+		if (i == 0)
+			off = res;
+
+		printf("%-8s %6s %8ld %10ld %12.2f %12.2f %10.1f\n", modes[i].name,
+				res.mapped ? "yes" : "no", res.rss_kb, res.rss_kb - off.rss_kb,
+				res.cpu_us_msg, res.cpu_us_msg - off.cpu_us_msg, res.rtt_us);
+
+		/* the whole point: off must not load it */
+		if ((i == 0) == (res.mapped != 0)) {
+			printf("%-8s module %s\n", modes[i].name, res.mapped ? "loaded" : "not loaded");
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * RX wakeups and CPU with [power] save off and on, through the plugin.
+ * pty-modem is paced to a UART (115200 baud by default), so responses
+ * arrive in small chunks as they would on target:
+ *
+ *	bulk  reps x AT+CPBR=1,100 (about 4.8 KB each)
+ *	urc   count +CREG URCs from idle, 50 ms apart, timed from the
+ *	      modem's write to tcore's callback
+ *
+ * wakeups/min is over the whole run; CPU/KB is the RX path's thread
+ * CPU ([power] stats) per KB read.
+ *
+ *	vmodem-bench-power [-p plugin.so] [-r reps] [-n count] [-b baud] [-v]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "vmodem_hal.h"
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_WAIT_MS		30000
+#define BENCH_URC_GAP_MS	50
+#define BENCH_BULK_CMD		"AT+CPBR=1,100\r"
+#define BENCH_URC			"\r\n+CREG: 1,\"00C3\",\"0000A13B\"\r\n"
+
+struct bench {
+	GMainLoop *loop;
+	TcoreHal *hal;
+	struct pty_modem *modem;
+	GString *line;
+	unsigned int finals;
+	unsigned int want;
+	gboolean timed_out;
+
+	/* urc phase */
+	unsigned int urcs_sent;
+	unsigned int urcs_seen;
+	unsigned int urcs;
+	gint64 urc_sent_at;
+	gint64 urc_total_us;
+	gint64 urc_max_us;
+};
+
+struct result {
+	struct vmodem_hal_rx_stats rx;
+	double urc_avg_ms;
+	double urc_max_ms;
+};
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct bench *b = user_data;
+	const char *p = data;
+	unsigned int i;
+	gint64 lat;
+
+	for (i = 0; i < data_len; i++) {
+		if (p[i] != '\r' && p[i] != '\n') {
+			g_string_append_len(b->line, p + i, 1);
+			continue;
+		}
+
+		if (strcmp(b->line->str, "OK") == 0 || strcmp(b->line->str, "ERROR") == 0)
+			b->finals++;
+
+		if (strncmp(b->line->str, "+CREG:", 6) == 0) {
+			lat = g_get_monotonic_time() - b->urc_sent_at;
+			b->urc_total_us += lat;
+			if (lat > b->urc_max_us)
+				b->urc_max_us = lat;
+			b->urcs_seen++;
+		}
+
+		g_string_truncate(b->line, 0);
+	}
+
+	if ((b->want && b->finals >= b->want) || (b->urcs && b->urcs_seen >= b->urcs))
+		g_main_loop_quit(b->loop);
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct bench *b = data;
+
+	b->timed_out = TRUE;
+	g_main_loop_quit(b->loop);
+
+	return FALSE;
+}
+
+static gboolean on_urc_due(gpointer data)
+{
+	struct bench *b = data;
+
+	if (b->urcs_sent >= b->urcs)
+		return FALSE;
+
+	b->urcs_sent++;
+	b->urc_sent_at = g_get_monotonic_time();
+	pty_modem_reply(b->modem, BENCH_URC, strlen(BENCH_URC));
+
+	return TRUE;
+}
+
+static gboolean __run_loop(struct bench *b)
+{
+	guint timer;
+
+	b->timed_out = FALSE;
+	timer = g_timeout_add(BENCH_WAIT_MS, on_timeout, b);
+	g_main_loop_run(b->loop);
+
+	if (b->timed_out) {
+		fprintf(stderr, "timed out: %u/%u answers, %u/%u urcs\n", b->finals, b->want,
+				b->urcs_seen, b->urcs);
+		return FALSE;
+	}
+
+	g_source_remove(timer);
+	return TRUE;
+}
+
+static gboolean __run(const char *plugin_path, gboolean save, unsigned int baud,
+		unsigned int reps, unsigned int count, struct result *res)
+{
+	VmodemHalGetRxStats get_rx_stats;
+	struct vmodem_host *host;
+	struct bench b;
+	char conf[64];
+	gboolean ok = FALSE;
+	unsigned int i;
+
+	memset(&b, 0, sizeof(b));
+	b.modem = pty_modem_new(NULL, NULL);
+	if (!b.modem)
+		return FALSE;
+
+	snprintf(conf, sizeof(conf), "[power]\nsave=%s\nstats=true\n", save ? "true" : "false");
+	host = vmodem_host_new(plugin_path, pty_modem_slave(b.modem), conf);
+	if (!host) {
+		pty_modem_free(b.modem);
+		return FALSE;
+	}
+
+	b.loop = g_main_loop_new(NULL, FALSE);
+	b.line = g_string_sized_new(256);
+	b.hal = vmodem_host_hal(host);
+	tcore_hal_add_recv_callback(b.hal, on_recv, &b);
+
+	get_rx_stats = (VmodemHalGetRxStats)vmodem_host_sym(host, "vmodem_hal_get_rx_stats");
+	if (!get_rx_stats)
+		goto out;
+
+	pty_modem_set_rate(b.modem, baud / 10);
+
+	for (i = 0; i < reps; i++) {
+		b.want = b.finals + 1;
+		if (tcore_hal_send_data(b.hal, strlen(BENCH_BULK_CMD), BENCH_BULK_CMD)
+				!= TCORE_RETURN_SUCCESS || !__run_loop(&b))
+			goto out;
+	}
+	b.want = 0;
+
+	b.urcs = count;
+	g_timeout_add(BENCH_URC_GAP_MS, on_urc_due, &b);
+	if (!__run_loop(&b))
+		goto out;
+
+	get_rx_stats(b.hal, &res->rx);
+	res->urc_avg_ms = b.urc_total_us / 1000.0 / count;
+	res->urc_max_ms = b.urc_max_us / 1000.0;
+	ok = TRUE;
+
+out:
+	vmodem_host_free(host);
+	pty_modem_free(b.modem);
+	g_string_free(b.line, TRUE);
+	g_main_loop_unref(b.loop);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *name[2] = { "off", "save" };
+	struct result res;
+	unsigned int reps = 5;
+	unsigned int count = 20;
+	unsigned int baud = 115200;
+	gboolean verbose = FALSE;
+	double minutes;
+	int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:r:n:b:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'b':
+			baud = atoi(optarg);
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-r reps] [-n count] [-b baud] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (reps == 0 || count == 0 || baud < 10)
+		return 2;
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	printf("%u x %s and %u URCs at %u baud\n", reps, "AT+CPBR=1,100", count, baud);
+	printf("%-6s %8s %8s %8s %12s %10s %10s %10s\n", "power", "wakeups", "reads",
+			"batches", "wakeups/min", "cpu us/KB", "urc avg ms", "urc max ms");
+
+	for (i = 0; i < 2; i++) {
+		memset(&res, 0, sizeof(res));
+
+		if (!__run(plugin_path, i == 1, baud, reps, count, &res)) {
+			printf("%-6s FAILED\n", name[i]);
+			return 1;
+		}
+
+		minutes = res.rx.elapsed_us / 60000000.0;
+		printf("%-6s %8llu %8llu %8llu %12.0f %10.1f %10.2f %10.2f\n", name[i],
+				res.rx.wakeups, res.rx.reads, res.rx.deliveries, res.rx.wakeups / minutes,
+				res.rx.cpu_ns / 1000.0 / (res.rx.bytes / 1024.0), res.urc_avg_ms,
+				res.urc_max_ms);
+	}
+
+	return 0;
+}
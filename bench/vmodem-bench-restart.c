@@ -0,0 +1,284 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Daemon restart time, cold vs warm, through the plugin. Each restart
+ * unloads the plugin (the modem stays powered, as when the telephony
+ * server exits) and inits it again against the same pty and [state]
+ * file, then times the first AT answer:
+ *
+ *	cold   [state] warm_restart=false, every init powers the modem on
+ *	warm   warm_restart=true, only the very first init is cold
+ *	reset  warm_restart=true, but the modem is reset between restarts,
+ *	       so GETSTATUS disagrees with the saved state and every init
+ *	       has to fall back to cold
+ *
+ * An emulated power on is free, so pty-modem models the bring-up: after
+ * a cold init its answers leave boot_ms later. With warm_restart on,
+ * whether an init was cold is read back from the state file, which a
+ * power on leaves not good until the modem answers; without, the file
+ * is never written and every init is cold.
+ *
+ *	vmodem-bench-restart [-p plugin.so] [-n restarts] [-B boot_ms] [-v]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "vmodem_config.h"
+#include "vmodem_state.h"
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_WAIT_MS	10000
+
+typedef gboolean (*StateLoad)(struct vmodem_state *st, const char *path);
+typedef int (*PowerOff)(int fd);
+
+enum bench_mode {
+	BENCH_COLD,
+	BENCH_WARM,
+	BENCH_RESET,
+	BENCH_MODES
+};
+
+struct bench {
+	GMainLoop *loop;
+	gboolean answered;
+	gboolean timed_out;
+};
+
+struct result {
+	unsigned int starts[2];		/* [0] cold, [1] warm */
+	gint64 init_us[2];
+	gint64 ready_us[2];
+	gint64 ready_max_us[2];
+};
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct bench *b = user_data;
+
+	if (g_strstr_len(data, data_len, "OK")) {
+		b->answered = TRUE;
+		g_main_loop_quit(b->loop);
+	}
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct bench *b = data;
+
+	b->timed_out = TRUE;
+	g_main_loop_quit(b->loop);
+
+	return FALSE;
+}
+
+/* one daemon start: init, power on, first answer; reset: the modem reboots after exit */
+static gboolean __start(const char *plugin_path, struct pty_modem *modem, const char *conf,
+		const char *state_path, gboolean persist, guint boot_ms, gboolean reset,
+		struct result *res)
+{
+	struct vmodem_host *host;
+	struct vmodem_state st;
+	StateLoad state_load;
+	PowerOff power_off;
+	struct bench b;
+	gint64 t0;
+	gint64 init;
+	gint64 ready;
+	guint timer;
+	int warm;
+
+	memset(&b, 0, sizeof(b));
+
+	t0 = g_get_monotonic_time();
+	host = vmodem_host_new(plugin_path, pty_modem_slave(modem), conf);
+	if (!host)
+		return FALSE;
+	init = g_get_monotonic_time() - t0;
+
+	warm = 0;
+	if (persist) {
+		state_load = (StateLoad)vmodem_host_sym(host, "vmodem_state_load");
+		if (!state_load || !state_load(&st, state_path)) {
+			fprintf(stderr, "no saved state in %s\n", state_path);
+			vmodem_host_free(host);
+			return FALSE;
+		}
+		warm = st.good ? 1 : 0;
+	}
+
+	if (!warm)
+		pty_modem_set_booting(modem, boot_ms);
+
+	b.loop = g_main_loop_new(NULL, FALSE);
+	tcore_hal_add_recv_callback(vmodem_host_hal(host), on_recv, &b);
+	timer = g_timeout_add(BENCH_WAIT_MS, on_timeout, &b);
+
+	if (tcore_hal_send_data(vmodem_host_hal(host), 3, "AT\r") == TCORE_RETURN_SUCCESS)
+		g_main_loop_run(b.loop);
+
+	if (!b.timed_out)
+		g_source_remove(timer);
+	g_main_loop_unref(b.loop);
+
+	/* emulated: the device status lives in the plugin, which stays loaded */
+	power_off = (PowerOff)vmodem_host_sym(host, "vdpram_poweroff");
+	vmodem_host_free(host);
+	if (reset && power_off)
+		power_off(-1);
+
+	if (!b.answered) {
+		fprintf(stderr, "no answer after a %s init\n", warm ? "warm" : "cold");
+		return FALSE;
+	}
+
+	ready = g_get_monotonic_time() - t0;
+
+	res->starts[warm]++;
+	res->init_us[warm] += init;
+	res->ready_us[warm] += ready;
+	if (ready > res->ready_max_us[warm])
+		res->ready_max_us[warm] = ready;
+
+	return TRUE;
+}
+
+static gboolean __run(const char *plugin_path, enum bench_mode mode, unsigned int restarts,
+		guint boot_ms, struct result *res)
+{
+	struct pty_modem *modem;
+	char dir[] = "/tmp/vmodem-bench-restart.XXXXXX";
+	char state_path[64];
+	char conf[128];
+	gboolean ok = TRUE;
+	unsigned int i;
+
+	if (!mkdtemp(dir))
+		return FALSE;
+
+	snprintf(state_path, sizeof(state_path), "%s/vmodem.state", dir);
+	snprintf(conf, sizeof(conf), "[state]\npath=%s\nwarm_restart=%s\n", state_path,
+			mode == BENCH_COLD ? "false" : "true");
+
+	modem = pty_modem_new(NULL, NULL);
+	if (!modem) {
+		rmdir(dir);
+		return FALSE;
+	}
+
+	/* the first start has no saved state yet */
+	for (i = 0; ok && i <= restarts; i++)
+		ok = __start(plugin_path, modem, conf, state_path, mode != BENCH_COLD, boot_ms,
+				mode == BENCH_RESET, res);
+
+	pty_modem_free(modem);
+	unlink(state_path);
+	rmdir(dir);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *name[BENCH_MODES] = { "cold", "warm", "reset" };
+	const char *kind[2] = { "cold", "warm" };
+	struct result res;
+	unsigned int restarts = 20;
+	guint boot_ms = 300;
+	gboolean verbose = FALSE;
+	int i;
+	int k;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:n:B:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'n':
+			restarts = atoi(optarg);
+			break;
+		case 'B':
+			boot_ms = atoi(optarg);
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-n restarts] [-B boot_ms] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (restarts == 0)
+		return 2;
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	printf("%u restarts after a first start, modem bring-up %u ms\n", restarts, boot_ms);
+	printf("%-6s %-5s %6s %12s %14s %14s\n", "mode", "init", "starts", "init avg us",
+			"ready avg ms", "ready max ms");
+
+	for (i = 0; i < BENCH_MODES; i++) {
+		memset(&res, 0, sizeof(res));
+
+		if (!__run(plugin_path, i, restarts, boot_ms, &res)) {
+			printf("%-6s FAILED\n", name[i]);
+			return 1;
+		}
+
+		for (k = 0; k < 2; k++) {
+			if (res.starts[k] == 0)
+				continue;
+
+			printf("%-6s %-5s %6u %12lld %14.2f %14.2f\n", name[i], kind[k], res.starts[k],
+					(long long)(res.init_us[k] / res.starts[k]),
+					res.ready_us[k] / 1000.0 / res.starts[k], res.ready_max_us[k] / 1000.0);
+		}
+
+		/* a reset modem must never be taken for a warm one */
+		if (i != BENCH_WARM && res.starts[1]) {
+			printf("%-6s warm init where a cold one was due\n", name[i]);
+			return 1;
+		}
+		if (i == BENCH_WARM && res.starts[1] != restarts) {
+			printf("%-6s %u of %u restarts warm\n", name[i], res.starts[1], restarts);
+			return 1;
+		}
+	}
+
+	return 0;
+}
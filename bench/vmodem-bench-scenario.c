@@ -0,0 +1,486 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * End-to-end scenarios through the plugin: it is loaded with
+ * plugin_define_desc against the tcore stub and talks to a pty modem.
+ *
+ *	call       dial/hang-up and answer/remote-hang-up, iterations times
+ *	sms        a burst of 100 AT+CMGS with their PDUs, queued at once
+ *	phonebook  a 500 entry sync, AT+CPBR ranges of 10 one after another
+ *
+ * Each reports wall time, CPU time of the process (plugin and responder),
+ * vdpram syscalls (read/write/poll/ioctl on the device) and context
+ * switches, and is compared with the baseline file: a metric more than
+ * its tolerance (and a small absolute floor) above its baseline is a
+ * regression and the exit status is 1. Counts are tight (-t, 10% by
+ * default); times are noisy on a shared machine and get -T (50%).
+ *
+ *	vmodem-bench-scenario [-p plugin.so] [-b baseline] [-w] [-t count_tol] [-T time_tol]
+ *			[-l latency_ms] [-v]
+ *
+ * -w writes the baseline from this run instead of comparing. Syscall
+ * counts carry over between machines; times only on the recording one.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "vdpram.h"
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#ifndef BENCH_BASELINE_PATH
+#define BENCH_BASELINE_PATH	"vmodem-bench-scenario.baseline"
+#endif
+
+#define BENCH_WAIT_MS		10000
+#define BENCH_CALLS			20
+#define BENCH_SMS			100
+#define BENCH_PB_ENTRIES	500
+#define BENCH_PB_STEP		10
+
+#define BENCH_SMS_PDU	"0011000B916407281553F80000AA0AE8329BFD4697D9EC37\x1a"
+
+enum metric {
+	METRIC_WALL_MS,
+	METRIC_CPU_MS,
+	METRIC_SYSCALLS,
+	METRIC_CTXSW,
+	METRIC_MAX
+};
+
+static const char *metric_name[METRIC_MAX] = {
+	"wall_ms", "cpu_ms", "syscalls", "ctxsw"
+};
+
+/* a regression must also be this much worse in absolute terms */
+static const double metric_floor[METRIC_MAX] = {
+	10.0, 5.0, 10.0, 100.0
+};
+
+struct bench {
+	GMainLoop *loop;
+	struct pty_modem *modem;
+	struct vmodem_host *host;
+	TcoreHal *hal;
+
+	void (*get_io_stats)(struct vdpram_io_stats *stats);
+	void (*reset_io_stats)(void);
+
+	GString *line;
+	unsigned int finals;
+	unsigned int rings;
+	unsigned int hangups;
+	gboolean timed_out;
+
+	/* what the current wait is for */
+	unsigned int want_finals;
+	unsigned int want_rings;
+	unsigned int want_hangups;
+};
+
+struct scenario {
+	const char *name;
+	gboolean (*run)(struct bench *b);
+	double value[METRIC_MAX];
+	double base[METRIC_MAX];
+	gboolean has_base;
+};
+
+static gboolean __done(struct bench *b)
+{
+	return b->finals >= b->want_finals && b->rings >= b->want_rings
+		&& b->hangups >= b->want_hangups;
+}
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct bench *b = user_data;
+	const char *p = data;
+	unsigned int i;
+
+	for (i = 0; i < data_len; i++) {
+		if (p[i] != '\r' && p[i] != '\n') {
+			g_string_append_len(b->line, p + i, 1);
+			continue;
+		}
+
+		if (strcmp(b->line->str, "OK") == 0 || strcmp(b->line->str, "ERROR") == 0
+				|| g_str_has_prefix(b->line->str, "+CME ERROR")
+				|| g_str_has_prefix(b->line->str, "+CMS ERROR"))
+			b->finals++;
+		else if (strcmp(b->line->str, "RING") == 0)
+			b->rings++;
+		else if (strcmp(b->line->str, "NO CARRIER") == 0)
+			b->hangups++;
+
+		g_string_truncate(b->line, 0);
+	}
+
+	if (__done(b))
+		g_main_loop_quit(b->loop);
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct bench *b = data;
+
+	b->timed_out = TRUE;
+	g_main_loop_quit(b->loop);
+
+	return FALSE;
+}
+
+static gboolean __send(struct bench *b, const char *data)
+{
+	return tcore_hal_send_data(b->hal, strlen(data), (void *)data) == TCORE_RETURN_SUCCESS;
+}
+
+/* run until finals more final results (and URCs) came in */
+static gboolean __wait(struct bench *b, unsigned int finals, unsigned int rings,
+		unsigned int hangups)
+{
+	guint timer;
+
+	b->want_finals = b->finals + finals;
+	b->want_rings = b->rings + rings;
+	b->want_hangups = b->hangups + hangups;
+
+	if (__done(b))
+		return TRUE;
+
+	b->timed_out = FALSE;
+	timer = g_timeout_add(BENCH_WAIT_MS, on_timeout, b);
+	g_main_loop_run(b->loop);
+
+	if (b->timed_out) {
+		fprintf(stderr, "timed out: %u/%u finals, %u/%u RING, %u/%u NO CARRIER\n",
+				b->finals, b->want_finals, b->rings, b->want_rings,
+				b->hangups, b->want_hangups);
+		return FALSE;
+	}
+
+	g_source_remove(timer);
+	return TRUE;
+}
+
+static gboolean __command(struct bench *b, const char *cmd)
+{
+	return __send(b, cmd) && __wait(b, 1, 0, 0);
+}
+
+static gboolean run_call(struct bench *b)
+{
+	int i;
+
+	for (i = 0; i < BENCH_CALLS; i++) {
+		/* mobile originated, we hang up */
+		if (!__command(b, "ATD0123456789;\r") || !__command(b, "ATH\r"))
+			return FALSE;
+
+		/* mobile terminated, the remote side hangs up */
+		pty_modem_reply(b->modem, "\r\nRING\r\n", 8);
+		if (!__wait(b, 0, 1, 0) || !__command(b, "ATA\r"))
+			return FALSE;
+
+		pty_modem_reply(b->modem, "\r\nNO CARRIER\r\n", 14);
+		if (!__wait(b, 0, 0, 1))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean run_sms(struct bench *b)
+{
+	int i;
+
+	for (i = 0; i < BENCH_SMS; i++) {
+		if (!__send(b, "AT+CMGS=24\r") || !__send(b, BENCH_SMS_PDU))
+			return FALSE;
+	}
+
+	return __wait(b, BENCH_SMS, 0, 0);
+}
+
+static gboolean run_phonebook(struct bench *b)
+{
+	char cmd[32];
+	int i;
+
+	if (!__command(b, "AT+CPBS=\"SM\"\r") || !__command(b, "AT+CPBR=?\r"))
+		return FALSE;
+
+	for (i = 1; i <= BENCH_PB_ENTRIES; i += BENCH_PB_STEP) {
+		snprintf(cmd, sizeof(cmd), "AT+CPBR=%d,%d\r", i, i + BENCH_PB_STEP - 1);
+		if (!__command(b, cmd))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static struct scenario scenarios[] = {
+	{ "call", run_call },
+	{ "sms", run_sms },
+	{ "phonebook", run_phonebook },
+};
+
+static double __tv_ms(const struct timeval *tv)
+{
+	return tv->tv_sec * 1000.0 + tv->tv_usec / 1000.0;
+}
+
+static gboolean __measure(struct bench *b, struct scenario *s)
+{
+	struct rusage ru0;
+	struct rusage ru1;
+	struct vdpram_io_stats io;
+	gint64 t0;
+	gboolean ok;
+
+	b->reset_io_stats();
+	getrusage(RUSAGE_SELF, &ru0);
+	t0 = g_get_monotonic_time();
+
+	ok = s->run(b);
+
+	s->value[METRIC_WALL_MS] = (g_get_monotonic_time() - t0) / 1000.0;
+	getrusage(RUSAGE_SELF, &ru1);
+	b->get_io_stats(&io);
+
+	s->value[METRIC_CPU_MS] = __tv_ms(&ru1.ru_utime) - __tv_ms(&ru0.ru_utime)
+		+ __tv_ms(&ru1.ru_stime) - __tv_ms(&ru0.ru_stime);
+	s->value[METRIC_SYSCALLS] = io.reads + io.writes + io.waits + io.ctl;
+	s->value[METRIC_CTXSW] = (ru1.ru_nvcsw - ru0.ru_nvcsw) + (ru1.ru_nivcsw - ru0.ru_nivcsw);
+
+	return ok;
+}
+
+/* "<scenario> <wall_ms> <cpu_ms> <syscalls> <ctxsw>" per line, # comments */
+static void __load_baseline(const char *path)
+{
+	char line[256];
+	char name[32];
+	double v[METRIC_MAX];
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "no baseline %s, nothing to compare\n", path);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%31s %lf %lf %lf %lf", name, &v[0], &v[1], &v[2], &v[3]) != 5)
+			continue;
+
+		for (i = 0; i < G_N_ELEMENTS(scenarios); i++) {
+			if (strcmp(scenarios[i].name, name) == 0) {
+				memcpy(scenarios[i].base, v, sizeof(v));
+				scenarios[i].has_base = TRUE;
+			}
+		}
+	}
+
+	fclose(fp);
+}
+
+static int __save_baseline(const char *path, guint latency_ms)
+{
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "cannot write %s\n", path);
+		return -1;
+	}
+
+	fprintf(fp, "# vmodem-bench-scenario baseline, responder latency %u ms\n", latency_ms);
+	fprintf(fp, "# scenario wall_ms cpu_ms syscalls ctxsw\n");
+	for (i = 0; i < G_N_ELEMENTS(scenarios); i++)
+		fprintf(fp, "%s %.1f %.1f %.0f %.0f\n", scenarios[i].name,
+				scenarios[i].value[METRIC_WALL_MS], scenarios[i].value[METRIC_CPU_MS],
+				scenarios[i].value[METRIC_SYSCALLS], scenarios[i].value[METRIC_CTXSW]);
+
+	fclose(fp);
+	printf("baseline written to %s\n", path);
+
+	return 0;
+}
+
+/* number of regressed metrics, printed as they are found */
+static int __compare(struct scenario *s, double count_tol, double time_tol)
+{
+	int regressions = 0;
+	double tolerance;
+	double limit;
+	int m;
+
+	if (!s->has_base)
+		return 0;
+
+	for (m = 0; m < METRIC_MAX; m++) {
+		tolerance = (m == METRIC_WALL_MS || m == METRIC_CPU_MS) ? time_tol : count_tol;
+		limit = s->base[m] * (1.0 + tolerance / 100.0);
+		if (s->value[m] > limit && s->value[m] - s->base[m] > metric_floor[m]) {
+			printf("REGRESSION %s %s: %.1f, baseline %.1f (+%.0f%%, limit +%.0f%%)\n",
+					s->name, metric_name[m], s->value[m], s->base[m],
+					(s->value[m] / s->base[m] - 1.0) * 100.0, tolerance);
+			regressions++;
+		}
+	}
+
+	return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *baseline = BENCH_BASELINE_PATH;
+	gboolean record = FALSE;
+	gboolean verbose = FALSE;
+	double count_tol = 10.0;
+	double time_tol = 50.0;
+	guint latency_ms = 1;
+	struct bench b;
+	struct scenario *s;
+	unsigned int i;
+	int regressions = 0;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:b:wt:T:l:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		case 'w':
+			record = TRUE;
+			break;
+		case 't':
+			count_tol = atof(optarg);
+			break;
+		case 'T':
+			time_tol = atof(optarg);
+			break;
+		case 'l':
+			latency_ms = atoi(optarg);
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-b baseline] [-w] [-t count_tol] [-T time_tol] [-l latency_ms] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	memset(&b, 0, sizeof(b));
+	b.loop = g_main_loop_new(NULL, FALSE);
+	b.line = g_string_sized_new(256);
+
+	b.modem = pty_modem_new(NULL, NULL);
+	if (!b.modem)
+		return 1;
+	pty_modem_set_latency(b.modem, latency_ms);
+
+	b.host = vmodem_host_new(plugin_path, pty_modem_slave(b.modem), NULL);
+	if (!b.host)
+		return 1;
+
+	b.hal = vmodem_host_hal(b.host);
+	b.get_io_stats = vmodem_host_sym(b.host, "vdpram_get_io_stats");
+	b.reset_io_stats = vmodem_host_sym(b.host, "vdpram_reset_io_stats");
+	if (!b.get_io_stats || !b.reset_io_stats) {
+		fprintf(stderr, "plugin has no vdpram io stats\n");
+		return 1;
+	}
+
+	tcore_hal_add_recv_callback(b.hal, on_recv, &b);
+
+	if (!record)
+		__load_baseline(baseline);
+
+	printf("responder latency %u ms, tolerance +%.0f%% counts, +%.0f%% times\n", latency_ms,
+			count_tol, time_tol);
+	printf("%-10s %9s %9s %9s %7s   %s\n", "scenario", "wall ms", "cpu ms", "syscalls", "ctxsw",
+			"baseline wall/cpu/syscalls/ctxsw");
+
+	for (i = 0; i < G_N_ELEMENTS(scenarios); i++) {
+		s = &scenarios[i];
+
+		if (!__measure(&b, s)) {
+			printf("%-10s FAILED\n", s->name);
+			failed++;
+			continue;
+		}
+
+		printf("%-10s %9.1f %9.1f %9.0f %7.0f", s->name, s->value[METRIC_WALL_MS],
+				s->value[METRIC_CPU_MS], s->value[METRIC_SYSCALLS], s->value[METRIC_CTXSW]);
+		if (s->has_base)
+			printf("   %.1f/%.1f/%.0f/%.0f", s->base[METRIC_WALL_MS], s->base[METRIC_CPU_MS],
+					s->base[METRIC_SYSCALLS], s->base[METRIC_CTXSW]);
+		printf("\n");
+	}
+
+	if (record && !failed) {
+		if (__save_baseline(baseline, latency_ms) < 0)
+			failed++;
+	}
+	else if (!record) {
+		for (i = 0; i < G_N_ELEMENTS(scenarios); i++)
+			regressions += __compare(&scenarios[i], count_tol, time_tol);
+	}
+
+	vmodem_host_free(b.host);
+	pty_modem_free(b.modem);
+	g_string_free(b.line, TRUE);
+	g_main_loop_unref(b.loop);
+
+	if (failed || regressions) {
+		printf("%d scenario(s) failed, %d regression(s)\n", failed, regressions);
+		return 1;
+	}
+
+	return 0;
+}
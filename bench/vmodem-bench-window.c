@@ -0,0 +1,242 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Pipelining gain for bulk reads. tcore-style traffic (N commands queued
+ * at once, one per entry) goes through the plugin to a pty responder
+ * that answers each command latency_ms after it arrives; the same run is
+ * repeated per [tx] window and compared with window 1, which is what
+ * strict one-at-a-time sequencing costs.
+ *
+ *	vmodem-bench-window [-p plugin.so] [-l latency_ms] [-n count] [-w 1,2,4,8,0] [-v]
+ *
+ * Window 0 is "no limit": everything is written as soon as it is queued.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define BENCH_WINDOWS_DEFAULT	"1,2,4,8,0"
+
+struct workload {
+	const char *name;
+	const char *cmd;	/* one command per entry, followed by the index */
+};
+
+static const struct workload workloads[] = {
+	{ "phonebook", "AT+CPBR=" },
+	{ "sms-list", "AT+CMGR=" },
+};
+
+struct run {
+	GMainLoop *loop;
+	GString *line;
+	unsigned int finals;
+	unsigned int want;
+	gboolean timed_out;
+};
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct run *r = user_data;
+	const char *p = data;
+	unsigned int i;
+
+	for (i = 0; i < data_len; i++) {
+		if (p[i] != '\r' && p[i] != '\n') {
+			g_string_append_len(r->line, p + i, 1);
+			continue;
+		}
+
+		if (strcmp(r->line->str, "OK") == 0 || strcmp(r->line->str, "ERROR") == 0
+				|| g_str_has_prefix(r->line->str, "+CME ERROR"))
+			r->finals++;
+
+		g_string_truncate(r->line, 0);
+	}
+
+	if (r->finals >= r->want)
+		g_main_loop_quit(r->loop);
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct run *r = data;
+
+	r->timed_out = TRUE;
+	g_main_loop_quit(r->loop);
+
+	return FALSE;
+}
+
+/* wall time in usec for count commands through the plugin, -1 on failure */
+static gint64 __run(const char *plugin_path, const struct workload *w, guint window,
+		guint latency_ms, unsigned int count)
+{
+	struct pty_modem *modem;
+	struct vmodem_host *host;
+	struct run r;
+	char conf[64];
+	char cmd[32];
+	TcoreHal *hal;
+	gint64 start;
+	gint64 elapsed = -1;
+	guint timer;
+	unsigned int i;
+	int len;
+
+	modem = pty_modem_new(NULL, NULL);
+	if (!modem)
+		return -1;
+	pty_modem_set_latency(modem, latency_ms);
+
+	snprintf(conf, sizeof(conf), "[tx]\nwindow=%u\n", window);
+	host = vmodem_host_new(plugin_path, pty_modem_slave(modem), conf);
+	if (!host) {
+		pty_modem_free(modem);
+		return -1;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.loop = g_main_loop_new(NULL, FALSE);
+	r.line = g_string_sized_new(128);
+	r.want = count;
+
+	hal = vmodem_host_hal(host);
+	tcore_hal_add_recv_callback(hal, on_recv, &r);
+
+	start = g_get_monotonic_time();
+
+	for (i = 1; i <= count; i++) {
+		len = snprintf(cmd, sizeof(cmd), "%s%u\r", w->cmd, i);
+		if (tcore_hal_send_data(hal, len, cmd) != TCORE_RETURN_SUCCESS) {
+			fprintf(stderr, "%s: send %u failed\n", w->name, i);
+			goto out;
+		}
+	}
+
+	timer = g_timeout_add(count * latency_ms * 2 + 5000, on_timeout, &r);
+	g_main_loop_run(r.loop);
+	if (!r.timed_out)
+		g_source_remove(timer);
+
+	if (r.timed_out)
+		fprintf(stderr, "%s window %u: %u/%u answers, timed out\n",
+				w->name, window, r.finals, count);
+	else
+		elapsed = g_get_monotonic_time() - start;
+
+out:
+	vmodem_host_free(host);
+	pty_modem_free(modem);
+	g_string_free(r.line, TRUE);
+	g_main_loop_unref(r.loop);
+
+	return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = "./vmodem-plugin.so";
+	const char *windows = BENCH_WINDOWS_DEFAULT;
+	guint latency_ms = 20;
+	unsigned int count = 100;
+	gboolean verbose = FALSE;
+	gchar **list;
+	gint64 base;
+	gint64 t;
+	guint window;
+	unsigned int i;
+	int j;
+	int opt;
+	int ret = 0;
+
+	while ((opt = getopt(argc, argv, "p:l:n:w:v")) != -1) {
+		switch (opt) {
+		case 'p':
+			plugin_path = optarg;
+			break;
+		case 'l':
+			latency_ms = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'w':
+			windows = optarg;
+			break;
+		case 'v':
+			verbose = TRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p plugin.so] [-l latency_ms] [-n count] [-w 1,2,4,8,0] [-v]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (count == 0)
+		return 2;
+
+	if (!verbose)
+		setenv("TCORE_STUB_QUIET", "1", 1);
+
+	list = g_strsplit(windows, ",", 0);
+
+	printf("%u commands per run, responder latency %u ms\n", count, latency_ms);
+	printf("%-10s %8s %10s %10s %8s\n", "workload", "window", "total ms", "ms/cmd", "speedup");
+
+	for (i = 0; i < G_N_ELEMENTS(workloads); i++) {
+		base = -1;
+
+		for (j = 0; list[j]; j++) {
+			window = atoi(list[j]);
+
+			t = __run(plugin_path, &workloads[i], window, latency_ms, count);
+			if (t < 0) {
+				ret = 1;
+				continue;
+			}
+
+			/* the first window listed is the reference, 1 by default */
+			if (base < 0)
+				base = t;
+
+			printf("%-10s %8s %10.1f %10.2f %7.1fx\n", workloads[i].name,
+					window ? list[j] : "none", t / 1000.0, t / 1000.0 / count,
+					(double)base / t);
+		}
+	}
+
+	g_strfreev(list);
+
+	return ret;
+}
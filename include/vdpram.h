@@ -21,13 +21,47 @@
 #ifndef __VDPRAM_H__
 #define __VDPRAM_H__
 
+struct vdpram_tty_profile {
+	const char *baudrate;	/* "115200" */
+	const char *parity;		/* "N", "E", "O", "M", "S" */
+	const char *bits;		/* "5".."8" */
+	const char *stop;		/* "1", "2" */
+	int hwf;				/* RTS/CTS */
+	int swf;				/* XON/XOFF */
+};
+
+struct vdpram_io_stats {
+	unsigned long long reads;			/* read() calls */
+	unsigned long long read_bytes;
+	unsigned long long read_errors;
+	unsigned long long writes;			/* write() calls */
+	unsigned long long write_bytes;
+	unsigned long long write_retries;	/* EAGAIN/EBUSY */
+	unsigned long long write_errors;
+	unsigned long long write_drops;		/* gave up after retry_max */
+	unsigned long long short_writes;
+	unsigned long long waits;			/* select()/poll() while backed up */
+	unsigned long long ctl;				/* ioctl()/tcsetattr() */
+};
+
 int vdpram_close(int fd);
 int vdpram_open (void);
+int vdpram_open_path(const char *path, const struct vdpram_tty_profile *profile);
+int vdpram_set_profile(int fd, const struct vdpram_tty_profile *profile);
+void vdpram_set_retry_policy(int count, int sleep_us, int backoff);
+void vdpram_set_power_save(int on);
+void vdpram_set_emulated(int on);
 int vdpramerr_open(void);
+int vdpram_getstatus(int fd, unsigned int *status);
 int vdpram_poweron(int fd);
 int vdpram_poweroff(int fd);
+int vdpram_set_flow_control(int fd, int on);
+
+void vdpram_get_io_stats(struct vdpram_io_stats *stats);
+void vdpram_reset_io_stats(void);
 
 int vdpram_tty_read(int nFd, void* buf, size_t nbytes);
 int vdpram_tty_write(int nFd, void* buf, size_t nbytes);
+int vdpram_tty_write_once(int nFd, const void *buf, size_t nbytes);
 
 #endif
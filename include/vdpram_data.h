@@ -0,0 +1,51 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VDPRAM_DATA_H__
+#define __VDPRAM_DATA_H__
+
+struct vdpram_data_stats {
+	unsigned long long rx_bytes;	/* modem -> peer */
+	unsigned long long tx_bytes;	/* peer -> modem */
+	unsigned long long spliced;	/* bytes moved without a user-space copy */
+	unsigned long long rx_packets;	/* packet peers only */
+	unsigned long long tx_packets;
+	long long elapsed_us;
+	int ended;			/* peer closed or I/O error, not stopped */
+};
+
+struct vdpram_data;
+
+/*
+ * Data mode endpoints: a tun interface (raw IP) or a pty master (PPP).
+ * A pty carries PPP's own HDLC framing and is passed through as is. A
+ * packet peer (tun, or a SOCK_SEQPACKET/SOCK_DGRAM socket) gets one IP
+ * packet per read and write, and vdpram does not keep write boundaries:
+ * on the vdpram side each packet then travels as a 16-bit big-endian
+ * length followed by the packet, and the modem end frames the same way.
+ */
+int vdpram_data_open_tun(const char *ifname);
+int vdpram_data_open_pty(char *slave_name, size_t len);
+
+struct vdpram_data *vdpram_data_start(int vdpram_fd, int peer_fd);
+void vdpram_data_stop(struct vdpram_data *dm, struct vdpram_data_stats *stats);
+int vdpram_data_exit_fd(struct vdpram_data *dm);
+
+#endif
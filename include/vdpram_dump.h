@@ -1,30 +1,73 @@
-/*
- * tel-plugin-vmodem
- *
- * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
- *
- * Contact: Junhwan An <jh48.an@samsung.com>
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- * http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#ifndef __VDPRAM_DUMP_H__
-#define __VDPRAM_DUMP_H__
-
-#define IPC_TX	0
-#define IPC_RX	1
-
-void vdpram_hex_dump(int dir, unsigned short data_len, void *data);
-
-#endif
-
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VDPRAM_DUMP_H__
+#define __VDPRAM_DUMP_H__
+
+#define IPC_TX	0
+#define IPC_RX	1
+
+#define VDPRAM_DUMP_NONE	0
+#define VDPRAM_DUMP_SUMMARY	1	/* one line per frame */
+#define VDPRAM_DUMP_HEX		2	/* plus a hex dump */
+
+/*
+ * Capture file record: struct vdpram_capture_header followed by len
+ * bytes of raw frame data, in host byte order.
+ */
+struct vdpram_capture_header {
+	unsigned long long timestamp_us;	/* CLOCK_MONOTONIC */
+	unsigned int dir;					/* IPC_TX or IPC_RX */
+	unsigned int len;
+};
+
+/*
+ * The dump and capture code lives in a separate module (vmodem-dump.so)
+ * that is only loaded once diagnostics are turned on; the plugin itself
+ * only tests one pointer per frame. Off target, VMODEM_DUMP_MODULE in
+ * the environment overrides the path, e.g. to the one in a build tree.
+ */
+#ifndef VDPRAM_DUMP_MODULE_PATH
+#define VDPRAM_DUMP_MODULE_PATH		"/usr/lib/telephony/vmodem/vmodem-dump.so"
+#endif
+
+struct vdpram_dump_ops {
+	void (*set_level)(int level);
+	int (*set_capture)(const char *path);
+	void (*frame)(int dir, int data_len, void *data);
+};
+
+/* exported by the module */
+extern const struct vdpram_dump_ops vdpram_dump_module;
+
+/* NULL while diagnostics are off */
+extern const struct vdpram_dump_ops *vdpram_dump;
+
+#define VDPRAM_DUMP_FRAME(dir, data_len, data) \
+	do { \
+		if (__builtin_expect(vdpram_dump != NULL, 0)) \
+			vdpram_dump->frame(dir, data_len, data); \
+	} while (0)
+
+/* load the module on first use; level NONE and no capture turn it off */
+int vdpram_dump_configure(int level, const char *capture_path);
+
+#endif
+
@@ -0,0 +1,67 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __VDPRAM_FAULT_H__
+#define __VDPRAM_FAULT_H__
+
+/*
+ * Fault injection for the vdpram I/O paths (ENABLE_FAULT_INJECTION).
+ *
+ * The spec comes from vdpram_fault_configure() or, if that was never
+ * called, from the VDPRAM_FAULT environment variable:
+ *
+ *	seed=42,write.eagain=0.05,write.short=0.01,read.eio=0.001,
+ *	tcsetattr.script=eio,ioctl.script=ok/ok/eio
+ *
+ * <op>.<kind>=<p> injects kind with probability p; <op>.script=k1/k2/..
+ * injects the listed kinds on the next calls, in order, before the
+ * probabilities apply. op is read, write, ioctl or tcsetattr; kind is
+ * ok, eagain, ebusy, eio or short (read and write only: half the length
+ * goes through).
+ */
+
+#ifdef VDPRAM_FAULT_INJECTION
+
+struct termios;
+
+int vdpram_fault_configure(const char *spec);
+void vdpram_fault_dump(void);
+
+ssize_t vdpram_fault_read(int fd, void *buf, size_t nbytes);
+ssize_t vdpram_fault_write(int fd, const void *buf, size_t nbytes);
+int vdpram_fault_ioctl(int fd, unsigned long request, void *arg);
+int vdpram_fault_tcsetattr(int fd, int action, const struct termios *tio);
+
+#define VDPRAM_READ			vdpram_fault_read
+#define VDPRAM_WRITE		vdpram_fault_write
+#define VDPRAM_IOCTL		vdpram_fault_ioctl
+#define VDPRAM_TCSETATTR	vdpram_fault_tcsetattr
+
+#else
+
+#define VDPRAM_READ			read
+#define VDPRAM_WRITE		write
+#define VDPRAM_IOCTL		ioctl
+#define VDPRAM_TCSETATTR	tcsetattr
+
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VDPRAM_SHM_H__
+#define __VDPRAM_SHM_H__
+
+/*
+ * Shared memory DPRAM mailbox: a header with two byte rings (one per
+ * direction) followed by their data areas. Each side owns the head of
+ * the ring it produces and the tail of the ring it consumes; a doorbell
+ * with eventfd semantics (8 byte counter write/read, POLLIN when rung)
+ * tells the peer that its RX ring has new data. tx_bell and rx_bell must
+ * be separate nodes: on a shared one either side's read takes the other
+ * side's ring, and wakeups are lost. A read that leaves data behind wakes
+ * only its own side, through a private eventfd polled with rx_bell.
+ *
+ * Ring indices come from the peer: a read or write that finds head and
+ * tail more than a ring apart fails with EPROTO instead of copying.
+ *
+ * vdpram_shm_create_memfd() builds the same layout on a memfd with two
+ * eventfds, so both sides can run on plain Linux.
+ */
+
+#define VDPRAM_SHM_MAGIC	0x52504456	/* "VDPR" */
+#define VDPRAM_SHM_VERSION	1
+
+#define VDPRAM_SHM_SIDE_AP		0	/* produces ring 0, consumes ring 1 */
+#define VDPRAM_SHM_SIDE_MODEM	1
+
+struct vdpram_shm_ring {
+	unsigned int head;		/* free running, written by the producer */
+	unsigned int tail;		/* free running, written by the consumer */
+	unsigned int size;		/* power of two */
+	unsigned int offset;	/* of the data area from the region start */
+};
+
+struct vdpram_shm_header {
+	unsigned int magic;
+	unsigned int version;
+	struct vdpram_shm_ring ring[2];
+};
+
+struct vdpram_shm;
+
+int vdpram_shm_create_memfd(unsigned int ring_size, int *mem_fd, int bells[2]);
+
+struct vdpram_shm *vdpram_shm_attach(int mem_fd, int side, int tx_bell, int rx_bell);
+void vdpram_shm_detach(struct vdpram_shm *shm);
+
+/* fd that becomes readable when the peer rang or data was left behind */
+int vdpram_shm_fd(struct vdpram_shm *shm);
+
+int vdpram_shm_write(struct vdpram_shm *shm, const void *buf, size_t nbytes);
+int vdpram_shm_read(struct vdpram_shm *shm, void *buf, size_t nbytes);
+
+#endif
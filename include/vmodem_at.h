@@ -0,0 +1,56 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_AT_H__
+#define __VMODEM_AT_H__
+
+/*
+ * Minimal AT stream inspection for the HAL. A line is one CR/LF
+ * delimited segment without its terminator.
+ */
+
+typedef gboolean (*VmodemAtLineFunc)(const char *line, unsigned int len);
+
+/* OK, ERROR, +CME/+CMS ERROR and the SMS "> " prompt */
+gboolean vmodem_at_is_final_result(const char *line, unsigned int len);
+
+/* NO CARRIER, NO ANSWER, NO DIALTONE, BUSY, CONNECT */
+gboolean vmodem_at_is_call_result(const char *line, unsigned int len);
+
+/* final result of cmd (a vmodem_at_command_name()); call results only end D, A, O and +CGDATA */
+gboolean vmodem_at_is_final_for(const char *cmd, const char *line, unsigned int len);
+
+/* URCs that must reach tcore without delay (incoming call/SMS, call end) */
+gboolean vmodem_at_is_urgent_urc(const char *line, unsigned int len);
+
+/*
+ * A line that is not part of cmd's answer: cmd NULL (nothing awaited),
+ * or a "+NAME:" line of another command. A vendor answering under a
+ * different prefix only costs an early flush.
+ */
+gboolean vmodem_at_is_unsolicited(const char *cmd, const char *line, unsigned int len);
+
+/* "AT+CSQ?" -> "+CSQ", "ATD123;" -> "D", "AT" -> "AT"; FALSE if not an AT command */
+gboolean vmodem_at_command_name(const char *data, unsigned int len, char *name, unsigned int size);
+
+/* TRUE if any line of data, including an unterminated last one, matches */
+gboolean vmodem_at_scan(const char *data, unsigned int len, VmodemAtLineFunc match);
+
+#endif
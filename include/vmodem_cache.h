@@ -0,0 +1,88 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __VMODEM_CACHE_H__
+#define __VMODEM_CACHE_H__
+
+/*
+ * Response cache for idempotent status queries (+CSQ, +COPS?, +CREG?,
+ * +CGREG?, +CBC, +CCLK?). A query repeated within its TTL is answered
+ * from the last OK response instead of the modem, as long as nothing
+ * else is queued or in flight, so the answer cannot overtake another
+ * one. The same query issued while it is still the last command in
+ * flight is collapsed into it and gets a copy of its answer.
+ *
+ * An entry is dropped when a URC touching it arrives (+CREG: for
+ * +CREG? and +COPS?, +CIEV: for +CSQ, ...), when a set command of the
+ * same name or +CFUN goes out, and on every power change.
+ */
+
+#define VMODEM_CACHE_RULE_MAX	6
+
+/* hand a response to tcore; called from an idle callback, in order */
+typedef void (*VmodemCacheEmit)(const char *data, unsigned int len, void *user_data);
+
+enum vmodem_cache_result {
+	VMODEM_CACHE_MISS,			/* send it */
+	VMODEM_CACHE_HIT,			/* answered from the cache */
+	VMODEM_CACHE_COLLAPSED,		/* answered with the one in flight */
+};
+
+struct vmodem_cache_stats {
+	unsigned long long lookups;		/* cacheable queries seen */
+	unsigned long long hits;
+	unsigned long long collapsed;
+	unsigned long long stored;
+	unsigned long long invalidated;
+};
+
+struct vmodem_cache;
+
+/* config key ("csq_ms", ...) and default TTL of rule i */
+const char *vmodem_cache_rule_key(int i);
+unsigned int vmodem_cache_rule_default_ttl(int i);
+
+struct vmodem_cache *vmodem_cache_new(VmodemCacheEmit emit, void *user_data);
+void vmodem_cache_free(struct vmodem_cache *c);
+
+void vmodem_cache_set_enabled(struct vmodem_cache *c, gboolean enabled);
+void vmodem_cache_set_ttl(struct vmodem_cache *c, const unsigned int ttl_ms[VMODEM_CACHE_RULE_MAX]);
+
+/*
+ * Before queueing. can_serve: nothing queued or in flight. tail: tag of
+ * the last command in flight if nothing is queued behind it, else NULL.
+ */
+enum vmodem_cache_result vmodem_cache_lookup(struct vmodem_cache *c, const char *data,
+		unsigned int len, gboolean can_serve, void *tail);
+
+/* a command was written; returns the pipeline tag for it */
+void *vmodem_cache_sent(struct vmodem_cache *c, const char *data, unsigned int len);
+
+/* VmodemPipelineLine */
+void vmodem_cache_line(struct vmodem_cache *c, void *tag, const char *line, unsigned int len,
+		gboolean final);
+
+void vmodem_cache_reset(struct vmodem_cache *c);
+
+void vmodem_cache_get_stats(struct vmodem_cache *c, struct vmodem_cache_stats *stats);
+void vmodem_cache_dump(struct vmodem_cache *c);
+
+#endif
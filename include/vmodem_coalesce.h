@@ -0,0 +1,75 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_COALESCE_H__
+#define __VMODEM_COALESCE_H__
+
+/*
+ * RX wakeup coalescing for power save. With a window of 0 every chunk
+ * is delivered as it is read. Otherwise a chunk that leaves a response
+ * unfinished starts a window: the caller stops watching the fd (hold),
+ * whatever the modem sends meanwhile piles up in the driver, and when
+ * the window ends it is read in one go (drain) and delivered with the
+ * batch. A burst of N chunks then costs two wakeups instead of N.
+ *
+ * Urgent traffic is not held back: the fd is only unwatched while a
+ * response is already streaming in, so a URC from idle (RING, +CMT)
+ * wakes at once, and a batch holding an urgent URC or a final result
+ * is flushed without waiting for the window. So is a batch that ends in
+ * a complete unsolicited line (vmodem_at_is_unsolicited against the
+ * command awaiting its answer, any line when none is): nothing more of
+ * it is coming, a window would only delay it.
+ */
+
+typedef void (*VmodemCoalesceDeliver)(const char *data, unsigned int len, void *user_data);
+
+/*
+ * hold TRUE: stop watching the fd. hold FALSE: watch it again; with
+ * drain also read what is pending right now and push it.
+ */
+typedef void (*VmodemCoalesceHold)(gboolean hold, gboolean drain, void *user_data);
+
+struct vmodem_coalesce_stats {
+	unsigned long long wakeups;		/* RX callbacks and window ends */
+	unsigned long long reads;		/* chunks pushed */
+	unsigned long long deliveries;	/* chunks handed to tcore */
+	unsigned long long bytes;
+	unsigned long long cpu_ns;		/* RX path CPU time, when accounted */
+	gint64 since;					/* monotonic usec */
+};
+
+struct vmodem_coalesce;
+
+struct vmodem_coalesce *vmodem_coalesce_new(guint window_ms, unsigned int size,
+		VmodemCoalesceDeliver deliver, VmodemCoalesceHold hold, void *user_data);
+void vmodem_coalesce_free(struct vmodem_coalesce *c);
+
+void vmodem_coalesce_set_window(struct vmodem_coalesce *c, guint window_ms);
+
+/* awaiting: vmodem_at_command_name() of the command being answered, or NULL */
+void vmodem_coalesce_push(struct vmodem_coalesce *c, const char *data, unsigned int len,
+		const char *awaiting);
+void vmodem_coalesce_flush(struct vmodem_coalesce *c);
+
+void vmodem_coalesce_account_cpu(struct vmodem_coalesce *c, unsigned long long ns);
+void vmodem_coalesce_get_stats(struct vmodem_coalesce *c, struct vmodem_coalesce_stats *stats);
+void vmodem_coalesce_dump(struct vmodem_coalesce *c);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_CONFIG_H__
+#define __VMODEM_CONFIG_H__
+
+#include "vmodem_cache.h"
+
+#ifndef VMODEM_CONFIG_PATH
+#define VMODEM_CONFIG_PATH	"/opt/etc/telephony/vmodem.conf"
+#endif
+
+#define VMODEM_CONFIG_STR_MAX	128
+
+/*
+ * Runtime tuning, read at init and on every reload (SIGHUP or
+ * vmodem_hal_reload_config()). Missing file or keys keep the defaults.
+ *
+ *	[device]	path, read_buffer, backend (tty or shm), shm_path,
+ *			shm_doorbell_rx, shm_doorbell_tx (the modem rings rx, we ring tx),
+ *			emulated (no DPRAM driver behind path, e.g. a pty: power
+ *			and status ioctls are faked)
+ *	[tty]		baudrate, parity, bits, stop, hw_flow, sw_flow
+ *	[retry]		count, sleep_us, backoff (TX writes that take nothing; past
+ *			count in a row the command is dropped)
+ *	[debug]		dump_level (0 none, 1 summary, 2 hex), capture, capture_path,
+ *			fault (vdpram_fault.h spec, ENABLE_FAULT_INJECTION builds only),
+ *			profile (per AT command cost table, see vmodem_prof.h)
+ *	[watchdog]	deadline_ms (0, the default: no watchdog; slow network
+ *			commands get their pipeline timeout instead), recover_ms
+ *	[power]		save, coalesce_ms, stats
+ *	[tx]		aging_ms (a queued command gains one class per aging_ms),
+ *			window (AT commands in flight, 0: no limit), window_timeout_ms
+ *	[state]		path, warm_restart
+ *	[cache]		enable, csq_ms, cops_ms, creg_ms, cgreg_ms, cbc_ms, cclk_ms (0: not cached)
+ *	[control]	sighup (reload on SIGHUP), sigusr1 (dump stats on SIGUSR1);
+ *			both off by default, the signals belong to the daemon
+ *
+ * The [device], [state] and [control] keys only take effect at init.
+ *
+ * Off-target (USE_TCORE_STUB) builds read the file named by the
+ * VMODEM_CONFIG environment variable instead, when it is set.
+ */
+struct vmodem_config {
+	char device_path[VMODEM_CONFIG_STR_MAX];
+	char backend[8];
+	char shm_path[VMODEM_CONFIG_STR_MAX];
+	char shm_doorbell_rx[VMODEM_CONFIG_STR_MAX];
+	char shm_doorbell_tx[VMODEM_CONFIG_STR_MAX];
+	unsigned int read_buf_len;
+	int emulated;
+
+	char baudrate[16];
+	char parity[2];
+	char bits[2];
+	char stop[2];
+	int hw_flow;
+	int sw_flow;
+
+	int retry_count;
+	int retry_sleep_us;
+	int retry_backoff;
+
+	int dump_level;
+	int capture;
+	char capture_path[VMODEM_CONFIG_STR_MAX];
+	char fault_spec[VMODEM_CONFIG_STR_MAX];
+	int profile;
+
+	unsigned int watchdog_deadline_ms;
+	unsigned int watchdog_recover_ms;
+
+	unsigned int tx_aging_ms;
+	unsigned int tx_window;
+	unsigned int tx_window_timeout_ms;
+
+	int power_save;
+	unsigned int coalesce_ms;
+	int power_stats;
+
+	char state_path[VMODEM_CONFIG_STR_MAX];
+	int warm_restart;
+
+	int cache_enable;
+	unsigned int cache_ttl_ms[VMODEM_CACHE_RULE_MAX];
+
+	int sighup;
+	int sigusr1;
+};
+
+const char *vmodem_config_path(void);
+void vmodem_config_init(struct vmodem_config *cfg);
+gboolean vmodem_config_load(struct vmodem_config *cfg, const char *path);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_HAL_H__
+#define __VMODEM_HAL_H__
+
+/*
+ * Control entry points for other plugins (installed as
+ * telephony/vmodem_hal.h). The telephony daemon loads plugins with
+ * local symbols, so a caller resolves them from the loaded plugin:
+ *
+ *	handle = dlopen(VMODEM_HAL_PLUGIN, RTLD_NOW | RTLD_NOLOAD);
+ *	reload = (VmodemHalReloadConfig)dlsym(handle, "vmodem_hal_reload_config");
+ *	reload(tcore_server_find_hal(server, VMODEM_HAL_NAME));
+ */
+
+#define VMODEM_HAL_PLUGIN	"vmodem-plugin.so"
+#define VMODEM_HAL_NAME		"vmodem"
+
+typedef TReturn (*VmodemHalReloadConfig)(TcoreHal *hal);
+typedef void (*VmodemHalDumpStats)(TcoreHal *hal);
+
+/*
+ * Data mode: once the modem answered CONNECT, hand the channel to a
+ * passthrough thread between vdpram and peer_fd (see vdpram_data.h).
+ * AT traffic through hal_send fails until data mode is left again;
+ * that happens by itself when the peer closes (pppd exits) or the
+ * passthrough fails. A pty peer may be opened after entering.
+ */
+TReturn vmodem_hal_enter_data_mode(TcoreHal *hal, int peer_fd);
+TReturn vmodem_hal_leave_data_mode(TcoreHal *hal);
+
+/* re-read the config file (also on SIGHUP with [control] sighup) */
+TReturn vmodem_hal_reload_config(TcoreHal *hal);
+
+/* log CPU, vdpram syscall and subsystem counters (also on SIGUSR1 with [control] sigusr1) */
+void vmodem_hal_dump_stats(TcoreHal *hal);
+
+/* RX wakeup accounting since the HAL was set up, what the dump prints per minute */
+struct vmodem_hal_rx_stats {
+	unsigned long long wakeups;		/* RX callbacks and coalescing window ends */
+	unsigned long long reads;
+	unsigned long long deliveries;	/* batches handed to tcore */
+	unsigned long long bytes;
+	unsigned long long cpu_ns;		/* RX path thread CPU, with [power] stats only */
+	long long elapsed_us;
+};
+
+typedef void (*VmodemHalGetRxStats)(TcoreHal *hal, struct vmodem_hal_rx_stats *stats);
+void vmodem_hal_get_rx_stats(TcoreHal *hal, struct vmodem_hal_rx_stats *stats);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __VMODEM_PIPELINE_H__
+#define __VMODEM_PIPELINE_H__
+
+/*
+ * Pipelined command window. Up to window AT commands may be in flight;
+ * each final result (OK, ERROR, +CME/+CMS ERROR, and call results when
+ * the oldest is D/A) completes the oldest one, since the modem answers in
+ * order; an unsolicited NO CARRIER is just a line. A window of 0 keeps
+ * the old behaviour: everything is written as soon as it is queued, but
+ * commands are still tracked so answers can be matched to them.
+ *
+ * A command whose final result never comes is dropped from the window
+ * after timeout_ms (network scans, SMS sends and call setup: at least
+ * 3 minutes), so one lost line cannot hold the link forever.
+ */
+
+#define VMODEM_PIPELINE_CMD_MAX	16
+
+/* longer lines reach the line hook cut to this length */
+#define VMODEM_PIPELINE_LINE_MAX	256
+
+/* a slot was freed by a timeout: the caller should try to send again */
+typedef void (*VmodemPipelineKick)(void *user_data);
+
+/*
+ * Every complete line read, with the tag of the oldest command in
+ * flight (NULL if none). final is set on the line that completes it.
+ * A command dropped on timeout gets a synthetic final "ERROR".
+ */
+typedef void (*VmodemPipelineLine)(void *tag, const char *line, unsigned int len,
+		gboolean final, void *user_data);
+
+struct vmodem_pipeline_stats {
+	unsigned long long completed;
+	unsigned long long timeouts;
+	unsigned long long orphans;		/* final results with nothing in flight */
+	unsigned long long rtt_total_us;
+	unsigned long long rtt_max_us;
+	unsigned int max_inflight;
+};
+
+struct vmodem_pipeline;
+
+struct vmodem_pipeline *vmodem_pipeline_new(guint window, guint timeout_ms,
+		VmodemPipelineKick kick, void *user_data);
+void vmodem_pipeline_free(struct vmodem_pipeline *p);
+
+void vmodem_pipeline_set_window(struct vmodem_pipeline *p, guint window, guint timeout_ms);
+void vmodem_pipeline_set_line_hook(struct vmodem_pipeline *p, VmodemPipelineLine hook);
+
+gboolean vmodem_pipeline_may_send(struct vmodem_pipeline *p, gboolean urgent);
+void vmodem_pipeline_sent(struct vmodem_pipeline *p, const char *data, unsigned int len, void *tag);
+guint vmodem_pipeline_rx(struct vmodem_pipeline *p, const char *data, unsigned int len);
+void vmodem_pipeline_reset(struct vmodem_pipeline *p);
+
+guint vmodem_pipeline_inflight(struct vmodem_pipeline *p);
+void *vmodem_pipeline_tail_tag(struct vmodem_pipeline *p);
+const char *vmodem_pipeline_head_cmd(struct vmodem_pipeline *p);
+guint vmodem_pipeline_head_timeout(struct vmodem_pipeline *p, guint base_ms);
+void vmodem_pipeline_get_stats(struct vmodem_pipeline *p, struct vmodem_pipeline_stats *stats);
+void vmodem_pipeline_dump(struct vmodem_pipeline *p);
+
+#endif
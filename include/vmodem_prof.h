@@ -0,0 +1,55 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __VMODEM_PROF_H__
+#define __VMODEM_PROF_H__
+
+/*
+ * Per-AT-command cost profiler ([debug] profile). Sections of the HAL
+ * are bracketed with vmodem_prof_begin()/vmodem_prof_end() and their
+ * cost is charged to a command name ("+CSQ", "D", "(urc)", ...).
+ * Nested sections are charged exclusively: an emission inside a read
+ * is not counted twice.
+ *
+ * Costs come from thread-level perf_event counters (cycles,
+ * instructions, context switches) where the kernel allows them, and
+ * from the thread CPU clock, which is always there. Counters that cannot
+ * be opened are left out of the table.
+ */
+
+enum vmodem_prof_site {
+	VMODEM_PROF_SEND,		/* hal_send */
+	VMODEM_PROF_RECV,		/* vdpram read and RX processing */
+	VMODEM_PROF_EMIT,		/* tcore receive callbacks */
+	VMODEM_PROF_SITE_MAX
+};
+
+struct vmodem_prof;
+
+struct vmodem_prof *vmodem_prof_new(void);
+void vmodem_prof_free(struct vmodem_prof *p);
+
+void vmodem_prof_begin(struct vmodem_prof *p);
+void vmodem_prof_end(struct vmodem_prof *p, enum vmodem_prof_site site, const char *cmd);
+
+void vmodem_prof_dump(struct vmodem_prof *p);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __VMODEM_STATE_H__
+#define __VMODEM_STATE_H__
+
+#ifndef VMODEM_STATE_PATH
+#define VMODEM_STATE_PATH	"/opt/var/lib/telephony/vmodem.state"
+#endif
+
+/*
+ * Device state kept across daemon restarts. A restart is warm when the
+ * saved state says the modem was up and answering with the same device
+ * and termios profile, and GETSTATUS still reports the saved status.
+ */
+struct vmodem_state {
+	int powered;
+	int good;				/* modem answered since the last power on */
+	unsigned int status;	/* GETSTATUS while good */
+
+	char device_path[VMODEM_CONFIG_STR_MAX];
+	char baudrate[16];
+	char parity[2];
+	char bits[2];
+	char stop[2];
+	int hw_flow;
+	int sw_flow;
+};
+
+void vmodem_state_from_config(struct vmodem_state *st, const struct vmodem_config *cfg);
+gboolean vmodem_state_matches(const struct vmodem_state *st, const struct vmodem_config *cfg);
+
+gboolean vmodem_state_load(struct vmodem_state *st, const char *path);
+gboolean vmodem_state_save(const struct vmodem_state *st, const char *path);
+
+#endif
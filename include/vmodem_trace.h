@@ -0,0 +1,50 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_TRACE_H__
+#define __VMODEM_TRACE_H__
+
+/*
+ * Static probe points (provider "vmodem") for perf/bpftrace.
+ * A built-in probe is a single nop until a tracer attaches to it;
+ * without sys/sdt.h the probes compile to nothing.
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define VMODEM_PROBE1(name, a)			DTRACE_PROBE1(vmodem, name, a)
+#define VMODEM_PROBE2(name, a, b)		DTRACE_PROBE2(vmodem, name, a, b)
+#define VMODEM_PROBE3(name, a, b, c)	DTRACE_PROBE3(vmodem, name, a, b, c)
+#else
+#define VMODEM_PROBE1(name, a)			do { } while (0)
+#define VMODEM_PROBE2(name, a, b)		do { } while (0)
+#define VMODEM_PROBE3(name, a, b, c)	do { } while (0)
+#endif
+
+/*
+ * Logging on the per-message path. Only debug builds (VMODEM_HOT_DEBUG)
+ * keep it; release builds drop the call and its argument formatting.
+ */
+#ifdef VMODEM_HOT_DEBUG
+#define hot_dbg(fmt, args...)	dbg(fmt, ##args)
+#else
+#define hot_dbg(fmt, args...)	do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_TXSCHED_H__
+#define __VMODEM_TXSCHED_H__
+
+/*
+ * Priority TX scheduler. Commands go out in arrival order while the
+ * tty keeps up; once it backs up (the vdpram fd is non-blocking, or a
+ * pipelining window is full), queued commands leave by class, and
+ * every aging_ms a command waits lifts it one class.
+ *
+ * Data that is not an AT command is an SMS body when an AT+CMGS/CMGW
+ * is waiting for one, and is held back until the modem's "> " prompt;
+ * otherwise it follows the command queued before it.
+ *
+ * tcore matches answers to its requests in the order it sent them, so a
+ * command that overtakes another one gets the other's answer. Class
+ * order is only safe while tcore keeps one request outstanding at a
+ * time, as its HAL queue does: what overtakes it then is the watchdog
+ * probe, whose answer never reaches tcore. A host that queues several
+ * requests at once must not rely on classes to order them.
+ */
+
+enum vmodem_tx_class {
+	VMODEM_TX_EMERGENCY,	/* emergency dial */
+	VMODEM_TX_CALL,			/* ATD/ATA/ATH, +CHLD, +VTS, ... */
+	VMODEM_TX_NORMAL,
+	VMODEM_TX_BULK,			/* SMS and phonebook transfers */
+	VMODEM_TX_CLASS_MAX
+};
+
+struct vmodem_tx_class_stats {
+	unsigned long long count;
+	unsigned long long delay_total_us;
+	unsigned long long delay_max_us;
+	unsigned long long dropped;		/* write failed, item not (fully) sent */
+};
+
+/*
+ * Returns the number of bytes written, 0 when the link has no room,
+ * -errno on a hard error (the item is dropped).
+ */
+typedef int (*VmodemTxWrite)(const char *data, unsigned int len, void *user_data);
+
+/* FALSE holds dispatching (e.g. a full pipelining window) */
+typedef gboolean (*VmodemTxGate)(enum vmodem_tx_class cls, void *user_data);
+
+/* a complete AT command (not an SMS body) has been written */
+typedef void (*VmodemTxSent)(const char *data, unsigned int len, void *user_data);
+
+struct vmodem_txsched;
+
+/* fd < 0: the link cannot be polled for room, retry on a timer */
+struct vmodem_txsched *vmodem_txsched_new(int fd, guint aging_ms,
+		VmodemTxWrite write, void *user_data);
+void vmodem_txsched_free(struct vmodem_txsched *s);
+
+void vmodem_txsched_set_aging(struct vmodem_txsched *s, guint aging_ms);
+void vmodem_txsched_set_retry(struct vmodem_txsched *s, int count, int sleep_us, int backoff);
+void vmodem_txsched_set_gate(struct vmodem_txsched *s, VmodemTxGate gate);
+void vmodem_txsched_set_sent(struct vmodem_txsched *s, VmodemTxSent sent);
+
+enum vmodem_tx_class vmodem_txsched_classify(const char *data, unsigned int len);
+gboolean vmodem_txsched_expects_body(const char *data, unsigned int len);
+
+gboolean vmodem_txsched_send(struct vmodem_txsched *s, const char *data, unsigned int len);
+gboolean vmodem_txsched_send_probe(struct vmodem_txsched *s, const char *data, unsigned int len);
+void vmodem_txsched_kick(struct vmodem_txsched *s);
+void vmodem_txsched_rx(struct vmodem_txsched *s, const char *data, unsigned int len);
+void vmodem_txsched_body_final(struct vmodem_txsched *s);
+void vmodem_txsched_modem_reset(struct vmodem_txsched *s);
+gboolean vmodem_txsched_is_idle(struct vmodem_txsched *s);
+
+void vmodem_txsched_get_stats(struct vmodem_txsched *s,
+		struct vmodem_tx_class_stats stats[VMODEM_TX_CLASS_MAX]);
+void vmodem_txsched_dump(struct vmodem_txsched *s);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_WATCHDOG_H__
+#define __VMODEM_WATCHDOG_H__
+
+#define VMODEM_WATCHDOG_MAX_RECORDS	16
+
+struct vmodem_watchdog;
+
+struct vmodem_watchdog_ops {
+	/* queue the liveness probe ("AT"), return FALSE if it could not be queued */
+	gboolean (*probe)(void *user_data);
+	/* modem did not answer the probe either */
+	void (*stall)(void *user_data);
+	/*
+	 * How long the command now awaited may legitimately take (a network
+	 * scan, an SMS send), 0: the configured deadline applies.
+	 */
+	guint (*deadline)(void *user_data);
+};
+
+struct vmodem_stall_record {
+	gint64 pending_since;	/* wall clock (usec) of the first unanswered TX */
+	gint64 probed_at;
+	gint64 stalled_at;
+	gint64 recovered_at;	/* 0 until the modem answers again */
+};
+
+struct vmodem_watchdog *vmodem_watchdog_new(guint deadline_ms, guint recover_ms,
+		const struct vmodem_watchdog_ops *ops, void *user_data);
+void vmodem_watchdog_free(struct vmodem_watchdog *wd);
+
+void vmodem_watchdog_set_timeout(struct vmodem_watchdog *wd, guint deadline_ms, guint recover_ms);
+
+/*
+ * tx: after every write. rx: every read, takes the probe's answer out.
+ * answered: a command got its final result (not a URC), outstanding
+ * commands are still waiting. Only answers, the probe's included, end a
+ * deadline; a modem that only sends URCs is probed and then reported.
+ */
+void vmodem_watchdog_tx(struct vmodem_watchdog *wd);
+const char *vmodem_watchdog_rx(struct vmodem_watchdog *wd, const char *data,
+		unsigned int len, unsigned int *out_len);
+void vmodem_watchdog_answered(struct vmodem_watchdog *wd, guint outstanding);
+
+void vmodem_watchdog_dump(struct vmodem_watchdog *wd);
+
+#endif
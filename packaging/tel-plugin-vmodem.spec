@@ -16,6 +16,24 @@ BuildRequires:  pkgconfig(tcore)
 %description
 Telephony AT Modem library
 
+%package diag
+Summary:    Telephony AT Virtual Modem diagnostics module
+Group:      System/Libraries
+Requires:   %{name} = %{version}-%{release}
+
+%description diag
+Frame dump and capture module, loaded by the vmodem plugin only when
+diagnostics are turned on
+
+%package devel
+Summary:    Telephony AT Virtual Modem control interface
+Group:      Development/Libraries
+Requires:   %{name} = %{version}-%{release}
+
+%description devel
+Header for plugins that reload the vmodem configuration or dump its
+statistics through the vmodem HAL
+
 %prep
 %setup -q
 
@@ -36,3 +54,11 @@ rm -rf %{buildroot}
 %defattr(-,root,root,-)
 #%doc COPYING
 %{_libdir}/telephony/plugins/vmodem-plugin*
+
+%files diag
+%defattr(-,root,root,-)
+%{_libdir}/telephony/vmodem/vmodem-dump.so
+
+%files devel
+%defattr(-,root,root,-)
+%{_includedir}/telephony/vmodem_hal.h
@@ -24,8 +24,14 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include <glib.h>
+#include <glib-unix.h>
+#include <signal.h>
 
 #include <tcore.h>
 #include <plugin.h>
@@ -37,12 +43,57 @@
 #include <hal.h>
 
 #include "vdpram.h"
+#include "vdpram_data.h"
+#include "vdpram_dump.h"
+#include "vdpram_fault.h"
+#include "vdpram_shm.h"
+#include "vmodem_at.h"
+#include "vmodem_cache.h"
+#include "vmodem_coalesce.h"
+#include "vmodem_config.h"
+#include "vmodem_hal.h"
+#include "vmodem_pipeline.h"
+#include "vmodem_prof.h"
+#include "vmodem_state.h"
+#include "vmodem_trace.h"
+#include "vmodem_txsched.h"
+#include "vmodem_watchdog.h"
 
 struct custom_data {
 	int vdpram_fd;
+	struct vdpram_shm *shm;	/* mailbox backend, NULL for the tty */
+	int shm_bell_rx;
+	int shm_bell_tx;
 	guint watch_id_vdpram;
+	guint watch_id_sighup;
+	guint watch_id_sigusr1;
+	guint watch_id_data;	/* data mode thread ended by itself */
+	TcoreHal *hal;
+	struct vmodem_config config;
+	char *rx_buf;
+	unsigned int rx_buf_len;
+	struct vmodem_watchdog *watchdog;
+	struct vmodem_txsched *txsched;
+	struct vmodem_pipeline *pipeline;
+	struct vmodem_cache *cache;
+	char body_tag;			/* pipeline tag of AT+CMGS/CMGW, only its address counts */
+	struct vmodem_coalesce *rx_coalesce;
+	struct vdpram_data *data_mode;
+
+	struct vmodem_prof *prof;	/* [debug] profile, NULL when off */
+	char rx_cmd[VMODEM_PIPELINE_CMD_MAX];	/* command the last read answered */
+
+	struct vmodem_state state;
+	gint64 powered_at;		/* monotonic, for the readiness log */
+	gboolean ready;			/* modem answered since powered_at */
 };
 
+static void __save_state(struct custom_data *custom)
+{
+	if (custom->config.warm_restart)
+		vmodem_state_save(&custom->state, custom->config.state_path);
+}
+
 static TReturn hal_power(TcoreHal *hal, gboolean flag)
 {
 	struct custom_data *user_data;
@@ -51,13 +102,30 @@ static TReturn hal_power(TcoreHal *hal, gboolean flag)
 	if (!user_data)
 		return TCORE_RETURN_FAILURE;
 
+	VMODEM_PROBE2(hal_power, user_data->vdpram_fd, flag);
+
 	/* power on */
 	if (flag == TRUE) {
+		/* warm restart: the modem never went down, do not reboot it */
+		if (tcore_hal_get_power_state(hal) == TRUE && user_data->state.good) {
+			dbg("modem already up, power on skipped");
+			return TCORE_RETURN_SUCCESS;
+		}
+
 		if (FALSE == vdpram_poweron(user_data->vdpram_fd)) {
 			err("vdpram_poweron failed");
 			return TCORE_RETURN_FAILURE;
 		}
 		tcore_hal_set_power_state(hal, TRUE);
+		vmodem_pipeline_reset(user_data->pipeline);
+		vmodem_txsched_modem_reset(user_data->txsched);
+		vmodem_cache_reset(user_data->cache);
+
+		user_data->powered_at = g_get_monotonic_time();
+		user_data->ready = FALSE;
+		user_data->state.powered = 1;
+		user_data->state.good = 0;
+		__save_state(user_data);
 	}
 	/* power off */
 	else {
@@ -66,16 +134,96 @@ static TReturn hal_power(TcoreHal *hal, gboolean flag)
 			return TCORE_RETURN_FAILURE;
 		}
 		tcore_hal_set_power_state(hal, FALSE);
+		vmodem_pipeline_reset(user_data->pipeline);
+		vmodem_txsched_modem_reset(user_data->txsched);
+		vmodem_cache_reset(user_data->cache);
+
+		user_data->state.powered = 0;
+		user_data->state.good = 0;
+		__save_state(user_data);
 	}
 
 	return TCORE_RETURN_SUCCESS;
 }
 
 
-static TReturn hal_send(TcoreHal *hal, unsigned int data_len, void *data)
+/* bytes written, or -errno */
+static int __vdpram_write(struct custom_data *custom, const char *data, unsigned int len)
 {
 	int ret;
+
+	if (custom->shm) {
+		ret = vdpram_shm_write(custom->shm, data, len);
+		return ret < 0 ? -EIO : ret;
+	}
+
+	return vdpram_tty_write_once(custom->vdpram_fd, data, len);
+}
+
+/*
+ * Scheduler write hook: one vdpram write, the scheduler retries the rest
+ * once the fd is writable again and drops the item on a hard error.
+ */
+static int on_tx_write(const char *data, unsigned int len, void *user_data)
+{
+	struct custom_data *custom = user_data;
+	int ret;
+
+	ret = __vdpram_write(custom, data, len);
+	if (ret == -EAGAIN || ret == -EBUSY || ret == -EINTR)
+		return 0;
+	if (ret < 0) {
+		err("vdpram write failed errno[%d] (fd=%d, len=%u)", -ret, custom->vdpram_fd, len);
+		return ret;
+	}
+
+	hot_dbg("vdpram write success ret=%d (fd=%d, len=%d)", ret, custom->vdpram_fd, len);
+	if (ret > 0)
+		vmodem_watchdog_tx(custom->watchdog);
+
+	return ret;
+}
+
+/*
+ * Only answer from the cache when the answer cannot overtake another:
+ * nothing queued and nothing in flight (or, to collapse, the same query
+ * last in flight).
+ */
+static enum vmodem_cache_result __cache_lookup(struct custom_data *custom,
+		const char *data, unsigned int len)
+{
+	gboolean tx_idle;
+
+	tx_idle = vmodem_txsched_is_idle(custom->txsched);
+
+	return vmodem_cache_lookup(custom->cache, data, len,
+			tx_idle && vmodem_pipeline_inflight(custom->pipeline) == 0,
+			tx_idle ? vmodem_pipeline_tail_tag(custom->pipeline) : NULL);
+}
+
+static TReturn __send(struct custom_data *user_data, unsigned int data_len, void *data)
+{
+	if (user_data->data_mode) {
+		err("channel is in data mode");
+		return TCORE_RETURN_FAILURE;
+	}
+
+	if (__cache_lookup(user_data, data, data_len) != VMODEM_CACHE_MISS)
+		return TCORE_RETURN_SUCCESS;
+
+	if (vmodem_txsched_send(user_data->txsched, data, data_len) == FALSE) {
+		err("tx queueing failed (len=%d)", data_len);
+		return TCORE_RETURN_FAILURE;
+	}
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+static TReturn hal_send(TcoreHal *hal, unsigned int data_len, void *data)
+{
 	struct custom_data *user_data;
+	char cmd[VMODEM_PIPELINE_CMD_MAX];
+	TReturn ret;
 
 	if (tcore_hal_get_power_state(hal) == FALSE)
 		return TCORE_RETURN_FAILURE;
@@ -84,15 +232,17 @@ static TReturn hal_send(TcoreHal *hal, unsigned int data_len, void *data)
 	if (!user_data)
 		return TCORE_RETURN_FAILURE;
 
-	ret = vdpram_tty_write(user_data->vdpram_fd, data, data_len);
-	if(ret < 0)	{
-		err("vdpram_tty_write failed");
-		return TCORE_RETURN_FAILURE;
-	}
-	else {
-		dbg("vdpram_tty_write success ret=%d (fd=%d, len=%d)", ret, user_data->vdpram_fd, data_len);
-		return TCORE_RETURN_SUCCESS;
-	}
+	if (!user_data->prof)
+		return __send(user_data, data_len, data);
+
+	vmodem_prof_begin(user_data->prof);
+	ret = __send(user_data, data_len, data);
+
+	if (!vmodem_at_command_name(data, data_len, cmd, sizeof(cmd)))
+		snprintf(cmd, sizeof(cmd), "(raw)");
+	vmodem_prof_end(user_data->prof, VMODEM_PROF_SEND, cmd);
+
+	return ret;
 }
 
 
@@ -102,25 +252,217 @@ static struct tcore_hal_operations hops =
 	.send = hal_send,
 };
 
+static gboolean on_watchdog_probe(void *data)
+{
+	struct custom_data *custom = data;
+
+	return vmodem_txsched_send_probe(custom->txsched, "AT\r", 3);
+}
+
+static guint on_watchdog_deadline(void *data)
+{
+	struct custom_data *custom = data;
+
+	return vmodem_pipeline_head_timeout(custom->pipeline, custom->config.watchdog_deadline_ms);
+}
+
+/*
+ * Power-cycle the modem through the regular power path so tcore sees
+ * the power state change.
+ */
+static void on_watchdog_stall(void *data)
+{
+	struct custom_data *custom = data;
+
+	err("modem stall, power-cycling (fd=%d)", custom->vdpram_fd);
+
+	/* not good any more: the power on below must really happen */
+	custom->state.good = 0;
+	__save_state(custom);
+
+	hal_power(custom->hal, FALSE);
+	if (hal_power(custom->hal, TRUE) != TCORE_RETURN_SUCCESS)
+		err("power-cycle after stall failed");
+}
+
+static const struct vmodem_watchdog_ops watchdog_ops = {
+	.probe = on_watchdog_probe,
+	.stall = on_watchdog_stall,
+	.deadline = on_watchdog_deadline,
+};
+
+static gboolean on_tx_gate(enum vmodem_tx_class cls, void *user_data)
+{
+	struct custom_data *custom = user_data;
+
+	return vmodem_pipeline_may_send(custom->pipeline, cls == VMODEM_TX_EMERGENCY);
+}
+
+static void on_tx_sent(const char *data, unsigned int len, void *user_data)
+{
+	struct custom_data *custom = user_data;
+	void *tag;
+
+	/* SMS commands are tagged so their final result can end a body hold */
+	if (vmodem_txsched_expects_body(data, len))
+		tag = &custom->body_tag;
+	else
+		tag = vmodem_cache_sent(custom->cache, data, len);
+
+	vmodem_pipeline_sent(custom->pipeline, data, len, tag);
+}
+
+static void on_pipeline_line(void *tag, const char *line, unsigned int len,
+		gboolean final, void *user_data)
+{
+	struct custom_data *custom = user_data;
+
+	if (tag == &custom->body_tag) {
+		if (final)
+			vmodem_txsched_body_final(custom->txsched);
+		tag = NULL;
+	}
+
+	vmodem_cache_line(custom->cache, tag, line, len, final);
+}
+
+static void on_cache_emit(const char *data, unsigned int len, void *user_data)
+{
+	struct custom_data *custom = user_data;
+
+	/* whatever the modem said before goes first */
+	vmodem_coalesce_flush(custom->rx_coalesce);
+
+	hot_dbg("cached answer (len = %u)", len);
+	vmodem_prof_begin(custom->prof);
+	tcore_hal_emit_recv_callback(custom->hal, len, (void *)data);
+	vmodem_prof_end(custom->prof, VMODEM_PROF_EMIT, "(cache)");
+}
+
+static void on_pipeline_kick(void *user_data)
+{
+	struct custom_data *custom = user_data;
+
+	vmodem_txsched_kick(custom->txsched);
+}
+
+static void on_rx_deliver(const char *data, unsigned int len, void *user_data)
+{
+	struct custom_data *custom = user_data;
+
+	hot_dbg("vdpram deliver (len = %u)", len);
+	VMODEM_PROBE2(recv_emit, custom->vdpram_fd, len);
+
+	/* a coalesced batch is charged to the command the last read answered */
+	vmodem_prof_begin(custom->prof);
+	tcore_hal_emit_recv_callback(custom->hal, len, data);
+	vmodem_prof_end(custom->prof, VMODEM_PROF_EMIT, custom->rx_cmd);
+}
+
+static unsigned long long __thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return 0;
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * First answer after a power on: this status is the last-known-good one
+ * a later restart compares GETSTATUS against.
+ */
+static void __mark_ready(struct custom_data *custom)
+{
+	unsigned int status = 0;
+
+	custom->ready = TRUE;
+
+	msg("modem ready %lld ms after power on",
+			(long long)(g_get_monotonic_time() - custom->powered_at) / 1000);
+
+	if (!vdpram_getstatus(custom->vdpram_fd, &status) || status == 0)
+		return;
+
+	custom->state.good = 1;
+	custom->state.status = status;
+	__save_state(custom);
+}
+
 static gboolean on_recv_vdpram_message(GIOChannel *channel, GIOCondition condition, gpointer data)
 {
 	TcoreHal *hal = data;
 	struct custom_data *custom;
-
-	#define BUF_LEN_MAX 512
-	char buf[BUF_LEN_MAX];
+	char *buf;
 	int n = 0;
+	unsigned long long cpu_start = 0;
+	const char *cmd;
+	const char *rx;
+	unsigned int rx_len;
 
 	custom = tcore_hal_ref_user_data(hal);
-	memset(buf, 0, BUF_LEN_MAX);
-	n = vdpram_tty_read(custom->vdpram_fd, buf, BUF_LEN_MAX);
+	buf = custom->rx_buf;
+
+	if (custom->config.power_stats)
+		cpu_start = __thread_cpu_ns();
+
+	vmodem_prof_begin(custom->prof);
+
+	/* keep one byte for the terminator the dumps rely on */
+	if (custom->shm)
+		n = vdpram_shm_read(custom->shm, buf, custom->rx_buf_len - 1);
+	else
+		n = vdpram_tty_read(custom->vdpram_fd, buf, custom->rx_buf_len - 1);
 	if (n < 0) {
-		err("tty_read error. return_valute = %d", n);
+		/* the fd is non-blocking, another read may have emptied it */
+		if (errno != EAGAIN)
+			err("tty_read error. return_valute = %d", n);
+		vmodem_prof_end(custom->prof, VMODEM_PROF_RECV, "(error)");
 		return TRUE;
 	}
 
-	dbg("vdpram recv (ret = %d)", n);
-	tcore_hal_emit_recv_callback(hal, n, buf);
+	/* a doorbell can ring for data an earlier read already took */
+	if (n == 0) {
+		vmodem_prof_end(custom->prof, VMODEM_PROF_RECV, "(empty)");
+		return TRUE;
+	}
+
+	buf[n] = '\0';
+
+	hot_dbg("vdpram recv (ret = %d)", n);
+
+	if (!custom->ready)
+		__mark_ready(custom);
+
+	/*
+	 * The answer to the watchdog's own probe is taken out first: it must
+	 * neither end an SMS body hold, nor complete a command, nor reach tcore.
+	 */
+	rx = vmodem_watchdog_rx(custom->watchdog, buf, n, &rx_len);
+	if (rx_len) {
+		vmodem_txsched_rx(custom->txsched, rx, rx_len);
+
+		/* the head is gone once its final result has been parsed */
+		if (custom->prof) {
+			cmd = vmodem_pipeline_head_cmd(custom->pipeline);
+			snprintf(custom->rx_cmd, sizeof(custom->rx_cmd), "%s", cmd ? cmd : "(urc)");
+		}
+
+		/* only a final result for a command in flight feeds the watchdog */
+		if (vmodem_pipeline_rx(custom->pipeline, rx, rx_len)) {
+			vmodem_watchdog_answered(custom->watchdog,
+					vmodem_pipeline_inflight(custom->pipeline));
+			vmodem_txsched_kick(custom->txsched);
+		}
+		vmodem_coalesce_push(custom->rx_coalesce, rx, rx_len,
+				vmodem_pipeline_head_cmd(custom->pipeline));
+	}
+
+	if (cpu_start)
+		vmodem_coalesce_account_cpu(custom->rx_coalesce, __thread_cpu_ns() - cpu_start);
+
+	vmodem_prof_end(custom->prof, VMODEM_PROF_RECV, custom->rx_cmd);
 
 	return TRUE;
 }
@@ -141,6 +483,349 @@ static guint register_gio_watch(TcoreHal *h, int fd, void *callback)
 	return source;
 }
 
+/*
+ * Power save: the RX watch is dropped while a coalesce window is open
+ * and the window end reads everything that piled up meanwhile.
+ */
+static void on_rx_hold(gboolean hold, gboolean drain, void *user_data)
+{
+	struct custom_data *custom = user_data;
+
+	if (custom->watch_id_vdpram) {
+		g_source_remove(custom->watch_id_vdpram);
+		custom->watch_id_vdpram = 0;
+	}
+
+	/* the passthrough thread owns the fd */
+	if (hold || custom->data_mode)
+		return;
+
+	custom->watch_id_vdpram = register_gio_watch(custom->hal,
+			custom->shm ? vdpram_shm_fd(custom->shm) : custom->vdpram_fd,
+			on_recv_vdpram_message);
+
+	if (drain)
+		on_recv_vdpram_message(NULL, G_IO_IN, custom->hal);
+}
+
+static void __config_profile(const struct vmodem_config *cfg, struct vdpram_tty_profile *profile)
+{
+	profile->baudrate = cfg->baudrate;
+	profile->parity = cfg->parity;
+	profile->bits = cfg->bits;
+	profile->stop = cfg->stop;
+	profile->hwf = cfg->hw_flow;
+	profile->swf = cfg->sw_flow;
+}
+
+/*
+ * A reloaded [tty] group: a hw_flow change alone only switches RTS/CTS,
+ * the line settings are re-applied only when they changed.
+ */
+static void __apply_tty(struct custom_data *custom, const struct vmodem_config *prev)
+{
+	struct vmodem_config *cfg = &custom->config;
+	struct vdpram_tty_profile profile;
+
+	if (custom->vdpram_fd < 0 || custom->shm)
+		return;
+
+	if (strcmp(cfg->baudrate, prev->baudrate) != 0 || strcmp(cfg->parity, prev->parity) != 0
+			|| strcmp(cfg->bits, prev->bits) != 0 || strcmp(cfg->stop, prev->stop) != 0
+			|| cfg->sw_flow != prev->sw_flow) {
+		__config_profile(cfg, &profile);
+		if (vdpram_set_profile(custom->vdpram_fd, &profile) != 0)
+			err("tty profile update failed");
+	}
+	else if (cfg->hw_flow != prev->hw_flow) {
+		if (vdpram_set_flow_control(custom->vdpram_fd, cfg->hw_flow) != 0)
+			err("flow control update failed");
+	}
+}
+
+/*
+ * Push custom->config down to the vdpram layer. On the initial call the
+ * tty profile was already applied by vdpram_open_path(), on a reload
+ * __apply_tty() takes care of it.
+ */
+static void __apply_config(struct custom_data *custom, gboolean initial)
+{
+	struct vmodem_config *cfg = &custom->config;
+	char *buf;
+
+	if (cfg->read_buf_len != custom->rx_buf_len) {
+		buf = realloc(custom->rx_buf, cfg->read_buf_len);
+		if (buf) {
+			custom->rx_buf = buf;
+			custom->rx_buf_len = cfg->read_buf_len;
+		}
+		else
+			err("read buffer resize to %u failed", cfg->read_buf_len);
+	}
+
+	if (vdpram_dump_configure(cfg->dump_level, cfg->capture ? cfg->capture_path : NULL) < 0)
+		err("diagnostics could not be turned on");
+
+#ifdef VDPRAM_FAULT_INJECTION
+	/* without a [debug] fault key the VDPRAM_FAULT environment applies */
+	if (cfg->fault_spec[0])
+		vdpram_fault_configure(cfg->fault_spec);
+#endif
+
+	if (custom->txsched)
+		vmodem_txsched_set_aging(custom->txsched, cfg->tx_aging_ms);
+	else if (initial)
+		custom->txsched = vmodem_txsched_new(custom->shm ? -1 : custom->vdpram_fd,
+				cfg->tx_aging_ms, on_tx_write, custom);
+	vmodem_txsched_set_retry(custom->txsched, cfg->retry_count, cfg->retry_sleep_us,
+			cfg->retry_backoff);
+
+	if (custom->pipeline) {
+		vmodem_pipeline_set_window(custom->pipeline, cfg->tx_window, cfg->tx_window_timeout_ms);
+		/* a wider window may let queued commands go */
+		vmodem_txsched_kick(custom->txsched);
+	}
+	else if (initial) {
+		custom->pipeline = vmodem_pipeline_new(cfg->tx_window, cfg->tx_window_timeout_ms,
+				on_pipeline_kick, custom);
+		vmodem_pipeline_set_line_hook(custom->pipeline, on_pipeline_line);
+		vmodem_txsched_set_gate(custom->txsched, on_tx_gate);
+		vmodem_txsched_set_sent(custom->txsched, on_tx_sent);
+	}
+
+	if (!custom->cache && initial)
+		custom->cache = vmodem_cache_new(on_cache_emit, custom);
+	vmodem_cache_set_ttl(custom->cache, cfg->cache_ttl_ms);
+	vmodem_cache_set_enabled(custom->cache, cfg->cache_enable);
+
+	vdpram_set_power_save(cfg->power_save);
+	if (custom->rx_coalesce)
+		vmodem_coalesce_set_window(custom->rx_coalesce, cfg->power_save ? cfg->coalesce_ms : 0);
+	else if (initial)
+		custom->rx_coalesce = vmodem_coalesce_new(cfg->power_save ? cfg->coalesce_ms : 0,
+				cfg->read_buf_len * 4, on_rx_deliver, on_rx_hold, custom);
+
+	/* deadline_ms 0 turns the watchdog off, a reload may turn it on again */
+	if (custom->watchdog && cfg->watchdog_deadline_ms == 0) {
+		vmodem_watchdog_free(custom->watchdog);
+		custom->watchdog = NULL;
+	}
+	else if (custom->watchdog)
+		vmodem_watchdog_set_timeout(custom->watchdog,
+				cfg->watchdog_deadline_ms, cfg->watchdog_recover_ms);
+	else
+		custom->watchdog = vmodem_watchdog_new(cfg->watchdog_deadline_ms,
+				cfg->watchdog_recover_ms, &watchdog_ops, custom);
+
+	if (cfg->profile && !custom->prof)
+		custom->prof = vmodem_prof_new();
+	else if (!cfg->profile && custom->prof) {
+		vmodem_prof_dump(custom->prof);
+		vmodem_prof_free(custom->prof);
+		custom->prof = NULL;
+	}
+}
+
+TReturn vmodem_hal_reload_config(TcoreHal *hal)
+{
+	struct custom_data *custom;
+	struct vmodem_config cfg;
+	struct vmodem_config prev;
+
+	custom = tcore_hal_ref_user_data(hal);
+	if (!custom)
+		return TCORE_RETURN_FAILURE;
+
+	vmodem_config_init(&cfg);
+	vmodem_config_load(&cfg, vmodem_config_path());
+
+	if (strcmp(cfg.device_path, custom->config.device_path) != 0) {
+		err("device path change to %s needs a restart", cfg.device_path);
+		snprintf(cfg.device_path, sizeof(cfg.device_path), "%s", custom->config.device_path);
+	}
+
+	if (strcmp(cfg.backend, custom->config.backend) != 0) {
+		err("backend change to %s needs a restart", cfg.backend);
+		snprintf(cfg.backend, sizeof(cfg.backend), "%s", custom->config.backend);
+	}
+
+	prev = custom->config;
+	custom->config = cfg;
+	__apply_tty(custom, &prev);
+	__apply_config(custom, FALSE);
+
+	dbg("config reloaded");
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+static gboolean on_sighup(gpointer data)
+{
+	vmodem_hal_reload_config(data);
+
+	return TRUE;
+}
+
+/*
+ * Everything a scenario run compares: process CPU and context switches,
+ * vdpram syscall counts and the per-subsystem figures. Counters are
+ * cumulative; a driver diffs two dumps.
+ */
+void vmodem_hal_dump_stats(TcoreHal *hal)
+{
+	struct custom_data *custom;
+	struct vdpram_io_stats io;
+	struct rusage ru;
+
+	custom = tcore_hal_ref_user_data(hal);
+	if (!custom)
+		return;
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		msg("cpu: user %ld.%06ld s, sys %ld.%06ld s, ctxsw %ld voluntary, %ld involuntary",
+				(long)ru.ru_utime.tv_sec, (long)ru.ru_utime.tv_usec,
+				(long)ru.ru_stime.tv_sec, (long)ru.ru_stime.tv_usec,
+				ru.ru_nvcsw, ru.ru_nivcsw);
+
+	vdpram_get_io_stats(&io);
+	msg("vdpram: read %llu calls/%llu bytes/%llu errors, write %llu calls/%llu bytes/%llu short/%llu retries/%llu errors/%llu dropped, %llu waits, %llu ctl",
+			io.reads, io.read_bytes, io.read_errors,
+			io.writes, io.write_bytes, io.short_writes, io.write_retries,
+			io.write_errors, io.write_drops, io.waits, io.ctl);
+
+	vmodem_watchdog_dump(custom->watchdog);
+	vmodem_txsched_dump(custom->txsched);
+	vmodem_pipeline_dump(custom->pipeline);
+	vmodem_cache_dump(custom->cache);
+	vmodem_coalesce_dump(custom->rx_coalesce);
+	vmodem_prof_dump(custom->prof);
+
+#ifdef VDPRAM_FAULT_INJECTION
+	vdpram_fault_dump();
+#endif
+}
+
+void vmodem_hal_get_rx_stats(TcoreHal *hal, struct vmodem_hal_rx_stats *stats)
+{
+	struct custom_data *custom;
+	struct vmodem_coalesce_stats cs;
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(struct vmodem_hal_rx_stats));
+
+	custom = tcore_hal_ref_user_data(hal);
+	if (!custom || !custom->rx_coalesce)
+		return;
+
+	vmodem_coalesce_get_stats(custom->rx_coalesce, &cs);
+	stats->wakeups = cs.wakeups;
+	stats->reads = cs.reads;
+	stats->deliveries = cs.deliveries;
+	stats->bytes = cs.bytes;
+	stats->cpu_ns = cs.cpu_ns;
+	stats->elapsed_us = g_get_monotonic_time() - cs.since;
+}
+
+static gboolean on_sigusr1(gpointer data)
+{
+	vmodem_hal_dump_stats(data);
+
+	return TRUE;
+}
+
+static gboolean on_data_mode_exit(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+	TcoreHal *hal = data;
+	struct custom_data *custom;
+
+	custom = tcore_hal_ref_user_data(hal);
+	if (!custom)
+		return FALSE;
+
+	/* the source goes away with this return, leave must not remove it */
+	custom->watch_id_data = 0;
+
+	err("data mode peer closed or failed, back to AT mode");
+	vmodem_hal_leave_data_mode(hal);
+
+	return FALSE;
+}
+
+TReturn vmodem_hal_enter_data_mode(TcoreHal *hal, int peer_fd)
+{
+	struct custom_data *custom;
+
+	custom = tcore_hal_ref_user_data(hal);
+	if (!custom || custom->data_mode)
+		return TCORE_RETURN_FAILURE;
+
+	if (custom->shm) {
+		err("data mode is not supported on the mailbox backend");
+		return TCORE_RETURN_FAILURE;
+	}
+
+	if (!vmodem_txsched_is_idle(custom->txsched)) {
+		err("AT commands still queued, not entering data mode");
+		return TCORE_RETURN_FAILURE;
+	}
+
+	/* the passthrough thread owns the fd from now on */
+	vmodem_coalesce_flush(custom->rx_coalesce);
+
+	if (custom->watch_id_vdpram) {
+		g_source_remove(custom->watch_id_vdpram);
+		custom->watch_id_vdpram = 0;
+	}
+
+	custom->data_mode = vdpram_data_start(custom->vdpram_fd, peer_fd);
+	if (!custom->data_mode) {
+		err("data mode start failed");
+		custom->watch_id_vdpram = register_gio_watch(hal, custom->vdpram_fd, on_recv_vdpram_message);
+		return TCORE_RETURN_FAILURE;
+	}
+
+	custom->watch_id_data = register_gio_watch(hal,
+			vdpram_data_exit_fd(custom->data_mode), on_data_mode_exit);
+
+	dbg("enter data mode (fd=%d, peer=%d)", custom->vdpram_fd, peer_fd);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn vmodem_hal_leave_data_mode(TcoreHal *hal)
+{
+	struct custom_data *custom;
+	struct vdpram_data_stats stats;
+
+	custom = tcore_hal_ref_user_data(hal);
+	if (!custom || !custom->data_mode)
+		return TCORE_RETURN_FAILURE;
+
+	if (custom->watch_id_data) {
+		g_source_remove(custom->watch_id_data);
+		custom->watch_id_data = 0;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	vdpram_data_stop(custom->data_mode, &stats);
+	custom->data_mode = NULL;
+
+	dbg("leave data mode%s: rx=%llu tx=%llu bytes (%llu spliced) in %lld us",
+			stats.ended ? " (peer gone)" : "",
+			stats.rx_bytes, stats.tx_bytes, stats.spliced, stats.elapsed_us);
+	if (stats.rx_packets || stats.tx_packets)
+		dbg("data mode packets: rx=%llu tx=%llu", stats.rx_packets, stats.tx_packets);
+	if (stats.elapsed_us > 0)
+		dbg("data mode throughput %.2f Mbit/s",
+				(stats.rx_bytes + stats.tx_bytes) * 8.0 / stats.elapsed_us);
+
+	custom->watch_id_vdpram = register_gio_watch(hal, custom->vdpram_fd, on_recv_vdpram_message);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 
 /*static int power_tx_pwr_on_exec(int nFd)
 {
@@ -148,6 +833,91 @@ static guint register_gio_watch(TcoreHal *h, int fd, void *callback)
 	return 0;
 }*/
 
+static void __close_shm_bells(struct custom_data *custom)
+{
+	if (custom->shm_bell_rx >= 0)
+		close(custom->shm_bell_rx);
+	if (custom->shm_bell_tx >= 0)
+		close(custom->shm_bell_tx);
+
+	custom->shm_bell_rx = -1;
+	custom->shm_bell_tx = -1;
+}
+
+/*
+ * Mailbox backend: the mapped region is the vdpram fd (power ioctls go
+ * there as well), one doorbell node per direction.
+ */
+static int __open_shm(struct custom_data *custom)
+{
+	struct vmodem_config *cfg = &custom->config;
+	int fd;
+
+	fd = open(cfg->shm_path, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		err("mailbox %s open failed", cfg->shm_path);
+		return -1;
+	}
+
+	custom->shm_bell_rx = open(cfg->shm_doorbell_rx, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (custom->shm_bell_rx < 0)
+		err("doorbell %s open failed", cfg->shm_doorbell_rx);
+
+	custom->shm_bell_tx = open(cfg->shm_doorbell_tx, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (custom->shm_bell_tx < 0)
+		err("doorbell %s open failed", cfg->shm_doorbell_tx);
+
+	if (custom->shm_bell_rx >= 0 && custom->shm_bell_tx >= 0)
+		custom->shm = vdpram_shm_attach(fd, VDPRAM_SHM_SIDE_AP, custom->shm_bell_tx,
+				custom->shm_bell_rx);
+
+	if (!custom->shm) {
+		__close_shm_bells(custom);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Warm when the saved state says the modem was up and answering on this
+ * device and profile, and the live GETSTATUS still agrees. The saved
+ * state alone is not trusted: the modem may have been reset meanwhile.
+ */
+static gboolean __warm_restart(struct custom_data *custom)
+{
+	struct vmodem_state saved;
+	unsigned int status = 0;
+
+	if (!custom->config.warm_restart || custom->vdpram_fd < 0)
+		return FALSE;
+
+	if (!vmodem_state_load(&saved, custom->config.state_path))
+		return FALSE;
+
+	if (!saved.powered || !saved.good) {
+		dbg("saved state not good, cold start");
+		return FALSE;
+	}
+
+	if (!vmodem_state_matches(&saved, &custom->config)) {
+		dbg("device or tty profile changed, cold start");
+		return FALSE;
+	}
+
+	if (!vdpram_getstatus(custom->vdpram_fd, &status) || status != saved.status) {
+		dbg("live status %u, saved %u, cold start", status, saved.status);
+		return FALSE;
+	}
+
+	custom->state.powered = 1;
+	custom->state.good = 1;
+	custom->state.status = status;
+
+	return TRUE;
+}
+
 static gboolean on_load()
 {
 	dbg("i'm load!");
@@ -159,11 +929,15 @@ static gboolean on_init(TcorePlugin *plugin)
 {
 	TcoreHal *hal;
 	struct custom_data *data;
+	struct vdpram_tty_profile profile;
+	gint64 started;
+	gboolean warm;
 
 	if (!plugin)
 		return FALSE;
 
 	dbg("i'm init!");
+	started = g_get_monotonic_time();
 
 	/*
 	 * Phonet init
@@ -171,20 +945,59 @@ static gboolean on_init(TcorePlugin *plugin)
 	data = calloc(sizeof(struct custom_data), 1);
 	memset(data, 0, sizeof(struct custom_data));
 
-	data->vdpram_fd = vdpram_open();
+	vmodem_config_init(&data->config);
+	vmodem_config_load(&data->config, vmodem_config_path());
+
+	vdpram_set_emulated(data->config.emulated);
+
+	data->shm_bell_rx = -1;
+	data->shm_bell_tx = -1;
+	if (strcmp(data->config.backend, "shm") == 0) {
+		data->vdpram_fd = __open_shm(data);
+	}
+	else {
+		__config_profile(&data->config, &profile);
+		data->vdpram_fd = vdpram_open_path(data->config.device_path, &profile);
+	}
 
 	/*
 	 * HAL init
 	 */
-	hal = tcore_hal_new(plugin, "vmodem", &hops, TCORE_HAL_MODE_CUSTOM);
+	hal = tcore_hal_new(plugin, VMODEM_HAL_NAME, &hops, TCORE_HAL_MODE_CUSTOM);
 	tcore_hal_link_user_data(hal, data);
+	tcore_plugin_link_user_data(plugin, hal);
+	data->hal = hal;
 
-	data->watch_id_vdpram= register_gio_watch(hal, data->vdpram_fd, on_recv_vdpram_message);
+	__apply_config(data, TRUE);
+	if (data->config.sighup)
+		data->watch_id_sighup = g_unix_signal_add(SIGHUP, on_sighup, hal);
+	if (data->config.sigusr1)
+		data->watch_id_sigusr1 = g_unix_signal_add(SIGUSR1, on_sigusr1, hal);
+
+	data->watch_id_vdpram= register_gio_watch(hal,
+			data->shm ? vdpram_shm_fd(data->shm) : data->vdpram_fd, on_recv_vdpram_message);
 
 	dbg("vdpram_fd = %d, watch_id_vdpram=%d ", data->vdpram_fd, data->watch_id_vdpram);
 
-	if (!vdpram_poweron(data->vdpram_fd))
-		err("vdpram_poweron Failed");
+	vmodem_state_from_config(&data->state, &data->config);
+	data->powered_at = started;
+
+	warm = __warm_restart(data);
+	if (warm) {
+		tcore_hal_set_power_state(hal, TRUE);
+		data->ready = TRUE;
+	}
+	else {
+		if (!vdpram_poweron(data->vdpram_fd))
+			err("vdpram_poweron Failed");
+		else
+			data->state.powered = 1;
+		__save_state(data);
+	}
+
+	msg("%s init in %lld us", warm ? "warm" : "cold",
+			(long long)(g_get_monotonic_time() - started));
+	VMODEM_PROBE2(init_done, warm, g_get_monotonic_time() - started);
 
 //	power_tx_pwr_on_exec(data->vdpram_fd);
 
@@ -193,10 +1006,76 @@ static gboolean on_init(TcorePlugin *plugin)
 
 static void on_unload(TcorePlugin *plugin)
 {
+	TcoreHal *hal;
+	struct custom_data *data;
+
 	if (!plugin)
 		return;
 
 	dbg("i'm unload");
+
+	hal = tcore_plugin_ref_user_data(plugin);
+	if (!hal)
+		return;
+
+	data = tcore_hal_ref_user_data(hal);
+	if (!data)
+		return;
+
+	if (data->data_mode)
+		vmodem_hal_leave_data_mode(hal);
+
+	/* nothing may call back into data once it is gone */
+	if (data->watch_id_vdpram) {
+		g_source_remove(data->watch_id_vdpram);
+		data->watch_id_vdpram = 0;
+	}
+
+	if (data->watch_id_sighup) {
+		g_source_remove(data->watch_id_sighup);
+		data->watch_id_sighup = 0;
+	}
+
+	if (data->watch_id_sigusr1) {
+		g_source_remove(data->watch_id_sigusr1);
+		data->watch_id_sigusr1 = 0;
+	}
+
+	vmodem_hal_dump_stats(hal);
+
+	vmodem_watchdog_free(data->watchdog);
+	data->watchdog = NULL;
+
+	vmodem_txsched_free(data->txsched);
+	data->txsched = NULL;
+
+	vmodem_pipeline_free(data->pipeline);
+	data->pipeline = NULL;
+
+	vmodem_cache_free(data->cache);
+	data->cache = NULL;
+
+	vmodem_coalesce_free(data->rx_coalesce);
+	data->rx_coalesce = NULL;
+
+	vmodem_prof_free(data->prof);
+	data->prof = NULL;
+
+	vdpram_dump_configure(VDPRAM_DUMP_NONE, NULL);
+
+	if (data->shm) {
+		vdpram_shm_detach(data->shm);
+		data->shm = NULL;
+		__close_shm_bells(data);
+		close(data->vdpram_fd);
+	}
+	else if (data->vdpram_fd >= 0) {
+		vdpram_close(data->vdpram_fd);
+	}
+
+	tcore_hal_link_user_data(hal, NULL);
+	free(data->rx_buf);
+	free(data);
 }
 
 struct tcore_plugin_define_desc plugin_define_desc =
@@ -28,11 +28,14 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 
 #include <log.h>
 #include "legacy/TelUtility.h"
 #include "vdpram.h"
 #include "vdpram_dump.h"
+#include "vdpram_fault.h"
+#include "vmodem_trace.h"
 
 #ifndef TIOCMODG
 #  ifdef TIOCMGET
@@ -56,6 +59,7 @@
 
 typedef struct _tty_old_setting_t{
 	int		fd;
+	int		hwf;
 	struct	termios  termiosVal;
 	struct	_tty_old_setting_t *next;
 	struct	_tty_old_setting_t *prev;
@@ -63,6 +67,18 @@ typedef struct _tty_old_setting_t{
 
 #define VDPRAM_OPEN_PATH		"/dev/dpram/0"
 
+#ifdef VMODEM_HW_FLOW_CONTROL
+#define VDPRAM_HWF				1
+#else
+#define VDPRAM_HWF				0
+#endif
+
+/* upper bound for one wait on CTS/TX room while flow controlled */
+#define VDPRAM_CTS_WAIT_MS		200
+
+#define VDPRAM_RETRY_MAX		10
+#define VDPRAM_RETRY_SLEEP_US	50
+
 /* DPRAM ioctls for DPRAM tty devices */
 #define IOC_MZ_MAGIC		('h')
 #define HN_DPRAM_PHONE_ON			_IO (IOC_MZ_MAGIC, 0xd0)
@@ -71,6 +87,26 @@ typedef struct _tty_old_setting_t{
 
 static tty_old_setting_t *ttyold_head = NULL;
 
+static int retry_max = VDPRAM_RETRY_MAX;
+static int retry_sleep_us = VDPRAM_RETRY_SLEEP_US;
+static int retry_backoff = 1;
+static int power_save = 0;
+
+/* no DPRAM driver behind the tty (pty, emulator): fake the power ioctls */
+static int emulated = 0;
+static unsigned int emulated_status = 0;
+
+static struct vdpram_io_stats io_stats;
+
+static const struct vdpram_tty_profile default_profile = {
+	.baudrate = "115200",
+	.parity = "N",
+	.bits = "8",
+	.stop = "1",
+	.hwf = VDPRAM_HWF,
+	.swf = 0,
+};
+
 /* static functions */
 static void __insert_tty_oldsetting(tty_old_setting_t *me)
 {
@@ -134,22 +170,29 @@ static void __remove_tty_oldsetting(tty_old_setting_t *me)
 
 /* Set hardware flow control.
 */
-static void __tty_sethwf(int fd, int on)
+static int __tty_sethwf(int fd, int on)
 {
 	struct termios tty;
 
 	dbg("Function Enterence.");
 
-	if (tcgetattr(fd, &tty))
-		err("__tty_sethwf: tcgetattr:");
+	if (tcgetattr(fd, &tty)) {
+		err("__tty_sethwf: tcgetattr: errno[%d]", errno);
+		return TAPI_API_TRANSPORT_LAYER_FAILURE;
+	}
 
 	if (on)
 	    tty.c_cflag |= CRTSCTS;
 	else
 	    tty.c_cflag &= ~CRTSCTS;
 
-	if (tcsetattr(fd, TCSANOW, &tty))
-		err("__tty_sethwf: tcsetattr:");
+	io_stats.ctl++;
+	if (VDPRAM_TCSETATTR(fd, TCSANOW, &tty)) {
+		err("__tty_sethwf: tcsetattr: errno[%d]", errno);
+		return TAPI_API_TRANSPORT_LAYER_FAILURE;
+	}
+
+	return TAPI_API_SUCCESS;
 }
 
 /*
@@ -161,51 +204,94 @@ static int __tty_setrts(int fd)
 
 	dbg("Function Enterence.");
 
-	if (-1 ==  ioctl(fd, TIOCMODG, &mcs))
-		err("icotl: TIOCMODG");
+	io_stats.ctl++;
+	if (-1 ==  VDPRAM_IOCTL(fd, TIOCMODG, &mcs)) {
+		err("icotl: TIOCMODG errno[%d]", errno);
+		return TAPI_API_TRANSPORT_LAYER_FAILURE;
+	}
 
 	mcs |= TIOCM_RTS;
 
-	if (-1 == ioctl(fd, TIOCMODS, &mcs))
-		err("icotl: TIOCMODS");
+	io_stats.ctl++;
+	if (-1 == VDPRAM_IOCTL(fd, TIOCMODS, &mcs)) {
+		err("icotl: TIOCMODS errno[%d]", errno);
+		return TAPI_API_TRANSPORT_LAYER_FAILURE;
+	}
+
+	return TAPI_API_SUCCESS;
+}
+
+/*
+* Wait until the modem lets us send again.
+* TIOCMIWAIT cannot be bounded, so the CTS line is only sampled and the
+* wait itself is a poll() for TX room, which the tty layer raises once
+* CTS is asserted and the buffer drains.
+*/
+static int __tty_wait_tx_room(int fd, int timeout_ms)
+{
+	int mcs = 0;
+	struct pollfd pfd;
+
+	io_stats.ctl++;
+	if (VDPRAM_IOCTL(fd, TIOCMGET, &mcs) == 0 && !(mcs & TIOCM_CTS))
+		dbg("CTS deasserted (fd:%d), waiting", fd);
+
+	pfd.fd = fd;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	io_stats.waits++;
+	if (poll(&pfd, 1, timeout_ms) <= 0)
+		return -1;
 
-	return 0;
+	return (pfd.revents & POLLOUT) ? 0 : -1;
 }
 
 /*
  * Set baudrate, parity and number of bits.
+ * The termios found at the first call is what __tty_close() restores;
+ * later calls on the same fd only re-apply the profile.
  */
-static int __tty_setparms(int fd, char* baudr, char* par, char* bits, char* stop, int hwf, int swf)
+static int __tty_setparms(int fd, const char* baudr, const char* par, const char* bits, const char* stop, int hwf, int swf)
 {
 	int spd = -1;
 	int newbaud;
 	int bit = bits[0];
 	int stop_bit = stop[0];
+	int fresh = 0;
 
 	struct termios tty;
 	tty_old_setting_t *old_setting = NULL;
 
 	dbg("Function Enterence.");
 
-	old_setting = calloc(sizeof(tty_old_setting_t), 1);
+	old_setting = __search_tty_oldsetting(fd);
 
-	if (old_setting == NULL)
-		return TAPI_API_SYSTEM_OUT_OF_MEM;
+	if (old_setting == NULL) {
+		old_setting = calloc(sizeof(tty_old_setting_t), 1);
 
-	old_setting->fd = fd;
+		if (old_setting == NULL)
+			return TAPI_API_SYSTEM_OUT_OF_MEM;
 
-	if (tcgetattr(fd, &tty) < 0) {
-		free(old_setting);
-		return TAPI_API_TRANSPORT_LAYER_FAILURE;
+		old_setting->fd = fd;
+
+		if (tcgetattr(fd, &old_setting->termiosVal) < 0) {
+			free(old_setting);
+			return TAPI_API_TRANSPORT_LAYER_FAILURE;
+		}
+
+		__insert_tty_oldsetting(old_setting);
+		fresh = 1;
 	}
 
-	if (tcgetattr(fd, &old_setting->termiosVal) < 0) {
-		free(old_setting);
+	if (tcgetattr(fd, &tty) < 0) {
+		if (fresh) {
+			__remove_tty_oldsetting(old_setting);
+			free(old_setting);
+		}
 		return TAPI_API_TRANSPORT_LAYER_FAILURE;
 	}
 
-	__insert_tty_oldsetting(old_setting);
-
 	fflush(stdout);
 
 	/* We generate mark and space parity ourself. */
@@ -262,8 +348,54 @@ static int __tty_setparms(int fd, char* baudr, char* par, char* bits, char* stop
 			spd = B115200;
 			break;
 
+		case 2304:
+			spd = B230400;
+			break;
+
+#ifdef B460800
+		case 4608:
+			spd = B460800;
+			break;
+#endif
+
+#ifdef B921600
+		case 9216:
+			spd = B921600;
+			break;
+#endif
+
+#ifdef B1000000
+		case 10000:
+			spd = B1000000;
+			break;
+#endif
+
+#ifdef B1500000
+		case 15000:
+			spd = B1500000;
+			break;
+#endif
+
+#ifdef B2000000
+		case 20000:
+			spd = B2000000;
+			break;
+#endif
+
+#ifdef B3000000
+		case 30000:
+			spd = B3000000;
+			break;
+#endif
+
+#ifdef B4000000
+		case 40000:
+			spd = B4000000;
+			break;
+#endif
+
 		default:
-			err("invaid baud rate");
+			err("invalid baud rate %s, speed unchanged", baudr);
 			break;
 	}
 
@@ -324,13 +456,25 @@ static int __tty_setparms(int fd, char* baudr, char* par, char* bits, char* stop
 	else if (par[0] == 'O')
 	    tty.c_cflag |= (PARENB | PARODD);
 
-	if (tcsetattr(fd, TCSANOW, &tty) < 0) {
-		free(old_setting);
+	if (hwf)
+	    tty.c_cflag |= CRTSCTS;
+	else
+	    tty.c_cflag &= ~CRTSCTS;
+
+	io_stats.ctl++;
+	if (VDPRAM_TCSETATTR(fd, TCSANOW, &tty) < 0) {
+		if (fresh) {
+			__remove_tty_oldsetting(old_setting);
+			free(old_setting);
+		}
 	    return TAPI_API_TRANSPORT_LAYER_FAILURE;
 	}
 
-	__tty_setrts(fd);
-	__tty_sethwf(fd, hwf);
+	old_setting->hwf = hwf;
+
+	/* RTS only matters to the modem when it does flow control */
+	if (__tty_setrts(fd) != TAPI_API_SUCCESS && hwf)
+		return TAPI_API_TRANSPORT_LAYER_FAILURE;
 
 	return TAPI_API_SUCCESS;
 
@@ -339,6 +483,7 @@ static int __tty_setparms(int fd, char* baudr, char* par, char* bits, char* stop
 static int __tty_close(int fd)
 {
 	tty_old_setting_t *old_setting = NULL;
+	int ret = TAPI_API_SUCCESS;
 
 	dbg("Function Enterence.");
 
@@ -346,9 +491,11 @@ static int __tty_close(int fd)
 	if (old_setting == NULL)
 		return TAPI_API_SUCCESS;
 
-	if (tcsetattr(fd, TCSAFLUSH, &old_setting->termiosVal) < 0)	{
-		err("close failed");
-		return TAPI_API_TRANSPORT_LAYER_FAILURE;
+	/* the fd goes away either way, a failed restore must not leak it */
+	io_stats.ctl++;
+	if (VDPRAM_TCSETATTR(fd, TCSAFLUSH, &old_setting->termiosVal) < 0) {
+		err("close failed: termios not restored errno[%d]", errno);
+		ret = TAPI_API_TRANSPORT_LAYER_FAILURE;
 	}
 
 	__remove_tty_oldsetting(old_setting);
@@ -357,7 +504,7 @@ static int __tty_close(int fd)
 
 	close(fd);
 
-	return TAPI_API_SUCCESS;
+	return ret;
 }
 
 /*
@@ -378,44 +525,158 @@ int vdpram_close(int fd)
 *	Open the vdpram fd.
 */
 int vdpram_open (void)
+{
+	return vdpram_open_path(VDPRAM_OPEN_PATH, NULL);
+}
+
+/*
+*	Open a vdpram device with the given termios profile (NULL: default).
+*/
+int vdpram_open_path(const char *path, const struct vdpram_tty_profile *profile)
 {
 	int rv = -1;
 	int fd = -1;
-	int val = 0;
-	unsigned int cmd =0;
+	unsigned int status = 0;
+
+	if (path == NULL)
+		path = VDPRAM_OPEN_PATH;
 
-	fd = open(VDPRAM_OPEN_PATH, O_RDWR);
+	if (profile == NULL)
+		profile = &default_profile;
+
+	/* TX never blocks the main loop: a full tty is the scheduler's business */
+	fd = open(path, O_RDWR | O_NONBLOCK);
 
 	if (fd < 0) {
 		err("#### Failed to open vdpram file: error no hex %x", errno);
 		return rv;
 	}
 	else
-		dbg("#### Success to open vdpram file. fd:%d, path:%s", fd, VDPRAM_OPEN_PATH);
+		dbg("#### Success to open vdpram file. fd:%d, path:%s", fd, path);
 
 
-	if (__tty_setparms(fd, "115200", "N", "8", "1", 0, 0) != TAPI_API_SUCCESS) {
-		vdpram_close(fd);
+	if (__tty_setparms(fd, profile->baudrate, profile->parity, profile->bits, profile->stop,
+			profile->hwf, profile->swf) != TAPI_API_SUCCESS) {
+		/* a failed tcsetattr leaves no saved setting for vdpram_close() to find */
+		if (__search_tty_oldsetting(fd))
+			vdpram_close(fd);
+		else
+			close(fd);
 		return rv;
 	}
 	else
 		dbg("#### Success set tty vdpram params. fd:%d", fd);
 
-	/*TODO: No need to check Status. Delete*/
-	cmd = HN_DPRAM_PHONE_GETSTATUS;
-
-	if (ioctl(fd, cmd, &val) < 0) {
-		err("#### ioctl failed fd:%d, cmd:%lu, val:%d", fd,cmd,val);
+	if (!vdpram_getstatus(fd, &status)) {
 		vdpram_close(fd);
 		return rv;
 	}
-	else
-		dbg("#### ioctl Success fd:%d, cmd:%lu, val:%d", fd,cmd,val);
 
 	return fd;
 
 }
 
+/*
+*	Re-apply a termios profile on an open vdpram fd.
+*/
+int vdpram_set_profile(int fd, const struct vdpram_tty_profile *profile)
+{
+	if (profile == NULL || __search_tty_oldsetting(fd) == NULL)
+		return TAPI_API_INVALID_INPUT;
+
+	return __tty_setparms(fd, profile->baudrate, profile->parity, profile->bits,
+			profile->stop, profile->hwf, profile->swf);
+}
+
+/*
+*	Retry policy for EAGAIN/EBUSY writes. Each sleep is the previous
+*	one times backoff (1: fixed sleep).
+*/
+void vdpram_set_retry_policy(int count, int sleep_us, int backoff)
+{
+	retry_max = count < 0 ? 0 : count;
+	retry_sleep_us = sleep_us < 0 ? 0 : sleep_us;
+	retry_backoff = backoff < 1 ? 1 : backoff;
+
+	dbg("retry count=%d sleep=%dus backoff=x%d", retry_max, retry_sleep_us, retry_backoff);
+}
+
+/*
+*	Emulated device: GETSTATUS/PHONE_ON/PHONE_OFF are answered here
+*	instead of by the DPRAM driver, which a pty does not have.
+*/
+void vdpram_set_emulated(int on)
+{
+	emulated = on;
+	dbg("device %s", on ? "emulated, no DPRAM ioctls" : "DPRAM");
+}
+
+/*
+*	In power save mode a busy tty is waited on, not slept on.
+*/
+void vdpram_set_power_save(int on)
+{
+	power_save = on;
+}
+
+/*
+*	Turn RTS/CTS flow control on or off.
+*/
+int vdpram_set_flow_control(int fd, int on)
+{
+	tty_old_setting_t *setting;
+	int ret;
+
+	setting = __search_tty_oldsetting(fd);
+	if (setting == NULL)
+		return TAPI_API_INVALID_INPUT;
+
+	ret = __tty_sethwf(fd, on);
+	if (ret != TAPI_API_SUCCESS)
+		return ret;
+
+	if (on) {
+		ret = __tty_setrts(fd);
+		if (ret != TAPI_API_SUCCESS) {
+			__tty_sethwf(fd, 0);
+			return ret;
+		}
+	}
+
+	setting->hwf = on;
+	dbg("flow control %s (fd:%d)", on ? "RTS/CTS" : "none", fd);
+
+	return TAPI_API_SUCCESS;
+}
+
+/*
+*	Read the phone status the driver reports (0: phone off).
+*/
+int vdpram_getstatus(int fd, unsigned int *status)
+{
+	unsigned int val = 0;
+
+	if (emulated) {
+		if (status)
+			*status = emulated_status;
+		return 1;
+	}
+
+	io_stats.ctl++;
+	if (VDPRAM_IOCTL(fd, HN_DPRAM_PHONE_GETSTATUS, &val) < 0) {
+		err("#### ioctl failed fd:%d, cmd:GETSTATUS, errno:%d", fd, errno);
+		return 0;
+	}
+
+	dbg("#### ioctl Success fd:%d, cmd:GETSTATUS, val:%u", fd, val);
+	VMODEM_PROBE2(getstatus, fd, val);
+
+	if (status)
+		*status = val;
+
+	return 1;
+}
+
 /*
 *	power on the phone.
 */
@@ -423,7 +684,14 @@ int vdpram_poweron(int fd)
 {
 	int rv = -1;
 
-	if (ioctl(fd, HN_DPRAM_PHONE_ON, NULL) < 0) {
+	if (emulated) {
+		emulated_status = 1;
+		dbg("Phone Power On emulated (fd:%d)", fd);
+		return 1;
+	}
+
+	io_stats.ctl++;
+	if (VDPRAM_IOCTL(fd, HN_DPRAM_PHONE_ON, NULL) < 0) {
 		err("Phone Power On failed (fd:%d)", fd);
 		rv = 0;
 	}
@@ -431,6 +699,7 @@ int vdpram_poweron(int fd)
 		dbg("Phone Power On success (fd:%d)", fd);
 		rv = 1;
 	}
+	VMODEM_PROBE2(poweron, fd, rv);
 	return rv;
 }
 
@@ -441,7 +710,14 @@ int vdpram_poweroff(int fd)
 {
 	int rv;
 
-	if (ioctl(fd, HN_DPRAM_PHONE_OFF, NULL) < 0) {
+	if (emulated) {
+		emulated_status = 0;
+		dbg("Phone Power Off emulated.");
+		return 1;
+	}
+
+	io_stats.ctl++;
+	if (VDPRAM_IOCTL(fd, HN_DPRAM_PHONE_OFF, NULL) < 0) {
 		err("Phone Power Off failed.");
 		rv = -1;
 	}
@@ -449,10 +725,25 @@ int vdpram_poweroff(int fd)
 		dbg("Phone Power Off success.");
 		rv = 1;
 	}
+	VMODEM_PROBE2(poweroff, fd, rv);
 
 	return rv;
 }
 
+/*
+*	Syscall counters of the vdpram tty paths, since start or the last reset.
+*/
+void vdpram_get_io_stats(struct vdpram_io_stats *stats)
+{
+	if (stats)
+		memcpy(stats, &io_stats, sizeof(struct vdpram_io_stats));
+}
+
+void vdpram_reset_io_stats(void)
+{
+	memset(&io_stats, 0, sizeof(struct vdpram_io_stats));
+}
+
 /*
 *	Read data from vdpram.
 */
@@ -461,19 +752,27 @@ int vdpram_tty_read(int nFd, void* buf, size_t nbytes)
 {
 	int	actual = 0;
 
-	if ((actual = read(nFd, buf, nbytes)) < 0) {
+	VMODEM_PROBE2(read_entry, nFd, nbytes);
+
+	io_stats.reads++;
+	if ((actual = VDPRAM_READ(nFd, buf, nbytes)) < 0) {
 		dbg("[TRANSPORT DPRAM]read failed.");
+		io_stats.read_errors++;
 	}
-	vdpram_hex_dump(IPC_RX, actual, buf);
+	else
+		io_stats.read_bytes += actual;
+	VDPRAM_DUMP_FRAME(IPC_RX, actual, buf);
 
+	VMODEM_PROBE2(read_return, nFd, actual);
 	return actual;
 }
 
-static void __selectsleep(int sec,int msec)
+static void __selectsleep(int sec,int usec)
 {
     struct timeval tv;
     tv.tv_sec=sec;
-    tv.tv_usec=msec;
+    tv.tv_usec=usec;
+    io_stats.waits++;
     select(0,NULL,NULL,NULL,&tv);
     return;
 }
@@ -486,17 +785,39 @@ int vdpram_tty_write(int nFd, void* buf, size_t nbytes)
 	int ret;
 	size_t actual = 0;
 	int	retry = 0;
+	int	sleep_us = retry_sleep_us;
+	tty_old_setting_t *setting = NULL;
+
+	VMODEM_PROBE2(write_entry, nFd, nbytes);
+	VDPRAM_DUMP_FRAME(IPC_TX, nbytes, buf);
 
 	do {
-		vdpram_hex_dump(IPC_TX, nbytes, buf);
-		ret = write(nFd, (unsigned char* )buf, nbytes - actual);
+		ret = VDPRAM_WRITE(nFd, (unsigned char* )buf, nbytes - actual);
+		io_stats.writes++;
 
 		if ((ret < 0 && errno == EAGAIN) || (ret < 0 && errno == EBUSY)) {
 			err("write failed. retry.. ret[%d] with errno[%d] ",ret, errno);
-			__selectsleep(0,50);
+			io_stats.write_retries++;
+			VMODEM_PROBE3(write_retry, nFd, errno, retry);
+
+			if (setting == NULL)
+				setting = __search_tty_oldsetting(nFd);
+
+			/* the tty tells us when, no need to guess (and wake up) */
+			if ((setting && setting->hwf) || power_save)
+				__tty_wait_tx_room(nFd, VDPRAM_CTS_WAIT_MS);
+			else {
+				__selectsleep(sleep_us / 1000000, sleep_us % 1000000);
+				if (sleep_us < 1000000)
+					sleep_us *= retry_backoff;
+			}
 
-			if (retry == 10)
-				return 0;
+			/* what already went out must not be sent again by the caller */
+			if (retry >= retry_max) {
+				io_stats.write_drops++;
+				VMODEM_PROBE2(write_return, nFd, actual);
+				return actual;
+			}
 
 			retry = retry + 1;
 		    continue;
@@ -505,16 +826,52 @@ int vdpram_tty_write(int nFd, void* buf, size_t nbytes)
 		if (ret < 0) {
 		    if (actual != nbytes)
 				err("write failed.ret[%d]",ret);
+			io_stats.write_errors++;
 
 			err("errno [%d]",errno);
+			VMODEM_PROBE2(write_return, nFd, actual);
 			return actual;
 		}
 
 		actual  += ret;
 		buf     += ret;
+		io_stats.write_bytes += ret;
+		if (actual < nbytes)
+			io_stats.short_writes++;
 
 	} while(actual < nbytes);
 
+	VMODEM_PROBE2(write_return, nFd, actual);
 	return actual;
 }
+
+/*
+*	One write() to vdpram, no retry and no sleep.
+*	Returns the bytes written or -errno (-EAGAIN: no room right now).
+*/
+int vdpram_tty_write_once(int nFd, const void *buf, size_t nbytes)
+{
+	int ret;
+
+	VMODEM_PROBE2(write_entry, nFd, nbytes);
+
+	io_stats.writes++;
+	ret = VDPRAM_WRITE(nFd, buf, nbytes);
+	if (ret < 0) {
+		ret = -errno;
+		if (ret == -EAGAIN || ret == -EBUSY)
+			io_stats.write_retries++;
+		else
+			io_stats.write_errors++;
+	}
+	else {
+		io_stats.write_bytes += ret;
+		if ((size_t)ret < nbytes)
+			io_stats.short_writes++;
+		VDPRAM_DUMP_FRAME(IPC_TX, ret, (void *)buf);
+	}
+
+	VMODEM_PROBE2(write_return, nFd, ret);
+	return ret;
+}
 /*	EOF	*/
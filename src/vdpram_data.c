@@ -0,0 +1,577 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+#include <log.h>
+#include "vdpram_data.h"
+#include "vmodem_trace.h"
+
+#define VDPRAM_DATA_TUN_PATH	"/dev/net/tun"
+#define VDPRAM_DATA_CHUNK		65536
+
+/* packet peers: each packet crosses vdpram behind a 16-bit big-endian length */
+#define VDPRAM_DATA_FRAME_HDR	2
+#define VDPRAM_DATA_FRAME_MAX	65535
+
+/* a pty master hangs up until its slave is opened: look again this often */
+#define VDPRAM_DATA_PEER_WAIT_MS	100
+
+/* one direction of the passthrough */
+struct data_path {
+	int src;
+	int dst;
+	int stop;		/* read end of the stop pipe */
+	int pipe[2];
+	int use_splice;
+	int framed;		/* the peer side of this path is a packet peer */
+	char *frame_buf;	/* vdpram -> packet peer: partial frames */
+	size_t frame_len;
+	unsigned long long bytes;
+	unsigned long long spliced;
+	unsigned long long packets;
+};
+
+struct vdpram_data {
+	pthread_t thread;
+	int stop_pipe[2];
+	int exit_fd;		/* eventfd, readable once the thread ended on its own */
+	volatile int ended;
+
+	struct data_path rx;	/* vdpram -> peer */
+	struct data_path tx;	/* peer -> vdpram */
+
+	struct timespec started;
+};
+
+/*
+ * The vdpram fd is non-blocking: wait for room, unless data mode is
+ * being stopped meanwhile.
+ */
+static int __wait_writable(int fd, int stop)
+{
+	struct pollfd pfd[2];
+
+	pfd[0].fd = fd;
+	pfd[0].events = POLLOUT;
+	pfd[1].fd = stop;
+	pfd[1].events = POLLIN;
+
+	while (poll(pfd, 2, -1) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+
+	if (pfd[1].revents || !(pfd[0].revents & POLLOUT))
+		return -1;
+
+	return 0;
+}
+
+static int __write_all(int fd, int stop, const char *buf, ssize_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN && __wait_writable(fd, stop) == 0)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/*
+ * A tun (or a datagram socket standing in for one) reads and writes
+ * whole packets, while vdpram is a byte stream that splits and merges
+ * writes as it likes. Packets to and from such a peer are framed.
+ */
+static int __is_packet_peer(int fd)
+{
+	struct ifreq ifr;
+	socklen_t len = sizeof(int);
+	int type;
+
+	if (ioctl(fd, TUNGETIFF, &ifr) == 0)
+		return 1;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0)
+		return type == SOCK_SEQPACKET || type == SOCK_DGRAM;
+
+	return 0;
+}
+
+/* packet peer -> vdpram: one read is one packet, sent behind its length */
+static int __path_frame_out(struct data_path *path, char *copy_buf)
+{
+	ssize_t in;
+
+	in = read(path->src, copy_buf + VDPRAM_DATA_FRAME_HDR, VDPRAM_DATA_FRAME_MAX);
+	if (in <= 0)
+		return (in < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+
+	copy_buf[0] = (in >> 8) & 0xff;
+	copy_buf[1] = in & 0xff;
+
+	if (__write_all(path->dst, path->stop, copy_buf, in + VDPRAM_DATA_FRAME_HDR) < 0)
+		return -1;
+
+	path->bytes += in;
+	path->packets++;
+	return 0;
+}
+
+/* vdpram -> packet peer: collect the stream, hand over complete packets only */
+static int __path_frame_in(struct data_path *path)
+{
+	size_t room = VDPRAM_DATA_CHUNK + VDPRAM_DATA_FRAME_HDR + VDPRAM_DATA_FRAME_MAX
+			- path->frame_len;
+	size_t used = 0;
+	size_t plen;
+	ssize_t in;
+	char *p;
+
+	in = read(path->src, path->frame_buf + path->frame_len, room);
+	if (in <= 0)
+		return (in < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+
+	path->frame_len += in;
+
+	while (path->frame_len - used >= VDPRAM_DATA_FRAME_HDR) {
+		p = path->frame_buf + used;
+		plen = ((unsigned char)p[0] << 8) | (unsigned char)p[1];
+		if (path->frame_len - used < VDPRAM_DATA_FRAME_HDR + plen)
+			break;
+
+		/* a packet write is all or nothing */
+		if (plen && __write_all(path->dst, path->stop, p + VDPRAM_DATA_FRAME_HDR, plen) < 0)
+			return -1;
+
+		used += VDPRAM_DATA_FRAME_HDR + plen;
+		path->bytes += plen;
+		path->packets++;
+	}
+
+	if (used) {
+		path->frame_len -= used;
+		memmove(path->frame_buf, path->frame_buf + used, path->frame_len);
+	}
+
+	return 0;
+}
+
+/*
+ * Move whatever is readable on src to dst through the pipe. The tty and
+ * tun drivers do not implement splice_read on every kernel, so the first
+ * EINVAL switches this direction to a plain read/write copy for good.
+ */
+static int __path_move(struct data_path *path, char *copy_buf)
+{
+	ssize_t in;
+	ssize_t out;
+	ssize_t left;
+
+	if (path->framed)
+		return path->frame_buf ? __path_frame_in(path) : __path_frame_out(path, copy_buf);
+
+	if (path->use_splice) {
+		in = splice(path->src, NULL, path->pipe[1], NULL, VDPRAM_DATA_CHUNK,
+				SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (in < 0 && errno == EINVAL) {
+			dbg("splice not supported on fd %d, copying", path->src);
+			path->use_splice = 0;
+		}
+		else if (in <= 0) {
+			return (in < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+		}
+		else {
+			left = in;
+			while (left > 0) {
+				out = splice(path->pipe[0], NULL, path->dst, NULL, left, SPLICE_F_MOVE);
+				if (out < 0 && errno == EINTR)
+					continue;
+				if (out < 0 && errno == EAGAIN && __wait_writable(path->dst, path->stop) == 0)
+					continue;
+				if (out < 0 && errno == EINVAL) {
+					/* dst cannot splice_write: drain what is in the pipe */
+					path->use_splice = 0;
+					out = read(path->pipe[0], copy_buf, left);
+					if (out != left || __write_all(path->dst, path->stop, copy_buf, out) < 0)
+						return -1;
+					path->bytes += in;
+					return 0;
+				}
+				if (out <= 0)
+					return -1;
+				left -= out;
+			}
+			path->bytes += in;
+			path->spliced += in;
+			return 0;
+		}
+	}
+
+	in = read(path->src, copy_buf, VDPRAM_DATA_CHUNK);
+	if (in <= 0)
+		return (in < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+
+	if (__write_all(path->dst, path->stop, copy_buf, in) < 0)
+		return -1;
+
+	path->bytes += in;
+	return 0;
+}
+
+/*
+ * pppd opens the pty slave some time after data mode is entered; until
+ * then the master reports POLLHUP, which must not end data mode. The
+ * slave counts as open once the peer stops hanging up or has data.
+ * Returns 1 when data mode is stopped meanwhile, -1 on error.
+ */
+static int __wait_peer(struct vdpram_data *dm)
+{
+	struct pollfd pfd[2];
+	int ret;
+
+	pfd[0].fd = dm->stop_pipe[0];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = dm->tx.src;
+	pfd[1].events = POLLIN;
+
+	while (1) {
+		ret = poll(pfd, 2, VDPRAM_DATA_PEER_WAIT_MS);
+		if (ret < 0 && errno != EINTR)
+			return -1;
+		if (ret < 0)
+			continue;
+
+		if (pfd[0].revents)
+			return 1;
+
+		if (ret == 0 || (pfd[1].revents & POLLIN))
+			break;
+
+		if (pfd[1].revents & POLLNVAL)
+			return -1;
+
+		/* still hung up: wait without the peer in the set */
+		if (poll(pfd, 1, VDPRAM_DATA_PEER_WAIT_MS) > 0)
+			return 1;
+	}
+
+	dbg("data mode peer opened (fd:%d)", dm->tx.src);
+	return 0;
+}
+
+static void *__data_thread(void *arg)
+{
+	struct vdpram_data *dm = arg;
+	struct pollfd pfd[3];
+	char *copy_buf;
+	uint64_t one = 1;
+	int stopped = 0;
+
+	copy_buf = malloc(VDPRAM_DATA_CHUNK + VDPRAM_DATA_FRAME_HDR);
+	if (!copy_buf)
+		goto out;
+
+	if (isatty(dm->tx.src)) {
+		stopped = __wait_peer(dm);
+		if (stopped != 0)
+			goto done;
+	}
+
+	pfd[0].fd = dm->rx.src;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = dm->tx.src;
+	pfd[1].events = POLLIN;
+	pfd[2].fd = dm->stop_pipe[0];
+	pfd[2].events = POLLIN;
+
+	while (1) {
+		if (poll(pfd, 3, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err("data mode poll failed errno[%d]", errno);
+			break;
+		}
+
+		if (pfd[2].revents) {
+			stopped = 1;
+			break;
+		}
+
+		if ((pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+				|| (pfd[1].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+			err("data mode endpoint closed");
+			break;
+		}
+
+		if ((pfd[0].revents & POLLIN) && __path_move(&dm->rx, copy_buf) < 0) {
+			err("data mode rx failed errno[%d]", errno);
+			break;
+		}
+
+		if ((pfd[1].revents & POLLIN) && __path_move(&dm->tx, copy_buf) < 0) {
+			err("data mode tx failed errno[%d]", errno);
+			break;
+		}
+	}
+
+done:
+	free(copy_buf);
+	if (stopped > 0)
+		return NULL;
+
+out:
+	/* endpoint closed or I/O error: tell the main loop */
+	dm->ended = 1;
+	if (write(dm->exit_fd, &one, sizeof(one)) != sizeof(one))
+		err("data mode exit signal failed errno[%d]", errno);
+
+	return NULL;
+}
+
+static int __path_init(struct data_path *path, int src, int dst, int stop, int framed)
+{
+	path->src = src;
+	path->dst = dst;
+	path->stop = stop;
+	path->use_splice = 1;
+	path->framed = framed;
+	path->pipe[0] = path->pipe[1] = -1;
+
+	/* framing needs the bytes in user space */
+	if (framed) {
+		path->use_splice = 0;
+		return 0;
+	}
+
+	if (pipe2(path->pipe, O_CLOEXEC) < 0) {
+		path->pipe[0] = path->pipe[1] = -1;
+		path->use_splice = 0;
+		return -1;
+	}
+
+	fcntl(path->pipe[0], F_SETPIPE_SZ, VDPRAM_DATA_CHUNK);
+
+	return 0;
+}
+
+static void __path_deinit(struct data_path *path)
+{
+	if (path->pipe[0] >= 0)
+		close(path->pipe[0]);
+	if (path->pipe[1] >= 0)
+		close(path->pipe[1]);
+	free(path->frame_buf);
+}
+
+/*
+*	Open a tun interface for raw IP data mode.
+*/
+int vdpram_data_open_tun(const char *ifname)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open(VDPRAM_DATA_TUN_PATH, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		err("open %s failed errno[%d]", VDPRAM_DATA_TUN_PATH, errno);
+		return -1;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+	if (ifname)
+		snprintf(ifr.ifr_name, IFNAMSIZ, "%s", ifname);
+
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		err("TUNSETIFF failed errno[%d]", errno);
+		close(fd);
+		return -1;
+	}
+
+	dbg("tun %s opened (fd:%d)", ifr.ifr_name, fd);
+	return fd;
+}
+
+/*
+*	Open a pty master for PPP data mode; pppd attaches to slave_name.
+*/
+int vdpram_data_open_pty(char *slave_name, size_t len)
+{
+	int fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (fd < 0) {
+		err("posix_openpt failed errno[%d]", errno);
+		return -1;
+	}
+
+	if (grantpt(fd) < 0 || unlockpt(fd) < 0
+			|| ptsname_r(fd, slave_name, len) != 0) {
+		err("pty setup failed errno[%d]", errno);
+		close(fd);
+		return -1;
+	}
+
+	dbg("pty %s opened (fd:%d)", slave_name, fd);
+	return fd;
+}
+
+/*
+*	Start moving data between vdpram and the peer endpoint.
+*/
+struct vdpram_data *vdpram_data_start(int vdpram_fd, int peer_fd)
+{
+	struct vdpram_data *dm;
+	int framed;
+
+	if (vdpram_fd < 0 || peer_fd < 0)
+		return NULL;
+
+	dm = calloc(sizeof(struct vdpram_data), 1);
+	if (!dm)
+		return NULL;
+
+	if (pipe2(dm->stop_pipe, O_CLOEXEC) < 0) {
+		free(dm);
+		return NULL;
+	}
+
+	dm->exit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (dm->exit_fd < 0) {
+		close(dm->stop_pipe[0]);
+		close(dm->stop_pipe[1]);
+		free(dm);
+		return NULL;
+	}
+
+	framed = __is_packet_peer(peer_fd);
+	if (framed) {
+		dm->rx.frame_buf = malloc(VDPRAM_DATA_CHUNK + VDPRAM_DATA_FRAME_HDR
+				+ VDPRAM_DATA_FRAME_MAX);
+		if (!dm->rx.frame_buf) {
+			close(dm->exit_fd);
+			close(dm->stop_pipe[0]);
+			close(dm->stop_pipe[1]);
+			free(dm);
+			return NULL;
+		}
+	}
+
+	if (__path_init(&dm->rx, vdpram_fd, peer_fd, dm->stop_pipe[0], framed) < 0)
+		dbg("no pipe for splice, rx copies");
+	if (__path_init(&dm->tx, peer_fd, vdpram_fd, dm->stop_pipe[0], framed) < 0)
+		dbg("no pipe for splice, tx copies");
+
+	clock_gettime(CLOCK_MONOTONIC, &dm->started);
+
+	if (pthread_create(&dm->thread, NULL, __data_thread, dm) != 0) {
+		err("data mode thread failed");
+		__path_deinit(&dm->rx);
+		__path_deinit(&dm->tx);
+		close(dm->stop_pipe[0]);
+		close(dm->stop_pipe[1]);
+		close(dm->exit_fd);
+		free(dm);
+		return NULL;
+	}
+
+	VMODEM_PROBE2(data_start, vdpram_fd, peer_fd);
+	dbg("data mode started (vdpram:%d, peer:%d%s)", vdpram_fd, peer_fd,
+			framed ? ", length-framed packets" : "");
+
+	return dm;
+}
+
+/*
+*	Stop data mode. The endpoints stay open and belong to the caller.
+*/
+void vdpram_data_stop(struct vdpram_data *dm, struct vdpram_data_stats *stats)
+{
+	struct timespec now;
+	char c = 0;
+
+	if (!dm)
+		return;
+
+	if (write(dm->stop_pipe[1], &c, 1) != 1)
+		err("data mode stop signal failed errno[%d]", errno);
+
+	pthread_join(dm->thread, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (stats) {
+		stats->rx_bytes = dm->rx.bytes;
+		stats->tx_bytes = dm->tx.bytes;
+		stats->spliced = dm->rx.spliced + dm->tx.spliced;
+		stats->rx_packets = dm->rx.packets;
+		stats->tx_packets = dm->tx.packets;
+		stats->ended = dm->ended;
+		stats->elapsed_us = (now.tv_sec - dm->started.tv_sec) * 1000000LL
+				+ (now.tv_nsec - dm->started.tv_nsec) / 1000;
+	}
+
+	VMODEM_PROBE2(data_stop, dm->rx.bytes, dm->tx.bytes);
+
+	__path_deinit(&dm->rx);
+	__path_deinit(&dm->tx);
+	close(dm->stop_pipe[0]);
+	close(dm->stop_pipe[1]);
+	close(dm->exit_fd);
+	free(dm);
+}
+
+/*
+*	Readable once the passthrough ended by itself (peer closed, I/O
+*	error); the caller still has to vdpram_data_stop().
+*/
+int vdpram_data_exit_fd(struct vdpram_data *dm)
+{
+	return dm ? dm->exit_fd : -1;
+}
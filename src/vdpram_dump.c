@@ -21,10 +21,14 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include <log.h>
 
 #include "vdpram_dump.h"
 
+static int dump_level = VDPRAM_DUMP_NONE;
+static FILE *capture_fp = NULL;
+
 static void hex_dump(char *pad, int size, const void *data)
 {
 	char buf[255] = {0, };
@@ -59,7 +63,7 @@ static void hex_dump(char *pad, int size, const void *data)
 	msg("%s", buf);
 }
 
-void vdpram_hex_dump(int dir, unsigned short data_len, void *data)
+static void vdpram_hex_dump(int dir, int data_len, void *data)
 {
 	char *d;
 
@@ -72,9 +76,71 @@ void vdpram_hex_dump(int dir, unsigned short data_len, void *data)
 		d = "[TX]";
 
 	msg("");
-	msg("  %s\tlen=%d\t%s", d, data_len, (char *)data);
+	/* frames are not NUL terminated */
+	msg("  %s\tlen=%d\t%.*s", d, data_len, data_len, (char *)data);
 	hex_dump("        ", data_len, data);
 
 	msg("");
 }
 
+static void capture_frame(int dir, int data_len, void *data)
+{
+	struct vdpram_capture_header hdr;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	hdr.timestamp_us = (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	hdr.dir = dir;
+	hdr.len = data_len;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, capture_fp) != 1
+			|| fwrite(data, 1, data_len, capture_fp) != (size_t)data_len)
+		err("capture write failed");
+}
+
+static void vdpram_dump_set_level(int level)
+{
+	dump_level = level;
+}
+
+/*
+ * Start appending every frame to path; NULL stops capturing.
+ */
+static int vdpram_dump_set_capture(const char *path)
+{
+	if (capture_fp) {
+		fclose(capture_fp);
+		capture_fp = NULL;
+	}
+
+	if (path) {
+		capture_fp = fopen(path, "ab");
+		if (!capture_fp)
+			err("capture file %s open failed", path);
+		else
+			dbg("capturing to %s", path);
+	}
+
+	return capture_fp ? 0 : (path ? -1 : 0);
+}
+
+static void vdpram_dump_frame(int dir, int data_len, void *data)
+{
+	if (!data || data_len <= 0)
+		return;
+
+	if (capture_fp)
+		capture_frame(dir, data_len, data);
+
+	if (dump_level >= VDPRAM_DUMP_HEX)
+		vdpram_hex_dump(dir, data_len, data);
+	else if (dump_level == VDPRAM_DUMP_SUMMARY)
+		msg("  %s\tlen=%d", dir == IPC_RX ? "[RX]" : "[TX]", data_len);
+}
+
+const struct vdpram_dump_ops vdpram_dump_module = {
+	.set_level = vdpram_dump_set_level,
+	.set_capture = vdpram_dump_set_capture,
+	.frame = vdpram_dump_frame,
+};
@@ -0,0 +1,100 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <dlfcn.h>
+
+#include <log.h>
+#include "vdpram_dump.h"
+
+const struct vdpram_dump_ops *vdpram_dump = NULL;
+
+static const struct vdpram_dump_ops *loaded = NULL;
+
+static const char *__module_path(void)
+{
+#ifdef VMODEM_OFF_TARGET
+	const char *path = getenv("VMODEM_DUMP_MODULE");
+
+	if (path && path[0] != '\0')
+		return path;
+#endif
+
+	return VDPRAM_DUMP_MODULE_PATH;
+}
+
+/*
+ * The module is never unloaded: turning diagnostics off only clears
+ * vdpram_dump, so a frame in progress cannot run into unmapped code.
+ */
+static const struct vdpram_dump_ops *__load_module(void)
+{
+	const char *path = __module_path();
+	void *handle;
+
+	if (loaded)
+		return loaded;
+
+	handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		err("diagnostics module not available: %s", dlerror());
+		return NULL;
+	}
+
+	loaded = dlsym(handle, "vdpram_dump_module");
+	if (!loaded) {
+		err("%s: no vdpram_dump_module", path);
+		dlclose(handle);
+		return NULL;
+	}
+
+	dbg("diagnostics module %s loaded", path);
+
+	return loaded;
+}
+
+int vdpram_dump_configure(int level, const char *capture_path)
+{
+	const struct vdpram_dump_ops *ops;
+	int ret;
+
+	if (level <= VDPRAM_DUMP_NONE && !capture_path) {
+		vdpram_dump = NULL;
+		if (loaded) {
+			loaded->set_capture(NULL);
+			loaded->set_level(VDPRAM_DUMP_NONE);
+		}
+		return 0;
+	}
+
+	ops = __load_module();
+	if (!ops)
+		return -1;
+
+	ops->set_level(level);
+	ret = ops->set_capture(capture_path);
+
+	vdpram_dump = ops;
+
+	return ret;
+}
@@ -0,0 +1,310 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include <log.h>
+#include "vdpram_fault.h"
+#include "vmodem_trace.h"
+
+#define VDPRAM_FAULT_SCRIPT_MAX	64
+
+enum fault_op {
+	FAULT_READ,
+	FAULT_WRITE,
+	FAULT_IOCTL,
+	FAULT_TCSETATTR,
+	FAULT_OP_MAX
+};
+
+enum fault_kind {
+	FAULT_OK,
+	FAULT_EAGAIN,
+	FAULT_EBUSY,
+	FAULT_EIO,
+	FAULT_SHORT,
+	FAULT_KIND_MAX
+};
+
+struct fault_site {
+	double prob[FAULT_KIND_MAX];
+	unsigned char script[VDPRAM_FAULT_SCRIPT_MAX];
+	int script_len;
+	int script_pos;
+
+	unsigned long long calls;
+	unsigned long long injected[FAULT_KIND_MAX];
+};
+
+static const char *op_name[FAULT_OP_MAX] = {
+	"read", "write", "ioctl", "tcsetattr"
+};
+
+static const char *kind_name[FAULT_KIND_MAX] = {
+	"ok", "eagain", "ebusy", "eio", "short"
+};
+
+static struct fault_site sites[FAULT_OP_MAX];
+static unsigned long long rng_state = 1;
+static int configured = 0;
+
+/* xorshift64*: reproducible for a given seed, independent of rand() users */
+static double __rand01(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+
+	return (double)((rng_state * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+static int __lookup(const char *name, size_t len, const char **table, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (strlen(table[i]) == len && strncmp(table[i], name, len) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static int __parse_script(struct fault_site *site, int op, const char *val)
+{
+	const char *end;
+	int kind;
+
+	site->script_len = 0;
+	site->script_pos = 0;
+
+	while (*val && site->script_len < VDPRAM_FAULT_SCRIPT_MAX) {
+		end = strchr(val, '/');
+		if (!end)
+			end = val + strlen(val);
+
+		kind = __lookup(val, end - val, kind_name, FAULT_KIND_MAX);
+		if (kind < 0 || (kind == FAULT_SHORT && op != FAULT_READ && op != FAULT_WRITE))
+			return -1;
+
+		site->script[site->script_len++] = kind;
+		val = *end ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+/* one "key=value" entry */
+static int __parse_entry(const char *entry)
+{
+	const char *eq;
+	const char *dot;
+	int op;
+	int kind;
+	double p;
+
+	eq = strchr(entry, '=');
+	if (!eq)
+		return -1;
+
+	if (strncmp(entry, "seed=", 5) == 0) {
+		rng_state = strtoull(eq + 1, NULL, 0);
+		if (rng_state == 0)
+			rng_state = 1;
+		return 0;
+	}
+
+	dot = memchr(entry, '.', eq - entry);
+	if (!dot)
+		return -1;
+
+	op = __lookup(entry, dot - entry, op_name, FAULT_OP_MAX);
+	if (op < 0)
+		return -1;
+
+	if ((size_t)(eq - dot - 1) == strlen("script") && strncmp(dot + 1, "script", 6) == 0)
+		return __parse_script(&sites[op], op, eq + 1);
+
+	kind = __lookup(dot + 1, eq - dot - 1, kind_name, FAULT_KIND_MAX);
+	if (kind <= FAULT_OK || (kind == FAULT_SHORT && op != FAULT_READ && op != FAULT_WRITE))
+		return -1;
+
+	p = strtod(eq + 1, NULL);
+	if (p < 0 || p > 1)
+		return -1;
+
+	sites[op].prob[kind] = p;
+	return 0;
+}
+
+/*
+*	Replace the fault spec. Returns -1 on the first bad entry, which is
+*	logged and skipped.
+*/
+int vdpram_fault_configure(const char *spec)
+{
+	char *copy;
+	char *entry;
+	char *save = NULL;
+	int ret = 0;
+
+	memset(sites, 0, sizeof(sites));
+	rng_state = 1;
+	configured = 1;
+
+	if (!spec || !*spec)
+		return 0;
+
+	copy = strdup(spec);
+	if (!copy)
+		return -1;
+
+	for (entry = strtok_r(copy, ", \t", &save); entry; entry = strtok_r(NULL, ", \t", &save)) {
+		if (__parse_entry(entry) < 0) {
+			err("fault spec: bad entry '%s'", entry);
+			ret = -1;
+		}
+	}
+
+	free(copy);
+
+	msg("fault injection armed: %s", spec);
+
+	return ret;
+}
+
+static enum fault_kind __decide(enum fault_op op)
+{
+	struct fault_site *site = &sites[op];
+	enum fault_kind kind = FAULT_OK;
+	double r;
+	double acc = 0;
+	int i;
+
+	if (!configured)
+		vdpram_fault_configure(getenv("VDPRAM_FAULT"));
+
+	site->calls++;
+
+	if (site->script_pos < site->script_len) {
+		kind = site->script[site->script_pos++];
+	}
+	else {
+		r = __rand01();
+		for (i = FAULT_OK + 1; i < FAULT_KIND_MAX; i++) {
+			acc += site->prob[i];
+			if (r < acc) {
+				kind = i;
+				break;
+			}
+		}
+	}
+
+	if (kind != FAULT_OK) {
+		site->injected[kind]++;
+		VMODEM_PROBE2(fault, op, kind);
+	}
+
+	return kind;
+}
+
+static int __fail(enum fault_kind kind)
+{
+	switch (kind) {
+	case FAULT_EAGAIN:
+		errno = EAGAIN;
+		break;
+	case FAULT_EBUSY:
+		errno = EBUSY;
+		break;
+	default:
+		errno = EIO;
+		break;
+	}
+
+	return -1;
+}
+
+ssize_t vdpram_fault_read(int fd, void *buf, size_t nbytes)
+{
+	enum fault_kind kind = __decide(FAULT_READ);
+
+	if (kind == FAULT_SHORT && nbytes > 1)
+		return read(fd, buf, nbytes / 2);
+	if (kind != FAULT_OK && kind != FAULT_SHORT)
+		return __fail(kind);
+
+	return read(fd, buf, nbytes);
+}
+
+ssize_t vdpram_fault_write(int fd, const void *buf, size_t nbytes)
+{
+	enum fault_kind kind = __decide(FAULT_WRITE);
+
+	if (kind == FAULT_SHORT && nbytes > 1)
+		return write(fd, buf, nbytes / 2);
+	if (kind != FAULT_OK && kind != FAULT_SHORT)
+		return __fail(kind);
+
+	return write(fd, buf, nbytes);
+}
+
+int vdpram_fault_ioctl(int fd, unsigned long request, void *arg)
+{
+	enum fault_kind kind = __decide(FAULT_IOCTL);
+
+	if (kind != FAULT_OK)
+		return __fail(kind);
+
+	return ioctl(fd, request, arg);
+}
+
+int vdpram_fault_tcsetattr(int fd, int action, const struct termios *tio)
+{
+	enum fault_kind kind = __decide(FAULT_TCSETATTR);
+
+	if (kind != FAULT_OK)
+		return __fail(kind);
+
+	return tcsetattr(fd, action, tio);
+}
+
+void vdpram_fault_dump(void)
+{
+	int op;
+	struct fault_site *s;
+
+	for (op = 0; op < FAULT_OP_MAX; op++) {
+		s = &sites[op];
+		if (s->calls == 0)
+			continue;
+
+		msg("fault %-9s: %llu calls, injected eagain=%llu ebusy=%llu eio=%llu short=%llu",
+				op_name[op], s->calls, s->injected[FAULT_EAGAIN], s->injected[FAULT_EBUSY],
+				s->injected[FAULT_EIO], s->injected[FAULT_SHORT]);
+	}
+}
@@ -0,0 +1,392 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+
+#include <log.h>
+#include "vdpram_shm.h"
+#include "vdpram_dump.h"
+#include "vmodem_trace.h"
+
+struct vdpram_shm {
+	int mem_fd;
+	int tx_bell;
+	int rx_bell;
+	int self_bell;	/* rung by our own read when it left data behind */
+	int poll_fd;	/* epoll over rx_bell and self_bell */
+
+	unsigned char *base;
+	size_t map_len;
+
+	/* ring sizes as validated at attach; the header is the peer's to scribble on */
+	unsigned int tx_size;
+	unsigned int rx_size;
+
+	struct vdpram_shm_ring *tx;
+	struct vdpram_shm_ring *rx;
+	unsigned char *tx_data;
+	unsigned char *rx_data;
+};
+
+static int __memfd_create(const char *name)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, name, 1 /* MFD_CLOEXEC */);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void __ring(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) != sizeof(one))
+		err("doorbell write failed errno[%d]", errno);
+}
+
+/* a queueing doorbell (a FIFO) hands back one ring per 8 bytes, take several */
+static void __ack(int fd)
+{
+	uint64_t cnt[8];
+
+	if (read(fd, cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+		err("doorbell read failed errno[%d]", errno);
+}
+
+/* both fds on one doorbell node (eventfds are all one anonymous inode) */
+static int __same_bell(int a, int b)
+{
+	struct stat sa;
+	struct stat sb;
+
+	if (a == b)
+		return 1;
+
+	if (fstat(a, &sa) < 0 || fstat(b, &sb) < 0)
+		return 0;
+
+	if (S_ISCHR(sa.st_mode) && S_ISCHR(sb.st_mode))
+		return sa.st_rdev == sb.st_rdev;
+
+	if (S_ISFIFO(sa.st_mode) && S_ISFIFO(sb.st_mode))
+		return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+
+	return 0;
+}
+
+static int __ring_valid(const struct vdpram_shm_ring *r, size_t map_len)
+{
+	if (r->size == 0 || (r->size & (r->size - 1)) != 0)
+		return 0;
+
+	return r->offset <= map_len && r->size <= map_len - r->offset;
+}
+
+/*
+ * Ringing rx_bell ourselves to stay readable would look like the peer
+ * to whatever else watches the node. A private eventfd does that, and
+ * the fd handed out polls both.
+ */
+static int __self_bell_init(struct vdpram_shm *shm)
+{
+	struct epoll_event ev;
+
+	shm->self_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (shm->self_bell < 0)
+		return -1;
+
+	shm->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (shm->poll_fd < 0)
+		goto fail;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	if (epoll_ctl(shm->poll_fd, EPOLL_CTL_ADD, shm->rx_bell, &ev) < 0
+			|| epoll_ctl(shm->poll_fd, EPOLL_CTL_ADD, shm->self_bell, &ev) < 0) {
+		close(shm->poll_fd);
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	close(shm->self_bell);
+	return -1;
+}
+
+/*
+*	Build an emulated mailbox: a memfd holding the layout and one
+*	eventfd per ring. bells[n] is rung when ring n has new data.
+*/
+int vdpram_shm_create_memfd(unsigned int ring_size, int *mem_fd, int bells[2])
+{
+	struct vdpram_shm_header *hdr;
+	size_t len;
+	int fd;
+
+	if (!mem_fd || !bells || ring_size == 0 || (ring_size & (ring_size - 1)) != 0)
+		return -1;
+
+	len = sizeof(struct vdpram_shm_header) + 2 * (size_t)ring_size;
+
+	fd = __memfd_create("vdpram-shm");
+	if (fd < 0) {
+		err("memfd_create failed errno[%d]", errno);
+		return -1;
+	}
+
+	if (ftruncate(fd, len) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	hdr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+
+	memset(hdr, 0, sizeof(struct vdpram_shm_header));
+	hdr->magic = VDPRAM_SHM_MAGIC;
+	hdr->version = VDPRAM_SHM_VERSION;
+	hdr->ring[0].size = ring_size;
+	hdr->ring[0].offset = sizeof(struct vdpram_shm_header);
+	hdr->ring[1].size = ring_size;
+	hdr->ring[1].offset = sizeof(struct vdpram_shm_header) + ring_size;
+
+	munmap(hdr, len);
+
+	bells[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	bells[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (bells[0] < 0 || bells[1] < 0) {
+		if (bells[0] >= 0)
+			close(bells[0]);
+		if (bells[1] >= 0)
+			close(bells[1]);
+		close(fd);
+		return -1;
+	}
+
+	*mem_fd = fd;
+	return 0;
+}
+
+/*
+*	Map the mailbox. The fds stay owned by the caller.
+*/
+struct vdpram_shm *vdpram_shm_attach(int mem_fd, int side, int tx_bell, int rx_bell)
+{
+	struct vdpram_shm *shm;
+	struct vdpram_shm_header *hdr;
+	struct stat st;
+
+	if (mem_fd < 0 || tx_bell < 0 || rx_bell < 0 || side < 0 || side > 1)
+		return NULL;
+
+	if (__same_bell(tx_bell, rx_bell)) {
+		err("one doorbell for both directions loses wakeups (fd:%d/%d)", tx_bell, rx_bell);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (fstat(mem_fd, &st) < 0 || (size_t)st.st_size < sizeof(struct vdpram_shm_header)) {
+		err("mailbox too small or unreadable (fd:%d)", mem_fd);
+		return NULL;
+	}
+
+	shm = calloc(sizeof(struct vdpram_shm), 1);
+	if (!shm)
+		return NULL;
+
+	shm->map_len = st.st_size;
+	shm->base = mmap(NULL, shm->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	if (shm->base == MAP_FAILED) {
+		err("mailbox mmap failed errno[%d]", errno);
+		free(shm);
+		return NULL;
+	}
+
+	hdr = (struct vdpram_shm_header *)shm->base;
+	if (hdr->magic != VDPRAM_SHM_MAGIC || hdr->version != VDPRAM_SHM_VERSION
+			|| !__ring_valid(&hdr->ring[0], shm->map_len)
+			|| !__ring_valid(&hdr->ring[1], shm->map_len)) {
+		err("bad mailbox header (magic 0x%x)", hdr->magic);
+		munmap(shm->base, shm->map_len);
+		free(shm);
+		return NULL;
+	}
+
+	shm->mem_fd = mem_fd;
+	shm->tx_bell = tx_bell;
+	shm->rx_bell = rx_bell;
+	shm->tx = &hdr->ring[side];
+	shm->rx = &hdr->ring[1 - side];
+	shm->tx_size = shm->tx->size;
+	shm->rx_size = shm->rx->size;
+	shm->tx_data = shm->base + shm->tx->offset;
+	shm->rx_data = shm->base + shm->rx->offset;
+
+	if (__self_bell_init(shm) < 0) {
+		err("mailbox self doorbell failed errno[%d]", errno);
+		munmap(shm->base, shm->map_len);
+		free(shm);
+		return NULL;
+	}
+
+	dbg("mailbox attached: side %d, %u/%u byte rings", side, shm->tx_size, shm->rx_size);
+
+	return shm;
+}
+
+void vdpram_shm_detach(struct vdpram_shm *shm)
+{
+	if (!shm)
+		return;
+
+	close(shm->poll_fd);
+	close(shm->self_bell);
+	munmap(shm->base, shm->map_len);
+	free(shm);
+}
+
+int vdpram_shm_fd(struct vdpram_shm *shm)
+{
+	return shm ? shm->poll_fd : -1;
+}
+
+/*
+*	Copy as much as fits into the TX ring and ring the peer.
+*	Returns the number of bytes queued, 0 when the ring is full.
+*/
+int vdpram_shm_write(struct vdpram_shm *shm, const void *buf, size_t nbytes)
+{
+	struct vdpram_shm_ring *r;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int room;
+	unsigned int n;
+	unsigned int pos;
+	unsigned int first;
+
+	if (!shm || !buf)
+		return -1;
+
+	r = shm->tx;
+	head = r->head;
+	tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+	/* a tail past head or more than a ring behind is not ours to trust */
+	if (head - tail > shm->tx_size) {
+		err("mailbox tx ring corrupt (head %u, tail %u)", head, tail);
+		errno = EPROTO;
+		return -1;
+	}
+	room = shm->tx_size - (head - tail);
+
+	n = nbytes < room ? nbytes : room;
+	if (n == 0)
+		return 0;
+
+	pos = head & (shm->tx_size - 1);
+	first = shm->tx_size - pos < n ? shm->tx_size - pos : n;
+
+	memcpy(shm->tx_data + pos, buf, first);
+	memcpy(shm->tx_data, (const unsigned char *)buf + first, n - first);
+
+	__atomic_store_n(&r->head, head + n, __ATOMIC_RELEASE);
+	__ring(shm->tx_bell);
+
+	VMODEM_PROBE1(shm_write, n);
+	VDPRAM_DUMP_FRAME(IPC_TX, n, (void *)buf);
+
+	return n;
+}
+
+/*
+*	Acknowledge the doorbell and copy out what the RX ring holds.
+*/
+int vdpram_shm_read(struct vdpram_shm *shm, void *buf, size_t nbytes)
+{
+	struct vdpram_shm_ring *r;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int avail;
+	unsigned int n;
+	unsigned int pos;
+	unsigned int first;
+
+	if (!shm || !buf)
+		return -1;
+
+	/* ack first: data produced after this rings again */
+	__ack(shm->rx_bell);
+	__ack(shm->self_bell);
+
+	r = shm->rx;
+	tail = r->tail;
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	avail = head - tail;
+
+	/* more than a ring's worth would read past the data area */
+	if (avail > shm->rx_size) {
+		err("mailbox rx ring corrupt (head %u, tail %u)", head, tail);
+		errno = EPROTO;
+		return -1;
+	}
+
+	n = nbytes < avail ? nbytes : avail;
+	if (n == 0)
+		return 0;
+
+	pos = tail & (shm->rx_size - 1);
+	first = shm->rx_size - pos < n ? shm->rx_size - pos : n;
+
+	memcpy(buf, shm->rx_data + pos, first);
+	memcpy((unsigned char *)buf + first, shm->rx_data, n - first);
+
+	__atomic_store_n(&r->tail, tail + n, __ATOMIC_RELEASE);
+
+	/* left data behind: keep ourselves readable for the next round */
+	if (n < avail)
+		__ring(shm->self_bell);
+
+	VMODEM_PROBE1(shm_read, n);
+	VDPRAM_DUMP_FRAME(IPC_RX, n, buf);
+
+	return n;
+}
@@ -0,0 +1,200 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "vmodem_at.h"
+
+/* exact lines */
+static const char *final_exact[] = {
+	"OK",
+	"ERROR",
+	NULL
+};
+
+/* line prefixes */
+static const char *final_prefix[] = {
+	"+CME ERROR",
+	"+CMS ERROR",
+	">",
+	NULL
+};
+
+/* call results: a final only for a command that places or takes a call */
+static const char *call_result_prefix[] = {
+	"NO CARRIER",
+	"NO ANSWER",
+	"NO DIALTONE",
+	"BUSY",
+	"CONNECT",
+	NULL
+};
+
+/* vmodem_at_command_name() of those commands */
+static const char *call_cmd_exact[] = {
+	"D",
+	"A",
+	"O",
+	"+CGDATA",
+	NULL
+};
+
+static const char *urgent_prefix[] = {
+	"RING",
+	"+CRING",
+	"+CLIP",
+	"+CCWA",
+	"NO CARRIER",
+	"+CMT:",
+	"+CMTI:",
+	"+CDS:",
+	"+CBM:",
+	"+CUSD:",
+	"+CSSU:",
+	NULL
+};
+
+static gboolean __match_exact(const char *line, unsigned int len, const char **list)
+{
+	int i;
+
+	for (i = 0; list[i]; i++) {
+		if (len == strlen(list[i]) && memcmp(line, list[i], len) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean __match_prefix(const char *line, unsigned int len, const char **list)
+{
+	int i;
+	size_t plen;
+
+	for (i = 0; list[i]; i++) {
+		plen = strlen(list[i]);
+		if (len >= plen && memcmp(line, list[i], plen) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+gboolean vmodem_at_is_final_result(const char *line, unsigned int len)
+{
+	return __match_exact(line, len, final_exact) || __match_prefix(line, len, final_prefix);
+}
+
+gboolean vmodem_at_is_call_result(const char *line, unsigned int len)
+{
+	return __match_prefix(line, len, call_result_prefix);
+}
+
+/*
+ * NO CARRIER also arrives unsolicited when a call ends; it must not
+ * complete an unrelated command that happens to be in flight.
+ */
+gboolean vmodem_at_is_final_for(const char *cmd, const char *line, unsigned int len)
+{
+	if (vmodem_at_is_final_result(line, len))
+		return TRUE;
+
+	return cmd && __match_exact(cmd, strlen(cmd), call_cmd_exact)
+		&& vmodem_at_is_call_result(line, len);
+}
+
+gboolean vmodem_at_is_urgent_urc(const char *line, unsigned int len)
+{
+	return __match_prefix(line, len, urgent_prefix);
+}
+
+gboolean vmodem_at_is_unsolicited(const char *cmd, const char *line, unsigned int len)
+{
+	const char *colon;
+	unsigned int n;
+
+	if (len == 0)
+		return FALSE;
+
+	if (!cmd)
+		return TRUE;
+
+	/* unprefixed lines (a PDU, an IMEI) are taken as part of the answer */
+	if (!strchr("+%$^*&", line[0]))
+		return FALSE;
+
+	colon = memchr(line, ':', len);
+	n = colon ? (unsigned int)(colon - line) : len;
+
+	return !(strlen(cmd) == n && g_ascii_strncasecmp(line, cmd, n) == 0);
+}
+
+gboolean vmodem_at_command_name(const char *data, unsigned int len, char *name, unsigned int size)
+{
+	unsigned int i = 2;
+	unsigned int n = 0;
+
+	if (!data || !name || size < 3 || len < 2 || g_ascii_strncasecmp(data, "AT", 2) != 0)
+		return FALSE;
+
+	if (i < len && data[i] != '\0' && strchr("+%$^*&", data[i])) {
+		name[n++] = data[i++];
+		while (i < len && g_ascii_isalnum(data[i]) && n < size - 1)
+			name[n++] = g_ascii_toupper(data[i++]);
+	}
+	else if (i < len && g_ascii_isalpha(data[i])) {
+		name[n++] = g_ascii_toupper(data[i]);
+	}
+
+	if (n == 0) {
+		name[n++] = 'A';
+		name[n++] = 'T';
+	}
+
+	name[n] = '\0';
+
+	return TRUE;
+}
+
+gboolean vmodem_at_scan(const char *data, unsigned int len, VmodemAtLineFunc match)
+{
+	unsigned int start = 0;
+	unsigned int i;
+
+	if (!data || !match)
+		return FALSE;
+
+	for (i = 0; i <= len; i++) {
+		if (i < len && data[i] != '\r' && data[i] != '\n')
+			continue;
+
+		if (i > start && match(data + start, i - start))
+			return TRUE;
+
+		start = i + 1;
+	}
+
+	return FALSE;
+}
@@ -0,0 +1,442 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_at.h"
+#include "vmodem_cache.h"
+#include "vmodem_pipeline.h"
+#include "vmodem_trace.h"
+
+struct cache_rule {
+	const char *query;		/* the whole command, case-insensitive */
+	const char *name;		/* vmodem_at_command_name() of its set forms */
+	const char *resp;		/* information response prefix */
+	const char *key;		/* [cache] TTL key */
+	guint ttl_ms;
+	const char *urc[4];		/* other unsolicited lines that make it stale */
+};
+
+struct cache_entry {
+	gboolean valid;
+	gint64 expires;			/* monotonic */
+	GString *resp;
+
+	gboolean filling;		/* the query is in flight, fill collects its answer */
+	gboolean truncated;
+	GString *fill;
+	guint waiters;			/* collapsed duplicates */
+};
+
+struct vmodem_cache {
+	gboolean enabled;
+	guint ttl_ms[VMODEM_CACHE_RULE_MAX];
+	struct cache_entry entry[VMODEM_CACHE_RULE_MAX];
+
+	VmodemCacheEmit emit;
+	void *user_data;
+	GQueue pending;
+	guint idle_id;
+
+	struct vmodem_cache_stats stats;
+};
+
+static const struct cache_rule rules[VMODEM_CACHE_RULE_MAX] = {
+	{ "AT+CSQ", "+CSQ", "+CSQ:", "csq_ms", 2000, { "+CIEV:", NULL } },
+	{ "AT+COPS?", "+COPS", "+COPS:", "cops_ms", 10000, { "+CREG:", "+CGREG:", "+CEREG:", NULL } },
+	{ "AT+CREG?", "+CREG", "+CREG:", "creg_ms", 10000, { NULL } },
+	{ "AT+CGREG?", "+CGREG", "+CGREG:", "cgreg_ms", 10000, { "+CGEV:", NULL } },
+	{ "AT+CBC", "+CBC", "+CBC:", "cbc_ms", 30000, { NULL } },
+	{ "AT+CCLK?", "+CCLK", "+CCLK:", "cclk_ms", 1000, { "+CTZV:", "+CTZE:", "+CTZDST:", NULL } },
+};
+
+static gboolean __has_prefix(const char *line, unsigned int len, const char *prefix)
+{
+	size_t plen = strlen(prefix);
+
+	return len >= plen && memcmp(line, prefix, plen) == 0;
+}
+
+static int __find_rule(const char *data, unsigned int len)
+{
+	int i;
+
+	while (len > 0 && (data[len - 1] == '\r' || data[len - 1] == '\n' || data[len - 1] == ' '))
+		len--;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		if (len == strlen(rules[i].query) && g_ascii_strncasecmp(data, rules[i].query, len) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static void __invalidate(struct vmodem_cache *c, int i)
+{
+	if (!c->entry[i].valid)
+		return;
+
+	c->entry[i].valid = FALSE;
+	c->stats.invalidated++;
+}
+
+/* set commands: AT+COPS=1,... makes +COPS? stale, +CFUN everything */
+static void __invalidate_by_command(struct vmodem_cache *c, const char *data, unsigned int len)
+{
+	char name[VMODEM_PIPELINE_CMD_MAX];
+	int i;
+
+	if (!vmodem_at_command_name(data, len, name, sizeof(name)))
+		return;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		if (strcmp(name, "+CFUN") == 0 || strcmp(name, rules[i].name) == 0)
+			__invalidate(c, i);
+	}
+}
+
+static void __invalidate_by_urc(struct vmodem_cache *c, struct cache_entry *owner,
+		const char *line, unsigned int len)
+{
+	int i;
+	int k;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		/* the answer being collected is not a URC */
+		if (&c->entry[i] == owner)
+			continue;
+
+		if (__has_prefix(line, len, rules[i].resp)) {
+			__invalidate(c, i);
+			continue;
+		}
+
+		for (k = 0; rules[i].urc[k]; k++) {
+			if (__has_prefix(line, len, rules[i].urc[k])) {
+				__invalidate(c, i);
+				break;
+			}
+		}
+	}
+}
+
+static gboolean on_emit(gpointer data)
+{
+	struct vmodem_cache *c = data;
+	GString *s;
+
+	c->idle_id = 0;
+
+	while ((s = g_queue_pop_head(&c->pending)) != NULL) {
+		c->emit(s->str, s->len, c->user_data);
+		g_string_free(s, TRUE);
+	}
+
+	return FALSE;
+}
+
+/* never synchronously: tcore expects the answer after hal_send returns */
+static void __queue_emit(struct vmodem_cache *c, GString *resp)
+{
+	g_queue_push_tail(&c->pending, g_string_new_len(resp->str, resp->len));
+
+	if (!c->idle_id)
+		c->idle_id = g_idle_add(on_emit, c);
+}
+
+static struct cache_entry *__entry_of(struct vmodem_cache *c, void *tag)
+{
+	int i;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		if (tag == &c->entry[i])
+			return &c->entry[i];
+	}
+
+	return NULL;
+}
+
+const char *vmodem_cache_rule_key(int i)
+{
+	if (i < 0 || i >= VMODEM_CACHE_RULE_MAX)
+		return NULL;
+
+	return rules[i].key;
+}
+
+unsigned int vmodem_cache_rule_default_ttl(int i)
+{
+	if (i < 0 || i >= VMODEM_CACHE_RULE_MAX)
+		return 0;
+
+	return rules[i].ttl_ms;
+}
+
+struct vmodem_cache *vmodem_cache_new(VmodemCacheEmit emit, void *user_data)
+{
+	struct vmodem_cache *c;
+	int i;
+
+	if (!emit)
+		return NULL;
+
+	c = calloc(sizeof(struct vmodem_cache), 1);
+	if (!c)
+		return NULL;
+
+	c->emit = emit;
+	c->user_data = user_data;
+	g_queue_init(&c->pending);
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		c->ttl_ms[i] = rules[i].ttl_ms;
+		c->entry[i].resp = g_string_sized_new(64);
+		c->entry[i].fill = g_string_sized_new(64);
+	}
+
+	return c;
+}
+
+void vmodem_cache_free(struct vmodem_cache *c)
+{
+	GString *s;
+	int i;
+
+	if (!c)
+		return;
+
+	if (c->idle_id)
+		g_source_remove(c->idle_id);
+
+	while ((s = g_queue_pop_head(&c->pending)) != NULL)
+		g_string_free(s, TRUE);
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		g_string_free(c->entry[i].resp, TRUE);
+		g_string_free(c->entry[i].fill, TRUE);
+	}
+
+	free(c);
+}
+
+void vmodem_cache_set_enabled(struct vmodem_cache *c, gboolean enabled)
+{
+	int i;
+
+	if (!c || c->enabled == enabled)
+		return;
+
+	c->enabled = enabled;
+
+	/* answers still in flight finish filling, they just are not kept */
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++)
+		c->entry[i].valid = FALSE;
+
+	dbg("response cache %s", enabled ? "on" : "off");
+}
+
+/*
+ * A TTL of 0 disables caching that query.
+ */
+void vmodem_cache_set_ttl(struct vmodem_cache *c, const unsigned int ttl_ms[VMODEM_CACHE_RULE_MAX])
+{
+	int i;
+
+	if (!c || !ttl_ms)
+		return;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		c->ttl_ms[i] = ttl_ms[i];
+		if (ttl_ms[i] == 0)
+			c->entry[i].valid = FALSE;
+	}
+}
+
+enum vmodem_cache_result vmodem_cache_lookup(struct vmodem_cache *c, const char *data,
+		unsigned int len, gboolean can_serve, void *tail)
+{
+	struct cache_entry *e;
+	int i;
+
+	if (!c || !c->enabled || !data)
+		return VMODEM_CACHE_MISS;
+
+	i = __find_rule(data, len);
+	if (i < 0) {
+		__invalidate_by_command(c, data, len);
+		return VMODEM_CACHE_MISS;
+	}
+
+	if (c->ttl_ms[i] == 0)
+		return VMODEM_CACHE_MISS;
+
+	c->stats.lookups++;
+	e = &c->entry[i];
+
+	if (e->valid && g_get_monotonic_time() >= e->expires)
+		e->valid = FALSE;
+
+	if (e->valid && can_serve) {
+		__queue_emit(c, e->resp);
+		c->stats.hits++;
+		VMODEM_PROBE1(cache_hit, i);
+		return VMODEM_CACHE_HIT;
+	}
+
+	if (e->filling && tail == e) {
+		e->waiters++;
+		c->stats.collapsed++;
+		VMODEM_PROBE1(cache_collapse, i);
+		return VMODEM_CACHE_COLLAPSED;
+	}
+
+	return VMODEM_CACHE_MISS;
+}
+
+void *vmodem_cache_sent(struct vmodem_cache *c, const char *data, unsigned int len)
+{
+	struct cache_entry *e;
+	int i;
+
+	if (!c || !c->enabled || !data)
+		return NULL;
+
+	i = __find_rule(data, len);
+	if (i < 0 || c->ttl_ms[i] == 0)
+		return NULL;
+
+	e = &c->entry[i];
+
+	/* a second copy in flight is answered by the modem, not collected */
+	if (e->filling)
+		return NULL;
+
+	e->filling = TRUE;
+	e->truncated = FALSE;
+	g_string_truncate(e->fill, 0);
+
+	return e;
+}
+
+static void __finish(struct vmodem_cache *c, struct cache_entry *e,
+		const char *line, unsigned int len)
+{
+	int i = e - c->entry;
+	GString *answer;
+
+	g_string_append(e->fill, "\r\n");
+	g_string_append_len(e->fill, line, len);
+	g_string_append(e->fill, "\r\n");
+
+	answer = e->fill;
+
+	if (c->enabled && !e->truncated && len == 2 && memcmp(line, "OK", 2) == 0) {
+		e->fill = e->resp;
+		e->resp = answer;
+		e->valid = TRUE;
+		e->expires = g_get_monotonic_time() + (gint64)c->ttl_ms[i] * 1000;
+		c->stats.stored++;
+	}
+
+	for (; e->waiters > 0; e->waiters--)
+		__queue_emit(c, answer);
+
+	e->filling = FALSE;
+}
+
+void vmodem_cache_line(struct vmodem_cache *c, void *tag, const char *line, unsigned int len,
+		gboolean final)
+{
+	struct cache_entry *e;
+
+	if (!c || !line || len == 0)
+		return;
+
+	e = tag ? __entry_of(c, tag) : NULL;
+
+	if (!final && line[0] == '+')
+		__invalidate_by_urc(c, e, line, len);
+
+	if (!e || !e->filling)
+		return;
+
+	if (final) {
+		__finish(c, e, line, len);
+		return;
+	}
+
+	/* echo and unrelated URCs in between are not part of the answer */
+	if (!__has_prefix(line, len, rules[e - c->entry].resp))
+		return;
+
+	if (len >= VMODEM_PIPELINE_LINE_MAX)
+		e->truncated = TRUE;
+
+	g_string_append(e->fill, "\r\n");
+	g_string_append_len(e->fill, line, len);
+	g_string_append(e->fill, "\r\n");
+}
+
+/*
+ * Power change: nothing cached is true any more and nothing in flight
+ * will be answered.
+ */
+void vmodem_cache_reset(struct vmodem_cache *c)
+{
+	int i;
+
+	if (!c)
+		return;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++) {
+		c->entry[i].valid = FALSE;
+		c->entry[i].filling = FALSE;
+		c->entry[i].waiters = 0;
+	}
+}
+
+void vmodem_cache_get_stats(struct vmodem_cache *c, struct vmodem_cache_stats *stats)
+{
+	if (c && stats)
+		memcpy(stats, &c->stats, sizeof(struct vmodem_cache_stats));
+}
+
+void vmodem_cache_dump(struct vmodem_cache *c)
+{
+	struct vmodem_cache_stats *st;
+
+	if (!c || c->stats.lookups == 0)
+		return;
+
+	st = &c->stats;
+
+	msg("cache: %llu lookups, %llu hits, %llu collapsed (%llu%% answered locally, %llu round trips saved), %llu stored, %llu invalidated",
+			st->lookups, st->hits, st->collapsed,
+			(st->hits + st->collapsed) * 100 / st->lookups,
+			st->hits + st->collapsed, st->stored, st->invalidated);
+}
@@ -0,0 +1,258 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_at.h"
+#include "vmodem_coalesce.h"
+#include "vmodem_trace.h"
+
+struct vmodem_coalesce {
+	guint window_ms;
+	guint timer_id;
+	gboolean held;		/* fd unwatched until the window ends */
+	gboolean draining;	/* pushes ride on the window's wakeup */
+
+	char *buf;
+	unsigned int len;
+	unsigned int size;
+
+	VmodemCoalesceDeliver deliver;
+	VmodemCoalesceHold hold;
+	void *user_data;
+
+	struct vmodem_coalesce_stats stats;
+};
+
+static gboolean __is_flush_line(const char *line, unsigned int len)
+{
+	return vmodem_at_is_urgent_urc(line, len) || vmodem_at_is_final_result(line, len)
+		|| vmodem_at_is_call_result(line, len);
+}
+
+/* the batch ends with a complete line nobody is still answering into */
+static gboolean __ends_unsolicited(const char *buf, unsigned int len, const char *awaiting)
+{
+	unsigned int end = len;
+	unsigned int start;
+
+	if (len == 0 || (buf[len - 1] != '\r' && buf[len - 1] != '\n'))
+		return FALSE;
+
+	while (end > 0 && (buf[end - 1] == '\r' || buf[end - 1] == '\n'))
+		end--;
+
+	start = end;
+	while (start > 0 && buf[start - 1] != '\r' && buf[start - 1] != '\n')
+		start--;
+
+	return vmodem_at_is_unsolicited(awaiting, buf + start, end - start);
+}
+
+static void __deliver(struct vmodem_coalesce *c, const char *data, unsigned int len)
+{
+	c->stats.deliveries++;
+	c->deliver(data, len, c->user_data);
+}
+
+static void __release(struct vmodem_coalesce *c, gboolean drain)
+{
+	if (!c->held)
+		return;
+
+	c->held = FALSE;
+	if (c->hold)
+		c->hold(FALSE, drain, c->user_data);
+}
+
+static gboolean on_coalesce_timeout(gpointer data)
+{
+	struct vmodem_coalesce *c = data;
+
+	c->timer_id = 0;
+	c->stats.wakeups++;
+
+	/* what arrived during the window joins the batch */
+	c->draining = TRUE;
+	__release(c, TRUE);
+	c->draining = FALSE;
+
+	vmodem_coalesce_flush(c);
+
+	return FALSE;
+}
+
+struct vmodem_coalesce *vmodem_coalesce_new(guint window_ms, unsigned int size,
+		VmodemCoalesceDeliver deliver, VmodemCoalesceHold hold, void *user_data)
+{
+	struct vmodem_coalesce *c;
+
+	if (!deliver || size == 0)
+		return NULL;
+
+	c = calloc(sizeof(struct vmodem_coalesce), 1);
+	if (!c)
+		return NULL;
+
+	/* one extra byte keeps every delivered batch NUL terminated */
+	c->buf = malloc(size + 1);
+	if (!c->buf) {
+		free(c);
+		return NULL;
+	}
+
+	c->size = size;
+	c->window_ms = window_ms;
+	c->deliver = deliver;
+	c->hold = hold;
+	c->user_data = user_data;
+	c->stats.since = g_get_monotonic_time();
+
+	return c;
+}
+
+void vmodem_coalesce_free(struct vmodem_coalesce *c)
+{
+	if (!c)
+		return;
+
+	/* the caller is tearing its watches down */
+	c->hold = NULL;
+	vmodem_coalesce_flush(c);
+
+	free(c->buf);
+	free(c);
+}
+
+void vmodem_coalesce_set_window(struct vmodem_coalesce *c, guint window_ms)
+{
+	if (!c)
+		return;
+
+	if (window_ms == 0)
+		vmodem_coalesce_flush(c);
+
+	c->window_ms = window_ms;
+}
+
+void vmodem_coalesce_push(struct vmodem_coalesce *c, const char *data, unsigned int len,
+		const char *awaiting)
+{
+	if (!c)
+		return;
+
+	if (!c->draining)
+		c->stats.wakeups++;
+	c->stats.reads++;
+	c->stats.bytes += len;
+
+	if (c->window_ms == 0 || len > c->size) {
+		vmodem_coalesce_flush(c);
+		__deliver(c, data, len);
+		return;
+	}
+
+	if (c->len + len > c->size)
+		vmodem_coalesce_flush(c);
+
+	memcpy(c->buf + c->len, data, len);
+	c->len += len;
+
+	/* whole batch: a final result may have been split across reads */
+	if (vmodem_at_scan(c->buf, c->len, __is_flush_line)
+			|| __ends_unsolicited(c->buf, c->len, awaiting)) {
+		vmodem_coalesce_flush(c);
+		return;
+	}
+
+	/* the window end reads the rest, no wakeup per chunk until then */
+	if (!c->timer_id && !c->draining) {
+		c->timer_id = g_timeout_add(c->window_ms, on_coalesce_timeout, c);
+		if (c->hold) {
+			c->held = TRUE;
+			c->hold(TRUE, FALSE, c->user_data);
+		}
+	}
+}
+
+void vmodem_coalesce_flush(struct vmodem_coalesce *c)
+{
+	if (!c)
+		return;
+
+	if (c->timer_id) {
+		g_source_remove(c->timer_id);
+		c->timer_id = 0;
+	}
+
+	/* no read from here: flush may run inside the RX callback */
+	__release(c, FALSE);
+
+	if (c->len == 0)
+		return;
+
+	VMODEM_PROBE1(coalesce_flush, c->len);
+
+	c->buf[c->len] = '\0';
+	__deliver(c, c->buf, c->len);
+	c->len = 0;
+}
+
+void vmodem_coalesce_account_cpu(struct vmodem_coalesce *c, unsigned long long ns)
+{
+	if (c)
+		c->stats.cpu_ns += ns;
+}
+
+void vmodem_coalesce_get_stats(struct vmodem_coalesce *c, struct vmodem_coalesce_stats *stats)
+{
+	if (c && stats)
+		*stats = c->stats;
+}
+
+void vmodem_coalesce_dump(struct vmodem_coalesce *c)
+{
+	double minutes;
+	double kbytes;
+
+	if (!c)
+		return;
+
+	minutes = (g_get_monotonic_time() - c->stats.since) / 60000000.0;
+	kbytes = c->stats.bytes / 1024.0;
+
+	msg("rx: window=%u ms, %llu wakeups, %llu reads, %llu deliveries, %llu bytes",
+			c->window_ms, c->stats.wakeups, c->stats.reads, c->stats.deliveries,
+			c->stats.bytes);
+
+	if (minutes > 0)
+		msg("rx: %.1f wakeups/min, %.1f deliveries/min",
+				c->stats.wakeups / minutes, c->stats.deliveries / minutes);
+
+	if (c->stats.cpu_ns && kbytes > 0)
+		msg("rx: %.1f us CPU per KB", c->stats.cpu_ns / 1000.0 / kbytes);
+}
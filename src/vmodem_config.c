@@ -0,0 +1,236 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vdpram_dump.h"
+#include "vmodem_cache.h"
+#include "vmodem_config.h"
+#include "vmodem_state.h"
+
+#define VMODEM_READ_BUF_MIN		64
+#define VMODEM_READ_BUF_MAX		65536
+
+static void __get_string(GKeyFile *kf, const char *group, const char *key, char *dst, size_t len)
+{
+	gchar *val;
+
+	val = g_key_file_get_string(kf, group, key, NULL);
+	if (!val)
+		return;
+
+	if (val[0] != '\0')
+		snprintf(dst, len, "%s", val);
+
+	g_free(val);
+}
+
+static void __get_int(GKeyFile *kf, const char *group, const char *key, int *dst)
+{
+	GError *error = NULL;
+	int val;
+
+	val = g_key_file_get_integer(kf, group, key, &error);
+	if (error) {
+		g_error_free(error);
+		return;
+	}
+
+	*dst = val;
+}
+
+static void __get_uint(GKeyFile *kf, const char *group, const char *key, unsigned int *dst)
+{
+	int val = -1;
+
+	__get_int(kf, group, key, &val);
+	if (val >= 0)
+		*dst = val;
+}
+
+static void __get_bool(GKeyFile *kf, const char *group, const char *key, int *dst)
+{
+	GError *error = NULL;
+	gboolean val;
+
+	val = g_key_file_get_boolean(kf, group, key, &error);
+	if (error) {
+		g_error_free(error);
+		return;
+	}
+
+	*dst = val;
+}
+
+/*
+ * Compile-time defaults, the same values the plugin used before it
+ * had a configuration file.
+ */
+void vmodem_config_init(struct vmodem_config *cfg)
+{
+	int i;
+
+	memset(cfg, 0, sizeof(struct vmodem_config));
+
+	snprintf(cfg->device_path, sizeof(cfg->device_path), "/dev/dpram/0");
+	cfg->read_buf_len = 512;
+	snprintf(cfg->backend, sizeof(cfg->backend), "tty");
+	snprintf(cfg->shm_path, sizeof(cfg->shm_path), "/dev/dpram/mbox0");
+	snprintf(cfg->shm_doorbell_rx, sizeof(cfg->shm_doorbell_rx), "/dev/dpram/bell0_rx");
+	snprintf(cfg->shm_doorbell_tx, sizeof(cfg->shm_doorbell_tx), "/dev/dpram/bell0_tx");
+
+	snprintf(cfg->baudrate, sizeof(cfg->baudrate), "115200");
+	snprintf(cfg->parity, sizeof(cfg->parity), "N");
+	snprintf(cfg->bits, sizeof(cfg->bits), "8");
+	snprintf(cfg->stop, sizeof(cfg->stop), "1");
+#ifdef VMODEM_HW_FLOW_CONTROL
+	cfg->hw_flow = 1;
+#endif
+
+	cfg->retry_count = 10;
+	cfg->retry_sleep_us = 50;
+	cfg->retry_backoff = 1;
+
+#ifdef VMODEM_HOT_DEBUG
+	cfg->dump_level = VDPRAM_DUMP_HEX;
+#else
+	cfg->dump_level = VDPRAM_DUMP_NONE;
+#endif
+	snprintf(cfg->capture_path, sizeof(cfg->capture_path), "/tmp/vmodem.cap");
+
+	/* off unless asked for: a probe aborts whatever the modem is executing */
+	cfg->watchdog_deadline_ms = 0;
+	cfg->watchdog_recover_ms = 2000;
+
+	cfg->tx_aging_ms = 500;
+	cfg->tx_window_timeout_ms = 30000;
+
+	cfg->coalesce_ms = 20;
+
+	snprintf(cfg->state_path, sizeof(cfg->state_path), "%s", VMODEM_STATE_PATH);
+	cfg->warm_restart = 1;
+
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++)
+		cfg->cache_ttl_ms[i] = vmodem_cache_rule_default_ttl(i);
+}
+
+const char *vmodem_config_path(void)
+{
+#ifdef VMODEM_OFF_TARGET
+	const char *path = getenv("VMODEM_CONFIG");
+
+	if (path && path[0] != '\0')
+		return path;
+#endif
+
+	return VMODEM_CONFIG_PATH;
+}
+
+/*
+ * Overlay the keys found in path on cfg. Returns FALSE, leaving cfg
+ * untouched, when the file cannot be read.
+ */
+gboolean vmodem_config_load(struct vmodem_config *cfg, const char *path)
+{
+	GKeyFile *kf;
+	GError *error = NULL;
+	int i;
+
+	if (!cfg || !path)
+		return FALSE;
+
+	kf = g_key_file_new();
+
+	if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, &error)) {
+		dbg("no config %s (%s), using defaults", path, error ? error->message : "");
+		if (error)
+			g_error_free(error);
+		g_key_file_free(kf);
+		return FALSE;
+	}
+
+	__get_string(kf, "device", "path", cfg->device_path, sizeof(cfg->device_path));
+	__get_uint(kf, "device", "read_buffer", &cfg->read_buf_len);
+	__get_string(kf, "device", "backend", cfg->backend, sizeof(cfg->backend));
+	__get_string(kf, "device", "shm_path", cfg->shm_path, sizeof(cfg->shm_path));
+	__get_string(kf, "device", "shm_doorbell_rx", cfg->shm_doorbell_rx, sizeof(cfg->shm_doorbell_rx));
+	__get_string(kf, "device", "shm_doorbell_tx", cfg->shm_doorbell_tx, sizeof(cfg->shm_doorbell_tx));
+	__get_bool(kf, "device", "emulated", &cfg->emulated);
+
+	__get_string(kf, "tty", "baudrate", cfg->baudrate, sizeof(cfg->baudrate));
+	__get_string(kf, "tty", "parity", cfg->parity, sizeof(cfg->parity));
+	__get_string(kf, "tty", "bits", cfg->bits, sizeof(cfg->bits));
+	__get_string(kf, "tty", "stop", cfg->stop, sizeof(cfg->stop));
+	__get_bool(kf, "tty", "hw_flow", &cfg->hw_flow);
+	__get_bool(kf, "tty", "sw_flow", &cfg->sw_flow);
+
+	__get_int(kf, "retry", "count", &cfg->retry_count);
+	__get_int(kf, "retry", "sleep_us", &cfg->retry_sleep_us);
+	__get_int(kf, "retry", "backoff", &cfg->retry_backoff);
+
+	__get_int(kf, "debug", "dump_level", &cfg->dump_level);
+	__get_bool(kf, "debug", "capture", &cfg->capture);
+	__get_string(kf, "debug", "capture_path", cfg->capture_path, sizeof(cfg->capture_path));
+	__get_string(kf, "debug", "fault", cfg->fault_spec, sizeof(cfg->fault_spec));
+	__get_bool(kf, "debug", "profile", &cfg->profile);
+
+	__get_uint(kf, "watchdog", "deadline_ms", &cfg->watchdog_deadline_ms);
+	__get_uint(kf, "watchdog", "recover_ms", &cfg->watchdog_recover_ms);
+
+	__get_uint(kf, "tx", "aging_ms", &cfg->tx_aging_ms);
+	__get_uint(kf, "tx", "window", &cfg->tx_window);
+	__get_uint(kf, "tx", "window_timeout_ms", &cfg->tx_window_timeout_ms);
+
+	__get_bool(kf, "power", "save", &cfg->power_save);
+	__get_uint(kf, "power", "coalesce_ms", &cfg->coalesce_ms);
+	__get_bool(kf, "power", "stats", &cfg->power_stats);
+
+	__get_string(kf, "state", "path", cfg->state_path, sizeof(cfg->state_path));
+	__get_bool(kf, "state", "warm_restart", &cfg->warm_restart);
+
+	__get_bool(kf, "cache", "enable", &cfg->cache_enable);
+	for (i = 0; i < VMODEM_CACHE_RULE_MAX; i++)
+		__get_uint(kf, "cache", vmodem_cache_rule_key(i), &cfg->cache_ttl_ms[i]);
+
+	__get_bool(kf, "control", "sighup", &cfg->sighup);
+	__get_bool(kf, "control", "sigusr1", &cfg->sigusr1);
+
+	g_key_file_free(kf);
+
+	if (cfg->read_buf_len < VMODEM_READ_BUF_MIN)
+		cfg->read_buf_len = VMODEM_READ_BUF_MIN;
+	else if (cfg->read_buf_len > VMODEM_READ_BUF_MAX)
+		cfg->read_buf_len = VMODEM_READ_BUF_MAX;
+
+	dbg("config %s: backend=%s dev=%s buf=%u tty=%s%s%s%s hwf=%d retry=%d/%dus/x%d dump=%d capture=%d power_save=%d/%ums",
+			path, cfg->backend, cfg->device_path, cfg->read_buf_len,
+			cfg->baudrate, cfg->bits, cfg->parity, cfg->stop, cfg->hw_flow,
+			cfg->retry_count, cfg->retry_sleep_us, cfg->retry_backoff,
+			cfg->dump_level, cfg->capture, cfg->power_save, cfg->coalesce_ms);
+
+	return TRUE;
+}
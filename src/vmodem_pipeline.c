@@ -0,0 +1,414 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_at.h"
+#include "vmodem_pipeline.h"
+#include "vmodem_trace.h"
+
+#define VMODEM_PIPELINE_SLOW_MS		180000
+
+struct inflight {
+	char cmd[VMODEM_PIPELINE_CMD_MAX];
+	gboolean slow;
+	void *tag;
+	gint64 sent_at;		/* monotonic */
+	gint64 deadline;	/* monotonic */
+};
+
+struct vmodem_pipeline {
+	guint window;
+	guint timeout_ms;
+	guint timer_id;
+
+	VmodemPipelineKick kick;
+	VmodemPipelineLine line_hook;
+	void *user_data;
+
+	GQueue inflight;
+
+	/* a final result can be split across reads */
+	char line[VMODEM_PIPELINE_LINE_MAX];
+	unsigned int line_len;
+
+	struct vmodem_pipeline_stats stats;
+};
+
+/* network operations the modem may legitimately sit on for minutes */
+static const char *slow_prefix[] = {
+	"AT+COPS", "AT+CGATT", "AT+CGACT", "AT+CMGS", "AT+CMSS", "ATD", "ATA", NULL
+};
+
+static gboolean on_pipeline_timeout(gpointer data);
+
+static gboolean __is_slow(const char *data, unsigned int len)
+{
+	int i;
+	size_t plen;
+
+	for (i = 0; slow_prefix[i]; i++) {
+		plen = strlen(slow_prefix[i]);
+		if (len >= plen && g_ascii_strncasecmp(data, slow_prefix[i], plen) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* base_ms for an ordinary command */
+static guint __timeout_for(gboolean slow, guint base_ms)
+{
+	return slow ? MAX(base_ms, VMODEM_PIPELINE_SLOW_MS) : base_ms;
+}
+
+static void __expire(struct vmodem_pipeline *p)
+{
+	struct inflight *f;
+	gint64 now = g_get_monotonic_time();
+
+	while ((f = g_queue_peek_head(&p->inflight)) != NULL && f->deadline <= now) {
+		err("no final result for %s after %lld ms, dropping it from the window",
+				f->cmd, (long long)(now - f->sent_at) / 1000);
+		g_queue_pop_head(&p->inflight);
+
+		/* whoever waits on the tag gets an answer instead of hanging on */
+		if (p->line_hook)
+			p->line_hook(f->tag, "ERROR", 5, TRUE, p->user_data);
+
+		free(f);
+		p->stats.timeouts++;
+	}
+}
+
+static void __arm_timer(struct vmodem_pipeline *p)
+{
+	struct inflight *f;
+	gint64 left;
+
+	if (p->timer_id)
+		return;
+
+	f = g_queue_peek_head(&p->inflight);
+	if (!f)
+		return;
+
+	left = (f->deadline - g_get_monotonic_time()) / 1000;
+	p->timer_id = g_timeout_add(left > 0 ? left + 1 : 1, on_pipeline_timeout, p);
+}
+
+static void __disarm_timer(struct vmodem_pipeline *p)
+{
+	if (p->timer_id) {
+		g_source_remove(p->timer_id);
+		p->timer_id = 0;
+	}
+}
+
+static gboolean on_pipeline_timeout(gpointer data)
+{
+	struct vmodem_pipeline *p = data;
+
+	p->timer_id = 0;
+	__expire(p);
+
+	if (g_queue_get_length(&p->inflight) < p->window) {
+		if (p->kick)
+			p->kick(p->user_data);
+	}
+	else {
+		__arm_timer(p);
+	}
+
+	return FALSE;
+}
+
+static gboolean __complete(struct vmodem_pipeline *p)
+{
+	struct inflight *f;
+	unsigned long long rtt;
+
+	f = g_queue_pop_head(&p->inflight);
+	if (!f) {
+		p->stats.orphans++;
+		if (p->line_hook)
+			p->line_hook(NULL, p->line, p->line_len, TRUE, p->user_data);
+		return FALSE;
+	}
+
+	if (p->line_hook)
+		p->line_hook(f->tag, p->line, p->line_len, TRUE, p->user_data);
+
+	rtt = g_get_monotonic_time() - f->sent_at;
+
+	p->stats.completed++;
+	p->stats.rtt_total_us += rtt;
+	if (rtt > p->stats.rtt_max_us)
+		p->stats.rtt_max_us = rtt;
+
+	VMODEM_PROBE2(pipeline_done, g_queue_get_length(&p->inflight), rtt);
+
+	free(f);
+	return TRUE;
+}
+
+static void __drop_all(struct vmodem_pipeline *p)
+{
+	struct inflight *f;
+
+	while ((f = g_queue_pop_head(&p->inflight)) != NULL)
+		free(f);
+
+	p->line_len = 0;
+	__disarm_timer(p);
+}
+
+struct vmodem_pipeline *vmodem_pipeline_new(guint window, guint timeout_ms,
+		VmodemPipelineKick kick, void *user_data)
+{
+	struct vmodem_pipeline *p;
+
+	p = calloc(sizeof(struct vmodem_pipeline), 1);
+	if (!p)
+		return NULL;
+
+	p->window = window;
+	p->timeout_ms = timeout_ms;
+	p->kick = kick;
+	p->user_data = user_data;
+	g_queue_init(&p->inflight);
+
+	dbg("pipeline window=%u timeout=%u ms", window, timeout_ms);
+
+	return p;
+}
+
+void vmodem_pipeline_free(struct vmodem_pipeline *p)
+{
+	if (!p)
+		return;
+
+	__drop_all(p);
+	free(p);
+}
+
+void vmodem_pipeline_set_window(struct vmodem_pipeline *p, guint window, guint timeout_ms)
+{
+	if (!p)
+		return;
+
+	p->window = window;
+	p->timeout_ms = timeout_ms;
+
+	if (window == 0)
+		__disarm_timer(p);
+}
+
+void vmodem_pipeline_set_line_hook(struct vmodem_pipeline *p, VmodemPipelineLine hook)
+{
+	if (p)
+		p->line_hook = hook;
+}
+
+/*
+ * TX gate. Urgent commands (emergency dial) may exceed the window.
+ */
+gboolean vmodem_pipeline_may_send(struct vmodem_pipeline *p, gboolean urgent)
+{
+	if (!p || p->window == 0)
+		return TRUE;
+
+	__expire(p);
+
+	if (urgent || g_queue_get_length(&p->inflight) < p->window)
+		return TRUE;
+
+	__arm_timer(p);
+
+	return FALSE;
+}
+
+/*
+ * A complete AT command left the HAL; SMS bodies and other raw data
+ * are not tracked. tag comes back through the line hook.
+ */
+void vmodem_pipeline_sent(struct vmodem_pipeline *p, const char *data, unsigned int len, void *tag)
+{
+	struct inflight *f;
+	guint n;
+
+	if (!p)
+		return;
+
+	/* without a window nothing else ages the queue */
+	__expire(p);
+
+	f = calloc(sizeof(struct inflight), 1);
+	if (!f)
+		return;
+
+	if (!vmodem_at_command_name(data, len, f->cmd, sizeof(f->cmd))) {
+		free(f);
+		return;
+	}
+
+	f->slow = __is_slow(data, len);
+	f->tag = tag;
+	f->sent_at = g_get_monotonic_time();
+	f->deadline = f->sent_at + (gint64)__timeout_for(f->slow, p->timeout_ms) * 1000;
+
+	g_queue_push_tail(&p->inflight, f);
+
+	n = g_queue_get_length(&p->inflight);
+	if (n > p->stats.max_inflight)
+		p->stats.max_inflight = n;
+}
+
+/*
+ * Feed everything read from the modem. Returns the number of commands
+ * completed, i.e. window slots freed. A call result completes the head
+ * only when it is D/A/O/+CGDATA (vmodem_at_is_final_for), so a NO CARRIER
+ * arriving unsolicited while other commands are in flight is passed on
+ * as a line and leaves the matching alone.
+ */
+guint vmodem_pipeline_rx(struct vmodem_pipeline *p, const char *data, unsigned int len)
+{
+	unsigned int i;
+	guint done = 0;
+
+	struct inflight *head;
+
+	if (!p || !data)
+		return 0;
+
+	for (i = 0; i < len; i++) {
+		if (data[i] != '\r' && data[i] != '\n') {
+			if (p->line_len < VMODEM_PIPELINE_LINE_MAX)
+				p->line[p->line_len++] = data[i];
+			continue;
+		}
+
+		if (p->line_len == 0)
+			continue;
+
+		head = g_queue_peek_head(&p->inflight);
+
+		/* the "> " SMS prompt is not an answer, the body is still to come */
+		if (p->line[0] != '>'
+				&& vmodem_at_is_final_for(head ? head->cmd : NULL, p->line, p->line_len)) {
+			if (__complete(p))
+				done++;
+		}
+		else if (p->line_hook) {
+			p->line_hook(head ? head->tag : NULL, p->line, p->line_len, FALSE, p->user_data);
+		}
+
+		p->line_len = 0;
+	}
+
+	if (done && g_queue_is_empty(&p->inflight))
+		__disarm_timer(p);
+
+	return done;
+}
+
+/*
+ * The modem was power-cycled: nothing in flight will be answered.
+ */
+void vmodem_pipeline_reset(struct vmodem_pipeline *p)
+{
+	if (p)
+		__drop_all(p);
+}
+
+guint vmodem_pipeline_inflight(struct vmodem_pipeline *p)
+{
+	return p ? g_queue_get_length(&p->inflight) : 0;
+}
+
+void *vmodem_pipeline_tail_tag(struct vmodem_pipeline *p)
+{
+	struct inflight *f;
+
+	if (!p)
+		return NULL;
+
+	f = g_queue_peek_tail(&p->inflight);
+
+	return f ? f->tag : NULL;
+}
+
+/*
+ * Name of the command the next final result belongs to, NULL if none.
+ */
+const char *vmodem_pipeline_head_cmd(struct vmodem_pipeline *p)
+{
+	struct inflight *f;
+
+	if (!p)
+		return NULL;
+
+	f = g_queue_peek_head(&p->inflight);
+
+	return f ? f->cmd : NULL;
+}
+
+/*
+ * How long the oldest command in flight may take to answer, when an
+ * ordinary command gets base_ms. 0 when nothing is in flight.
+ */
+guint vmodem_pipeline_head_timeout(struct vmodem_pipeline *p, guint base_ms)
+{
+	struct inflight *f;
+
+	if (!p)
+		return 0;
+
+	f = g_queue_peek_head(&p->inflight);
+
+	return f ? __timeout_for(f->slow, base_ms) : 0;
+}
+
+void vmodem_pipeline_get_stats(struct vmodem_pipeline *p, struct vmodem_pipeline_stats *stats)
+{
+	if (p && stats)
+		memcpy(stats, &p->stats, sizeof(struct vmodem_pipeline_stats));
+}
+
+void vmodem_pipeline_dump(struct vmodem_pipeline *p)
+{
+	struct vmodem_pipeline_stats *st;
+
+	if (!p)
+		return;
+
+	st = &p->stats;
+
+	msg("pipeline window=%u: %llu completed, rtt avg %llu us, max %llu us, max in flight %u, %llu timeouts, %llu orphans",
+			p->window, st->completed, st->completed ? st->rtt_total_us / st->completed : 0,
+			st->rtt_max_us, st->max_inflight, st->timeouts, st->orphans);
+}
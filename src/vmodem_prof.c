@@ -0,0 +1,288 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_pipeline.h"
+#include "vmodem_prof.h"
+
+#define VMODEM_PROF_ROWS		64
+#define VMODEM_PROF_DEPTH		4
+
+enum prof_counter {
+	PROF_CYCLES,
+	PROF_INSTRUCTIONS,
+	PROF_CTXSW,
+	PROF_CPU_NS,		/* CLOCK_THREAD_CPUTIME_ID, always available */
+	PROF_COUNTER_MAX
+};
+
+struct prof_cost {
+	unsigned long long calls;
+	unsigned long long v[PROF_COUNTER_MAX];
+};
+
+struct prof_row {
+	char cmd[VMODEM_PIPELINE_CMD_MAX];
+	struct prof_cost cost[VMODEM_PROF_SITE_MAX];
+};
+
+struct prof_frame {
+	unsigned long long start[PROF_COUNTER_MAX];
+	unsigned long long child[PROF_COUNTER_MAX];
+};
+
+struct vmodem_prof {
+	int group_fd;
+	int fd[PROF_CPU_NS];
+	int nr_events;
+	int slot[PROF_COUNTER_MAX];		/* index in the group read, -1: not counted */
+
+	struct prof_frame stack[VMODEM_PROF_DEPTH];
+	int depth;
+
+	struct prof_row rows[VMODEM_PROF_ROWS];
+	int nr_rows;
+};
+
+static const char *site_name[VMODEM_PROF_SITE_MAX] = {
+	"send", "recv", "emit"
+};
+
+static const struct {
+	__u32 type;
+	__u64 config;
+	const char *name;
+} events[PROF_CPU_NS] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches" },
+};
+
+static int __open_event(int i, int group_fd)
+{
+	struct perf_event_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = events[i].type;
+	attr.config = events[i].config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_hv = 1;
+
+	/* this thread, any CPU */
+	fd = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+	if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+		/* perf_event_paranoid >= 2: user space only */
+		attr.exclude_kernel = 1;
+		fd = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+	}
+
+	return fd;
+}
+
+static void __sample(struct vmodem_prof *p, unsigned long long *v)
+{
+	struct timespec ts;
+	__u64 buf[1 + PROF_CPU_NS];
+	int i;
+
+	memset(v, 0, sizeof(unsigned long long) * PROF_COUNTER_MAX);
+
+	if (p->group_fd >= 0 && read(p->group_fd, buf, sizeof(buf)) > 0) {
+		for (i = 0; i < PROF_CPU_NS; i++) {
+			if (p->slot[i] >= 0 && (__u64)p->slot[i] < buf[0])
+				v[i] = buf[1 + p->slot[i]];
+		}
+	}
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		v[PROF_CPU_NS] = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct prof_row *__row(struct vmodem_prof *p, const char *cmd)
+{
+	int i;
+
+	for (i = 0; i < p->nr_rows; i++) {
+		if (strcmp(p->rows[i].cmd, cmd) == 0)
+			return &p->rows[i];
+	}
+
+	/* table full: the last row takes the rest */
+	if (p->nr_rows == VMODEM_PROF_ROWS)
+		return &p->rows[VMODEM_PROF_ROWS - 1];
+
+	snprintf(p->rows[p->nr_rows].cmd, VMODEM_PIPELINE_CMD_MAX, "%s",
+			p->nr_rows == VMODEM_PROF_ROWS - 1 ? "(other)" : cmd);
+
+	return &p->rows[p->nr_rows++];
+}
+
+struct vmodem_prof *vmodem_prof_new(void)
+{
+	struct vmodem_prof *p;
+	int fd;
+	int i;
+
+	p = calloc(sizeof(struct vmodem_prof), 1);
+	if (!p)
+		return NULL;
+
+	p->group_fd = -1;
+
+	for (i = 0; i < PROF_COUNTER_MAX; i++)
+		p->slot[i] = -1;
+
+	for (i = 0; i < PROF_CPU_NS; i++) {
+		fd = __open_event(i, p->group_fd);
+		if (fd < 0) {
+			dbg("profiler: no %s counter (errno %d)", events[i].name, errno);
+			continue;
+		}
+
+		if (p->group_fd < 0)
+			p->group_fd = fd;
+
+		p->fd[p->nr_events] = fd;
+		p->slot[i] = p->nr_events++;
+	}
+
+	if (p->group_fd < 0)
+		msg("profiler: perf events unavailable, thread CPU time only");
+	else
+		msg("profiler: %d perf counter(s)", p->nr_events);
+
+	return p;
+}
+
+void vmodem_prof_free(struct vmodem_prof *p)
+{
+	int i;
+
+	if (!p)
+		return;
+
+	for (i = 0; i < p->nr_events; i++)
+		close(p->fd[i]);
+
+	free(p);
+}
+
+void vmodem_prof_begin(struct vmodem_prof *p)
+{
+	struct prof_frame *f;
+
+	if (!p)
+		return;
+
+	if (p->depth < VMODEM_PROF_DEPTH) {
+		f = &p->stack[p->depth];
+		memset(f->child, 0, sizeof(f->child));
+		__sample(p, f->start);
+	}
+
+	p->depth++;
+}
+
+void vmodem_prof_end(struct vmodem_prof *p, enum vmodem_prof_site site, const char *cmd)
+{
+	unsigned long long now[PROF_COUNTER_MAX];
+	unsigned long long total;
+	struct prof_frame *f;
+	struct prof_cost *c;
+	int i;
+
+	if (!p || p->depth == 0)
+		return;
+
+	p->depth--;
+	if (p->depth >= VMODEM_PROF_DEPTH)
+		return;
+
+	__sample(p, now);
+
+	f = &p->stack[p->depth];
+	c = &__row(p, cmd ? cmd : "(none)")->cost[site];
+	c->calls++;
+
+	for (i = 0; i < PROF_COUNTER_MAX; i++) {
+		total = now[i] - f->start[i];
+		c->v[i] += total > f->child[i] ? total - f->child[i] : 0;
+
+		if (p->depth > 0)
+			p->stack[p->depth - 1].child[i] += total;
+	}
+}
+
+/* a counter that could not be opened prints as "-" */
+static void __fmt_counter(char *buf, size_t len, int slot, unsigned long long v)
+{
+	if (slot < 0)
+		snprintf(buf, len, "-");
+	else
+		snprintf(buf, len, "%llu", v);
+}
+
+void vmodem_prof_dump(struct vmodem_prof *p)
+{
+	struct prof_cost *c;
+	char cyc[32];
+	char ins[32];
+	char csw[32];
+	int r;
+	int s;
+
+	if (!p)
+		return;
+
+	msg("profiler: per command and site, averages per call");
+
+	for (r = 0; r < p->nr_rows; r++) {
+		for (s = 0; s < VMODEM_PROF_SITE_MAX; s++) {
+			c = &p->rows[r].cost[s];
+			if (c->calls == 0)
+				continue;
+
+			__fmt_counter(cyc, sizeof(cyc), p->slot[PROF_CYCLES],
+					c->v[PROF_CYCLES] / c->calls);
+			__fmt_counter(ins, sizeof(ins), p->slot[PROF_INSTRUCTIONS],
+					c->v[PROF_INSTRUCTIONS] / c->calls);
+			__fmt_counter(csw, sizeof(csw), p->slot[PROF_CTXSW], c->v[PROF_CTXSW]);
+
+			msg("  %-10s %s: %llu calls, %llu ns cpu, %s cycles, %s instructions, %s ctxsw total",
+					p->rows[r].cmd, site_name[s], c->calls,
+					c->v[PROF_CPU_NS] / c->calls, cyc, ins, csw);
+		}
+	}
+}
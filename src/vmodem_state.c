@@ -0,0 +1,168 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_config.h"
+#include "vmodem_state.h"
+
+#define VMODEM_STATE_GROUP	"state"
+
+static void __get_string(GKeyFile *kf, const char *key, char *dst, size_t len)
+{
+	gchar *val;
+
+	val = g_key_file_get_string(kf, VMODEM_STATE_GROUP, key, NULL);
+	if (!val)
+		return;
+
+	snprintf(dst, len, "%s", val);
+	g_free(val);
+}
+
+static int __get_int(GKeyFile *kf, const char *key)
+{
+	return g_key_file_get_integer(kf, VMODEM_STATE_GROUP, key, NULL);
+}
+
+void vmodem_state_from_config(struct vmodem_state *st, const struct vmodem_config *cfg)
+{
+	const char *dev;
+
+	dev = strcmp(cfg->backend, "shm") == 0 ? cfg->shm_path : cfg->device_path;
+
+	snprintf(st->device_path, sizeof(st->device_path), "%s", dev);
+	snprintf(st->baudrate, sizeof(st->baudrate), "%s", cfg->baudrate);
+	snprintf(st->parity, sizeof(st->parity), "%s", cfg->parity);
+	snprintf(st->bits, sizeof(st->bits), "%s", cfg->bits);
+	snprintf(st->stop, sizeof(st->stop), "%s", cfg->stop);
+	st->hw_flow = cfg->hw_flow;
+	st->sw_flow = cfg->sw_flow;
+}
+
+/*
+ * Same device, same termios profile.
+ */
+gboolean vmodem_state_matches(const struct vmodem_state *st, const struct vmodem_config *cfg)
+{
+	struct vmodem_state cur;
+
+	memset(&cur, 0, sizeof(struct vmodem_state));
+	vmodem_state_from_config(&cur, cfg);
+
+	return strcmp(st->device_path, cur.device_path) == 0
+			&& strcmp(st->baudrate, cur.baudrate) == 0
+			&& strcmp(st->parity, cur.parity) == 0
+			&& strcmp(st->bits, cur.bits) == 0
+			&& strcmp(st->stop, cur.stop) == 0
+			&& st->hw_flow == cur.hw_flow
+			&& st->sw_flow == cur.sw_flow;
+}
+
+/*
+ * Returns FALSE, leaving st zeroed, when there is no usable state file.
+ */
+gboolean vmodem_state_load(struct vmodem_state *st, const char *path)
+{
+	GKeyFile *kf;
+
+	memset(st, 0, sizeof(struct vmodem_state));
+
+	if (!path)
+		return FALSE;
+
+	kf = g_key_file_new();
+
+	if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL)
+			|| !g_key_file_has_group(kf, VMODEM_STATE_GROUP)) {
+		dbg("no state %s, cold start", path);
+		g_key_file_free(kf);
+		return FALSE;
+	}
+
+	st->powered = __get_int(kf, "powered");
+	st->good = __get_int(kf, "good");
+	st->status = __get_int(kf, "status");
+
+	__get_string(kf, "device", st->device_path, sizeof(st->device_path));
+	__get_string(kf, "baudrate", st->baudrate, sizeof(st->baudrate));
+	__get_string(kf, "parity", st->parity, sizeof(st->parity));
+	__get_string(kf, "bits", st->bits, sizeof(st->bits));
+	__get_string(kf, "stop", st->stop, sizeof(st->stop));
+	st->hw_flow = __get_int(kf, "hw_flow");
+	st->sw_flow = __get_int(kf, "sw_flow");
+
+	g_key_file_free(kf);
+
+	dbg("state %s: powered=%d good=%d status=%u dev=%s", path,
+			st->powered, st->good, st->status, st->device_path);
+
+	return TRUE;
+}
+
+/*
+ * g_file_set_contents() renames a temporary file over path, so a crash
+ * mid-save leaves the previous state, never a torn one.
+ */
+gboolean vmodem_state_save(const struct vmodem_state *st, const char *path)
+{
+	GKeyFile *kf;
+	GError *error = NULL;
+	gchar *data;
+	gsize len;
+	gboolean ret;
+
+	if (!st || !path)
+		return FALSE;
+
+	kf = g_key_file_new();
+
+	g_key_file_set_integer(kf, VMODEM_STATE_GROUP, "powered", st->powered);
+	g_key_file_set_integer(kf, VMODEM_STATE_GROUP, "good", st->good);
+	g_key_file_set_integer(kf, VMODEM_STATE_GROUP, "status", st->status);
+	g_key_file_set_string(kf, VMODEM_STATE_GROUP, "device", st->device_path);
+	g_key_file_set_string(kf, VMODEM_STATE_GROUP, "baudrate", st->baudrate);
+	g_key_file_set_string(kf, VMODEM_STATE_GROUP, "parity", st->parity);
+	g_key_file_set_string(kf, VMODEM_STATE_GROUP, "bits", st->bits);
+	g_key_file_set_string(kf, VMODEM_STATE_GROUP, "stop", st->stop);
+	g_key_file_set_integer(kf, VMODEM_STATE_GROUP, "hw_flow", st->hw_flow);
+	g_key_file_set_integer(kf, VMODEM_STATE_GROUP, "sw_flow", st->sw_flow);
+
+	data = g_key_file_to_data(kf, &len, NULL);
+	g_key_file_free(kf);
+
+	ret = g_file_set_contents(path, data, len, &error);
+	if (!ret) {
+		err("state save %s failed (%s)", path, error ? error->message : "");
+		if (error)
+			g_error_free(error);
+	}
+
+	g_free(data);
+
+	return ret;
+}
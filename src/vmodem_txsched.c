@@ -0,0 +1,679 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_at.h"
+#include "vmodem_txsched.h"
+#include "vmodem_trace.h"
+
+#define CTRL_Z	0x1a
+#define ESC		0x1b
+
+#define VMODEM_TX_RETRY_MS	10
+#define VMODEM_TX_RETRY_CAP_US	1000000
+
+struct tx_item {
+	enum vmodem_tx_class cls;
+	gboolean is_body;		/* SMS PDU following AT+CMGS/AT+CMGW */
+	gboolean is_raw;		/* not an AT command, no SMS body either */
+	gboolean is_probe;		/* our own, not tcore's: no gate, no sent hook */
+	gint64 enqueued;
+	unsigned int len;
+	unsigned int off;
+	char data[];
+};
+
+struct vmodem_txsched {
+	int fd;
+	guint aging_ms;
+	guint watch_id;
+
+	VmodemTxWrite write;
+	VmodemTxGate gate;
+	VmodemTxSent sent;
+	void *user_data;
+
+	GQueue queue[VMODEM_TX_CLASS_MAX];
+	GQueue bodies;
+	GQueue probes;
+	struct tx_item *current;
+
+	/* [retry]: writes that made no progress before the item is dropped */
+	int retry_max;
+	int retry_sleep_us;
+	int retry_backoff;
+	int stalls;
+
+	enum vmodem_tx_class last_cls;
+	gboolean awaiting_body;
+	gboolean prompted;		/* the modem sent "> " for it */
+	guint body_cmds;		/* AT+CMGS/CMGW queued, not written yet */
+	guint body_unanswered;	/* AT+CMGS/CMGW written, final result not seen yet */
+
+	struct vmodem_tx_class_stats stats[VMODEM_TX_CLASS_MAX];
+};
+
+static const char *emergency_numbers[] = {
+	"112", "911", "999", "000", "08", "110", "118", "119", NULL
+};
+
+static const char *call_prefix[] = {
+	"ATD", "ATA", "ATH", "AT+CHUP", "AT+CHLD", "AT+VTS", "AT+CTFR", NULL
+};
+
+static const char *bulk_prefix[] = {
+	"AT+CMGS", "AT+CMGW", "AT+CMGL", "AT+CMGR", "AT+CMSS",
+	"AT+CPBR", "AT+CPBW", "AT+CPBF", "AT+CRSM", "AT+CSIM", NULL
+};
+
+static const char *class_name[VMODEM_TX_CLASS_MAX] = {
+	"emergency", "call", "normal", "bulk"
+};
+
+static gboolean __has_prefix(const char *data, unsigned int len, const char *prefix)
+{
+	size_t plen = strlen(prefix);
+
+	return len >= plen && g_ascii_strncasecmp(data, prefix, plen) == 0;
+}
+
+static gboolean __has_any_prefix(const char *data, unsigned int len, const char **list)
+{
+	int i;
+
+	for (i = 0; list[i]; i++) {
+		if (__has_prefix(data, len, list[i]))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean __is_emergency_dial(const char *data, unsigned int len)
+{
+	int i;
+	size_t nlen;
+	const char *number = data + 3;
+	unsigned int left = len - 3;
+
+	if (!__has_prefix(data, len, "ATD"))
+		return FALSE;
+
+	for (i = 0; emergency_numbers[i]; i++) {
+		nlen = strlen(emergency_numbers[i]);
+		if (left < nlen || memcmp(number, emergency_numbers[i], nlen) != 0)
+			continue;
+		if (left == nlen || !g_ascii_isdigit(number[nlen]))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+gboolean vmodem_txsched_expects_body(const char *data, unsigned int len)
+{
+	if (!__has_prefix(data, len, "AT+CMGS=") && !__has_prefix(data, len, "AT+CMGW="))
+		return FALSE;
+
+	/* PDU already in the same buffer */
+	return memchr(data, CTRL_Z, len) == NULL;
+}
+
+static gboolean __is_prompt(const char *line, unsigned int len)
+{
+	return line[0] == '>';
+}
+
+
+static gboolean on_writable(GIOChannel *channel, GIOCondition condition, gpointer data);
+static gboolean on_retry(gpointer data);
+
+/* retry sleep after the given number of stalls, grown by backoff */
+static guint __retry_ms(struct vmodem_txsched *s)
+{
+	long long us = s->retry_sleep_us;
+	int i;
+
+	for (i = 1; i < s->stalls && us < VMODEM_TX_RETRY_CAP_US; i++)
+		us *= s->retry_backoff;
+
+	us = MIN(us, VMODEM_TX_RETRY_CAP_US);
+
+	return MAX(VMODEM_TX_RETRY_MS, (guint)((us + 999) / 1000));
+}
+
+/*
+ * Wait for the fd to take more. A tty that polls writable but still
+ * refuses the write (EBUSY) would spin, so from the second stall on, as
+ * without a pollable fd (the mailbox backend), it is retried on the
+ * [retry] timer instead.
+ */
+static void __arm_writable(struct vmodem_txsched *s)
+{
+	GIOChannel *channel;
+
+	if (s->watch_id)
+		return;
+
+	if (s->fd < 0 || s->stalls > 1) {
+		s->watch_id = g_timeout_add(__retry_ms(s), on_retry, s);
+		return;
+	}
+
+	channel = g_io_channel_unix_new(s->fd);
+	s->watch_id = g_io_add_watch(channel, G_IO_OUT | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+			on_writable, s);
+	g_io_channel_unref(channel);
+}
+
+static void __drop_all(struct vmodem_txsched *s)
+{
+	int i;
+	struct tx_item *item;
+
+	free(s->current);
+	s->current = NULL;
+
+	for (i = 0; i < VMODEM_TX_CLASS_MAX; i++) {
+		while ((item = g_queue_pop_head(&s->queue[i])) != NULL)
+			free(item);
+	}
+
+	while ((item = g_queue_pop_head(&s->bodies)) != NULL)
+		free(item);
+
+	while ((item = g_queue_pop_head(&s->probes)) != NULL)
+		free(item);
+
+	s->awaiting_body = FALSE;
+	s->prompted = FALSE;
+	s->body_cmds = 0;
+}
+
+/*
+ * The modem wants no body (any more); whatever is still held for it
+ * would be taken for a command.
+ */
+static void __end_body_hold(struct vmodem_txsched *s)
+{
+	struct tx_item *item;
+
+	s->awaiting_body = FALSE;
+	s->prompted = FALSE;
+
+	if (s->body_cmds)
+		return;
+
+	while ((item = g_queue_pop_head(&s->bodies)) != NULL) {
+		err("dropping SMS body nobody asked for (len=%u)", item->len);
+		s->stats[item->cls].dropped++;
+		free(item);
+	}
+}
+
+static gboolean on_writable(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+	struct vmodem_txsched *s = data;
+
+	s->watch_id = 0;
+
+	if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		err("vdpram not writable (condition=0x%x), dropping TX queue", condition);
+		__drop_all(s);
+		return FALSE;
+	}
+
+	vmodem_txsched_kick(s);
+
+	return FALSE;
+}
+
+static gboolean on_retry(gpointer data)
+{
+	struct vmodem_txsched *s = data;
+
+	s->watch_id = 0;
+	vmodem_txsched_kick(s);
+
+	return FALSE;
+}
+
+/*
+ * Head of the class with the best aged priority; ties go to the
+ * older command.
+ */
+static GQueue *__pick_queue(struct vmodem_txsched *s)
+{
+	int i;
+	gint64 now;
+	gint64 eff;
+	gint64 best_eff = 0;
+	GQueue *best = NULL;
+	struct tx_item *head;
+	struct tx_item *best_head = NULL;
+
+	now = g_get_monotonic_time();
+
+	for (i = 0; i < VMODEM_TX_CLASS_MAX; i++) {
+		head = g_queue_peek_head(&s->queue[i]);
+		if (!head)
+			continue;
+
+		eff = i;
+		if (s->aging_ms)
+			eff -= (now - head->enqueued) / 1000 / s->aging_ms;
+		if (eff < 0)
+			eff = 0;
+
+		if (!best || eff < best_eff
+				|| (eff == best_eff && head->enqueued < best_head->enqueued)) {
+			best = &s->queue[i];
+			best_eff = eff;
+			best_head = head;
+		}
+	}
+
+	return best;
+}
+
+static struct tx_item *__next_item(struct vmodem_txsched *s)
+{
+	GQueue *q;
+	struct tx_item *item;
+
+	/*
+	 * An SMS command went out: nothing else may go in between, and the
+	 * body itself only once the modem has asked for it.
+	 */
+	if (s->awaiting_body)
+		return s->prompted ? g_queue_pop_head(&s->bodies) : NULL;
+
+	/* ahead of everything, but never inside another item or a body */
+	if (!g_queue_is_empty(&s->probes))
+		return g_queue_pop_head(&s->probes);
+
+	q = __pick_queue(s);
+	if (!q)
+		return NULL;
+
+	item = g_queue_peek_head(q);
+	if (s->gate && !s->gate(item->cls, s->user_data))
+		return NULL;
+
+	return g_queue_pop_head(q);
+}
+
+static void __account(struct vmodem_txsched *s, struct tx_item *item)
+{
+	struct vmodem_tx_class_stats *st = &s->stats[item->cls];
+	unsigned long long delay;
+
+	delay = g_get_monotonic_time() - item->enqueued;
+
+	st->count++;
+	st->delay_total_us += delay;
+	if (delay > st->delay_max_us)
+		st->delay_max_us = delay;
+
+	VMODEM_PROBE2(tx_dispatch, item->cls, delay);
+}
+
+struct vmodem_txsched *vmodem_txsched_new(int fd, guint aging_ms,
+		VmodemTxWrite write, void *user_data)
+{
+	struct vmodem_txsched *s;
+	int i;
+
+	if (!write)
+		return NULL;
+
+	s = calloc(sizeof(struct vmodem_txsched), 1);
+	if (!s)
+		return NULL;
+
+	s->fd = fd;
+	s->aging_ms = aging_ms;
+	s->write = write;
+	s->user_data = user_data;
+	s->last_cls = VMODEM_TX_NORMAL;
+	s->retry_max = 10;
+	s->retry_sleep_us = 50;
+	s->retry_backoff = 1;
+
+	for (i = 0; i < VMODEM_TX_CLASS_MAX; i++)
+		g_queue_init(&s->queue[i]);
+	g_queue_init(&s->bodies);
+	g_queue_init(&s->probes);
+
+	return s;
+}
+
+void vmodem_txsched_free(struct vmodem_txsched *s)
+{
+	if (!s)
+		return;
+
+	if (s->watch_id)
+		g_source_remove(s->watch_id);
+
+	__drop_all(s);
+	free(s);
+}
+
+void vmodem_txsched_set_aging(struct vmodem_txsched *s, guint aging_ms)
+{
+	if (s)
+		s->aging_ms = aging_ms;
+}
+
+/*
+ * Same meaning as vdpram_set_retry_policy(): after count writes in a row
+ * that took nothing the item is dropped; each retry sleep is the previous
+ * one times backoff. The sleeps are main loop timers, not select().
+ */
+void vmodem_txsched_set_retry(struct vmodem_txsched *s, int count, int sleep_us, int backoff)
+{
+	if (!s)
+		return;
+
+	s->retry_max = count < 0 ? 0 : count;
+	s->retry_sleep_us = sleep_us < 0 ? 0 : sleep_us;
+	s->retry_backoff = backoff < 1 ? 1 : backoff;
+}
+
+void vmodem_txsched_set_gate(struct vmodem_txsched *s, VmodemTxGate gate)
+{
+	if (s)
+		s->gate = gate;
+}
+
+void vmodem_txsched_set_sent(struct vmodem_txsched *s, VmodemTxSent sent)
+{
+	if (s)
+		s->sent = sent;
+}
+
+enum vmodem_tx_class vmodem_txsched_classify(const char *data, unsigned int len)
+{
+	if (__is_emergency_dial(data, len))
+		return VMODEM_TX_EMERGENCY;
+
+	if (__has_any_prefix(data, len, call_prefix))
+		return VMODEM_TX_CALL;
+
+	if (__has_any_prefix(data, len, bulk_prefix))
+		return VMODEM_TX_BULK;
+
+	return VMODEM_TX_NORMAL;
+}
+
+/*
+ * Queue one hal_send() buffer and push out as much as the tty takes.
+ */
+gboolean vmodem_txsched_send(struct vmodem_txsched *s, const char *data, unsigned int len)
+{
+	struct tx_item *item;
+
+	if (!s || !data || len == 0)
+		return FALSE;
+
+	item = malloc(sizeof(struct tx_item) + len);
+	if (!item)
+		return FALSE;
+
+	memcpy(item->data, data, len);
+	item->len = len;
+	item->off = 0;
+	item->enqueued = g_get_monotonic_time();
+	item->is_body = FALSE;
+	item->is_raw = FALSE;
+	item->is_probe = FALSE;
+
+	if (__has_prefix(data, len, "AT")) {
+		item->cls = vmodem_txsched_classify(data, len);
+		g_queue_push_tail(&s->queue[item->cls], item);
+		s->last_cls = item->cls;
+		if (vmodem_txsched_expects_body(data, len))
+			s->body_cmds++;
+	}
+	else if (s->awaiting_body || s->body_cmds) {
+		item->is_body = TRUE;
+		item->cls = s->last_cls;
+		g_queue_push_tail(&s->bodies, item);
+	}
+	else {
+		/* in order behind the command queued before it */
+		item->is_raw = TRUE;
+		item->cls = s->last_cls;
+		g_queue_push_tail(&s->queue[item->cls], item);
+	}
+
+	vmodem_txsched_kick(s);
+
+	return TRUE;
+}
+
+/*
+ * Queue a liveness probe. It passes the gate (the window may be held by
+ * the very command that hangs) and is not reported as sent, but like
+ * any command it waits for a partial write or an SMS body to finish.
+ */
+gboolean vmodem_txsched_send_probe(struct vmodem_txsched *s, const char *data, unsigned int len)
+{
+	struct tx_item *item;
+
+	if (!s || !data || len == 0)
+		return FALSE;
+
+	/* one is enough */
+	if (!g_queue_is_empty(&s->probes))
+		return TRUE;
+
+	item = calloc(sizeof(struct tx_item) + len, 1);
+	if (!item)
+		return FALSE;
+
+	memcpy(item->data, data, len);
+	item->len = len;
+	item->cls = VMODEM_TX_EMERGENCY;
+	item->is_probe = TRUE;
+	item->enqueued = g_get_monotonic_time();
+
+	g_queue_push_tail(&s->probes, item);
+
+	vmodem_txsched_kick(s);
+
+	return TRUE;
+}
+
+void vmodem_txsched_kick(struct vmodem_txsched *s)
+{
+	struct tx_item *item;
+	int n;
+
+	if (!s || s->watch_id)
+		return;
+
+	while (1) {
+		if (!s->current) {
+			s->current = __next_item(s);
+			if (!s->current)
+				return;
+			if (!s->current->is_probe)
+				__account(s, s->current);
+		}
+
+		item = s->current;
+
+		n = s->write(item->data + item->off, item->len - item->off, s->user_data);
+
+		if (n == 0 && s->stalls >= s->retry_max) {
+			err("vdpram took nothing %d times in a row", s->stalls + 1);
+			n = -EAGAIN;
+		}
+
+		if (n < 0) {
+			err("vdpram write failed (%d), dropping %u of %u bytes (%s)", -n,
+					item->len - item->off, item->len, class_name[item->cls]);
+			s->stalls = 0;
+			VMODEM_PROBE2(tx_drop, item->cls, -n);
+			if (!item->is_probe)
+				s->stats[item->cls].dropped++;
+
+			if (!item->is_body && !item->is_raw && !item->is_probe
+					&& vmodem_txsched_expects_body(item->data, item->len)) {
+				s->body_cmds--;
+				__end_body_hold(s);
+			}
+
+			free(item);
+			s->current = NULL;
+			continue;
+		}
+
+		item->off += n;
+		s->stalls = n ? 0 : s->stalls + 1;
+
+		if (item->off < item->len) {
+			__arm_writable(s);
+			return;
+		}
+
+		if (item->is_body) {
+			if (memchr(item->data, CTRL_Z, item->len) || memchr(item->data, ESC, item->len)) {
+				s->awaiting_body = FALSE;
+				s->prompted = FALSE;
+			}
+		}
+		else if (!item->is_raw && !item->is_probe) {
+			if (vmodem_txsched_expects_body(item->data, item->len)) {
+				s->body_cmds--;
+				s->body_unanswered++;
+				s->awaiting_body = TRUE;
+				s->prompted = FALSE;
+			}
+			if (s->sent)
+				s->sent(item->data, item->len, s->user_data);
+		}
+
+		free(item);
+		s->current = NULL;
+	}
+}
+
+/*
+ * The "> " prompt releases the SMS body. Only the command written last
+ * can be prompted for, the ones before it have their body already.
+ */
+void vmodem_txsched_rx(struct vmodem_txsched *s, const char *data, unsigned int len)
+{
+	if (!s || !s->awaiting_body || s->prompted)
+		return;
+
+	if (vmodem_at_scan(data, len, __is_prompt)) {
+		s->prompted = TRUE;
+		vmodem_txsched_kick(s);
+	}
+}
+
+/*
+ * Final result of an AT+CMGS/CMGW, as matched in order by the pipeline
+ * (a raw final could belong to the one before). When it answers the
+ * command still waiting for its prompt, no body is coming.
+ */
+void vmodem_txsched_body_final(struct vmodem_txsched *s)
+{
+	if (!s || s->body_unanswered == 0)
+		return;
+
+	s->body_unanswered--;
+
+	if (s->awaiting_body && s->body_unanswered == 0) {
+		__end_body_hold(s);
+		vmodem_txsched_kick(s);
+	}
+}
+
+/*
+ * The modem was power-cycled: no prompt or answer is coming for what
+ * was written before.
+ */
+void vmodem_txsched_modem_reset(struct vmodem_txsched *s)
+{
+	if (!s)
+		return;
+
+	s->body_unanswered = 0;
+	if (s->awaiting_body)
+		__end_body_hold(s);
+}
+
+gboolean vmodem_txsched_is_idle(struct vmodem_txsched *s)
+{
+	int i;
+
+	if (!s)
+		return TRUE;
+
+	if (s->current || s->awaiting_body || !g_queue_is_empty(&s->bodies)
+			|| !g_queue_is_empty(&s->probes))
+		return FALSE;
+
+	for (i = 0; i < VMODEM_TX_CLASS_MAX; i++) {
+		if (!g_queue_is_empty(&s->queue[i]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void vmodem_txsched_get_stats(struct vmodem_txsched *s,
+		struct vmodem_tx_class_stats stats[VMODEM_TX_CLASS_MAX])
+{
+	if (s && stats)
+		memcpy(stats, s->stats, sizeof(s->stats));
+}
+
+void vmodem_txsched_dump(struct vmodem_txsched *s)
+{
+	int i;
+	struct vmodem_tx_class_stats *st;
+
+	if (!s)
+		return;
+
+	for (i = 0; i < VMODEM_TX_CLASS_MAX; i++) {
+		st = &s->stats[i];
+		if (st->count == 0)
+			continue;
+
+		msg("tx %-9s: %llu sent, queue delay avg %llu us, max %llu us, %llu dropped", class_name[i],
+				st->count, st->delay_total_us / st->count, st->delay_max_us, st->dropped);
+	}
+}
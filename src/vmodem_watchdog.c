@@ -0,0 +1,431 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <log.h>
+
+#include "vmodem_watchdog.h"
+#include "vmodem_trace.h"
+
+/* longest line that can still be part of the probe answer ("AT", "OK") */
+#define WATCHDOG_LINE_MAX	8
+
+enum watchdog_state {
+	WATCHDOG_IDLE,		/* nothing outstanding */
+	WATCHDOG_WAITING,	/* TX sent, no command answered since */
+	WATCHDOG_PROBING,	/* liveness probe sent */
+	WATCHDOG_STALLED,	/* stall reported, waiting for an answer */
+};
+
+struct vmodem_watchdog {
+	enum watchdog_state state;
+	guint timer_id;
+
+	guint deadline_ms;
+	guint recover_ms;
+
+	gint64 pending_since;	/* monotonic, first unanswered TX */
+	gint64 last_rx;		/* monotonic */
+	guint outstanding;
+
+	/* probe sent, its OK not seen yet: RX goes through __filter_probe_answer() */
+	gboolean answer_pending;
+	gint64 probe_sent;		/* monotonic */
+	char line[WATCHDOG_LINE_MAX];
+	unsigned int line_len;
+	gboolean line_passed;	/* current line is too long for the answer, passed on */
+	GString *out;
+
+	const struct vmodem_watchdog_ops *ops;
+	void *user_data;
+
+	struct vmodem_stall_record records[VMODEM_WATCHDOG_MAX_RECORDS];
+	guint record_count;
+};
+
+static gboolean on_watchdog_timeout(gpointer data);
+
+static struct vmodem_stall_record *__current_record(struct vmodem_watchdog *wd)
+{
+	if (wd->record_count == 0)
+		return NULL;
+
+	return &wd->records[(wd->record_count - 1) % VMODEM_WATCHDOG_MAX_RECORDS];
+}
+
+static void __arm_timer(struct vmodem_watchdog *wd, guint ms)
+{
+	if (wd->timer_id)
+		g_source_remove(wd->timer_id);
+
+	wd->timer_id = g_timeout_add(ms, on_watchdog_timeout, wd);
+}
+
+static gboolean __is_line(const char *line, unsigned int len, const char *what)
+{
+	return len == strlen(what) && memcmp(line, what, len) == 0;
+}
+
+/*
+ * The modem answered: a command got its final result, or the probe its
+ * OK. URCs do not count, a modem can keep sending them while ignoring
+ * every command. With commands still outstanding the next one gets a
+ * full deadline from now.
+ */
+static void __answered(struct vmodem_watchdog *wd, guint outstanding)
+{
+	struct vmodem_stall_record *rec;
+
+	if (wd->state == WATCHDOG_PROBING || wd->state == WATCHDOG_STALLED) {
+		if (wd->timer_id) {
+			g_source_remove(wd->timer_id);
+			wd->timer_id = 0;
+		}
+
+		rec = __current_record(wd);
+		if (rec && rec->recovered_at == 0)
+			rec->recovered_at = g_get_real_time();
+
+		dbg("modem answered again");
+	}
+
+	wd->outstanding = outstanding;
+
+	/* the timer, if any, expires on its own and sees WATCHDOG_IDLE */
+	if (outstanding == 0 || wd->deadline_ms == 0) {
+		wd->state = WATCHDOG_IDLE;
+		return;
+	}
+
+	wd->state = WATCHDOG_WAITING;
+	wd->pending_since = g_get_monotonic_time();
+	if (!wd->timer_id)
+		wd->timer_id = g_timeout_add(wd->deadline_ms, on_watchdog_timeout, wd);
+}
+
+/*
+ * The probe answer is "OK", possibly preceded by the echoed "AT", and
+ * may arrive split across reads. Until it is complete every line is
+ * reassembled here: the echo, the OK and blank lines are dropped, any
+ * other line is passed on. Past the OK the data goes through as is.
+ */
+static const char *__filter_probe_answer(struct vmodem_watchdog *wd,
+		const char *data, unsigned int len, unsigned int *out_len)
+{
+	unsigned int i;
+	char c;
+
+	g_string_truncate(wd->out, 0);
+
+	for (i = 0; i < len && wd->answer_pending; i++) {
+		c = data[i];
+
+		if (c != '\r' && c != '\n') {
+			if (wd->line_passed) {
+				g_string_append_len(wd->out, &c, 1);
+			}
+			else if (wd->line_len < WATCHDOG_LINE_MAX) {
+				wd->line[wd->line_len++] = c;
+			}
+			else {
+				g_string_append_len(wd->out, wd->line, wd->line_len);
+				g_string_append_len(wd->out, &c, 1);
+				wd->line_len = 0;
+				wd->line_passed = TRUE;
+			}
+			continue;
+		}
+
+		if (wd->line_passed) {
+			g_string_append_len(wd->out, "\r\n", 2);
+			wd->line_passed = FALSE;
+		}
+		else if (__is_line(wd->line, wd->line_len, "OK")) {
+			dbg("probe answered");
+			wd->answer_pending = FALSE;
+			/* alive; a command it never answers is the pipeline's timeout */
+			__answered(wd, 0);
+			if (c == '\r' && i + 1 < len && data[i + 1] == '\n')
+				i++;
+		}
+		else if (wd->line_len && !__is_line(wd->line, wd->line_len, "AT")) {
+			g_string_append_len(wd->out, wd->line, wd->line_len);
+			g_string_append_len(wd->out, "\r\n", 2);
+		}
+
+		wd->line_len = 0;
+	}
+
+	g_string_append_len(wd->out, data + i, len - i);
+
+	*out_len = wd->out->len;
+	return wd->out->str;
+}
+
+static void __end_probe(struct vmodem_watchdog *wd)
+{
+	wd->answer_pending = FALSE;
+	wd->line_len = 0;
+	wd->line_passed = FALSE;
+}
+
+static void __send_probe(struct vmodem_watchdog *wd)
+{
+	struct vmodem_stall_record *rec;
+	gint64 now = g_get_real_time();
+
+	rec = &wd->records[wd->record_count % VMODEM_WATCHDOG_MAX_RECORDS];
+	wd->record_count++;
+
+	memset(rec, 0, sizeof(struct vmodem_stall_record));
+	rec->pending_since = now - (g_get_monotonic_time() - wd->pending_since);
+	rec->probed_at = now;
+
+	err("no answer from modem for %lld ms (outstanding=%u), probing",
+			(long long)(g_get_monotonic_time() - wd->pending_since) / 1000, wd->outstanding);
+	VMODEM_PROBE1(watchdog_probe, wd->outstanding);
+
+	wd->state = WATCHDOG_PROBING;
+	if (wd->ops->probe && wd->ops->probe(wd->user_data)) {
+		wd->answer_pending = TRUE;
+		wd->probe_sent = g_get_monotonic_time();
+	}
+	else
+		err("liveness probe could not be sent");
+
+	__arm_timer(wd, wd->recover_ms);
+}
+
+static void __report_stall(struct vmodem_watchdog *wd)
+{
+	struct vmodem_stall_record *rec = __current_record(wd);
+
+	if (rec)
+		rec->stalled_at = g_get_real_time();
+
+	err("modem stalled (outstanding=%u)", wd->outstanding);
+	VMODEM_PROBE1(watchdog_stall, wd->outstanding);
+
+	/* the modem is power-cycled, the probe will not be answered */
+	__end_probe(wd);
+
+	wd->state = WATCHDOG_STALLED;
+	wd->timer_id = 0;
+
+	if (wd->ops->stall)
+		wd->ops->stall(wd->user_data);
+}
+
+static gboolean on_watchdog_timeout(gpointer data)
+{
+	struct vmodem_watchdog *wd = data;
+	gint64 elapsed_ms;
+	guint deadline = 0;
+
+	switch (wd->state) {
+	case WATCHDOG_WAITING:
+		/*
+		 * Re-armed lazily: TX after the first one does not touch the
+		 * timer, and a slow command only extends it once it is due.
+		 */
+		if (wd->ops->deadline)
+			deadline = wd->ops->deadline(wd->user_data);
+		if (deadline == 0)
+			deadline = wd->deadline_ms;
+
+		elapsed_ms = (g_get_monotonic_time() - wd->pending_since) / 1000;
+		if (elapsed_ms < deadline) {
+			wd->timer_id = g_timeout_add(deadline - elapsed_ms,
+					on_watchdog_timeout, wd);
+			return FALSE;
+		}
+		wd->timer_id = 0;
+		__send_probe(wd);
+		return FALSE;
+
+	case WATCHDOG_PROBING:
+		__report_stall(wd);
+		return FALSE;
+
+	default:
+		break;
+	}
+
+	wd->timer_id = 0;
+	return FALSE;
+}
+
+struct vmodem_watchdog *vmodem_watchdog_new(guint deadline_ms, guint recover_ms,
+		const struct vmodem_watchdog_ops *ops, void *user_data)
+{
+	struct vmodem_watchdog *wd;
+
+	if (!ops || deadline_ms == 0)
+		return NULL;
+
+	wd = calloc(sizeof(struct vmodem_watchdog), 1);
+	if (!wd)
+		return NULL;
+
+	wd->deadline_ms = deadline_ms;
+	wd->recover_ms = recover_ms;
+	wd->ops = ops;
+	wd->user_data = user_data;
+	wd->state = WATCHDOG_IDLE;
+	wd->out = g_string_sized_new(256);
+
+	dbg("watchdog deadline=%u ms, recover=%u ms", deadline_ms, recover_ms);
+
+	return wd;
+}
+
+void vmodem_watchdog_free(struct vmodem_watchdog *wd)
+{
+	if (!wd)
+		return;
+
+	if (wd->timer_id)
+		g_source_remove(wd->timer_id);
+
+	g_string_free(wd->out, TRUE);
+	free(wd);
+}
+
+/*
+ * deadline_ms 0 stops watching: nothing is probed until a deadline is
+ * set again.
+ */
+void vmodem_watchdog_set_timeout(struct vmodem_watchdog *wd, guint deadline_ms, guint recover_ms)
+{
+	if (!wd)
+		return;
+
+	wd->deadline_ms = deadline_ms;
+	wd->recover_ms = recover_ms;
+
+	if (deadline_ms)
+		return;
+
+	if (wd->timer_id) {
+		g_source_remove(wd->timer_id);
+		wd->timer_id = 0;
+	}
+
+	wd->state = WATCHDOG_IDLE;
+	wd->outstanding = 0;
+}
+
+/*
+ * Called after every successful send. Only the first unanswered TX
+ * arms the timer, so a busy link costs no timer churn.
+ */
+void vmodem_watchdog_tx(struct vmodem_watchdog *wd)
+{
+	if (!wd || wd->deadline_ms == 0)
+		return;
+
+	wd->outstanding++;
+
+	/* after a reported stall, new traffic starts a fresh deadline */
+	if (wd->state == WATCHDOG_WAITING || wd->state == WATCHDOG_PROBING)
+		return;
+
+	wd->state = WATCHDOG_WAITING;
+	wd->pending_since = g_get_monotonic_time();
+
+	if (!wd->timer_id)
+		wd->timer_id = g_timeout_add(wd->deadline_ms, on_watchdog_timeout, wd);
+}
+
+/*
+ * Called for every chunk read from the modem, before anything else
+ * looks at it. Returns what is left once the answer to our own probe
+ * is taken out (out_len 0: nothing); data itself while no probe
+ * answer is pending. Reading alone does not feed the watchdog, only
+ * the probe's OK and vmodem_watchdog_answered() do.
+ */
+const char *vmodem_watchdog_rx(struct vmodem_watchdog *wd, const char *data,
+		unsigned int len, unsigned int *out_len)
+{
+	*out_len = len;
+
+	if (!wd)
+		return data;
+
+	wd->last_rx = g_get_monotonic_time();
+
+	/* the modem talked but never answered the probe: stop looking for it */
+	if (wd->answer_pending && (wd->last_rx - wd->probe_sent) / 1000 > wd->recover_ms) {
+		dbg("probe not answered within %u ms", wd->recover_ms);
+
+		/* what was held back of a line goes first */
+		g_string_truncate(wd->out, 0);
+		g_string_append_len(wd->out, wd->line, wd->line_len);
+		g_string_append_len(wd->out, data, len);
+		__end_probe(wd);
+
+		*out_len = wd->out->len;
+		return wd->out->str;
+	}
+
+	if (wd->answer_pending)
+		return __filter_probe_answer(wd, data, len, out_len);
+
+	return data;
+}
+
+/*
+ * A final result completed a command; outstanding is how many are still
+ * waiting for theirs.
+ */
+void vmodem_watchdog_answered(struct vmodem_watchdog *wd, guint outstanding)
+{
+	if (!wd)
+		return;
+
+	__answered(wd, outstanding);
+}
+
+void vmodem_watchdog_dump(struct vmodem_watchdog *wd)
+{
+	guint i;
+	guint first;
+	struct vmodem_stall_record *rec;
+
+	if (!wd)
+		return;
+
+	msg("watchdog: %u deadline miss(es) recorded", wd->record_count);
+
+	first = wd->record_count > VMODEM_WATCHDOG_MAX_RECORDS ?
+			wd->record_count - VMODEM_WATCHDOG_MAX_RECORDS : 0;
+
+	for (i = first; i < wd->record_count; i++) {
+		rec = &wd->records[i % VMODEM_WATCHDOG_MAX_RECORDS];
+		msg("  [%u] pending=%lld probed=%lld stalled=%lld recovered=%lld", i,
+				(long long)rec->pending_since, (long long)rec->probed_at,
+				(long long)rec->stalled_at, (long long)rec->recovered_at);
+	}
+}
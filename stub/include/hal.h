@@ -0,0 +1,65 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_HAL_H__
+#define __TCORE_HAL_H__
+
+/*
+ * Off-target stand-in for libtcore's hal.h. Requests are written
+ * straight to hops->send; there is no pending queue.
+ */
+
+enum tcore_hal_mode {
+	TCORE_HAL_MODE_UNKNOWN,
+	TCORE_HAL_MODE_AT,
+	TCORE_HAL_MODE_CUSTOM,
+	TCORE_HAL_MODE_TRANSPARENT
+};
+
+typedef void (*TcoreHalReceiveCallback)(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data);
+
+struct tcore_hal_operations {
+	TReturn (*power)(TcoreHal *hal, gboolean flag);
+	TReturn (*send)(TcoreHal *hal, unsigned int data_len, void *data);
+};
+
+TcoreHal *tcore_hal_new(TcorePlugin *plugin, const char *name,
+		struct tcore_hal_operations *hops, enum tcore_hal_mode mode);
+void tcore_hal_free(TcoreHal *hal);
+
+char *tcore_hal_get_name(TcoreHal *hal);
+enum tcore_hal_mode tcore_hal_get_mode(TcoreHal *hal);
+TReturn tcore_hal_set_mode(TcoreHal *hal, enum tcore_hal_mode mode);
+
+TReturn tcore_hal_link_user_data(TcoreHal *hal, void *user_data);
+void *tcore_hal_ref_user_data(TcoreHal *hal);
+TcorePlugin *tcore_hal_ref_plugin(TcoreHal *hal);
+
+TReturn tcore_hal_send_data(TcoreHal *hal, unsigned int data_len, void *data);
+
+TReturn tcore_hal_add_recv_callback(TcoreHal *hal, TcoreHalReceiveCallback func, void *user_data);
+TReturn tcore_hal_remove_recv_callback(TcoreHal *hal, TcoreHalReceiveCallback func);
+TReturn tcore_hal_emit_recv_callback(TcoreHal *hal, unsigned int data_len, const void *data);
+
+TReturn tcore_hal_set_power_state(TcoreHal *hal, gboolean flag);
+gboolean tcore_hal_get_power_state(TcoreHal *hal);
+TReturn tcore_hal_set_power(TcoreHal *hal, gboolean flag);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_LOG_H__
+#define __TCORE_LOG_H__
+
+/*
+ * Off-target stand-in for libtcore's dlog based log.h; everything goes
+ * to stderr. TCORE_STUB_QUIET in the environment silences dbg/msg.
+ */
+
+#include <stdio.h>
+
+#ifndef TCORE_LOG_TAG
+#define TCORE_LOG_TAG "UNKNOWN"
+#endif
+
+int tcore_stub_log_enabled(void);
+
+#define __tcore_stub_log(level, fmt, args...) \
+	fprintf(stderr, "%s/" TCORE_LOG_TAG ": <%s:%d> " fmt "\n", level, __func__, __LINE__, ##args)
+
+#define info(fmt, args...)	do { if (tcore_stub_log_enabled()) __tcore_stub_log("I", fmt, ##args); } while (0)
+#define msg(fmt, args...)	do { if (tcore_stub_log_enabled()) __tcore_stub_log("I", fmt, ##args); } while (0)
+#define dbg(fmt, args...)	do { if (tcore_stub_log_enabled()) __tcore_stub_log("D", fmt, ##args); } while (0)
+#define warn(fmt, args...)	__tcore_stub_log("W", fmt, ##args)
+#define err(fmt, args...)	__tcore_stub_log("E", fmt, ##args)
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_PLUGIN_H__
+#define __TCORE_PLUGIN_H__
+
+/*
+ * Off-target stand-in for libtcore's plugin.h.
+ */
+
+enum tcore_plugin_priority {
+	TCORE_PLUGIN_PRIORITY_HIGH = -100,
+	TCORE_PLUGIN_PRIORITY_MID = 0,
+	TCORE_PLUGIN_PRIORITY_LOW = +100
+};
+
+struct tcore_plugin_define_desc {
+	gchar *name;
+	enum tcore_plugin_priority priority;
+	int version;
+	gboolean (*load)();
+	gboolean (*init)(TcorePlugin *);
+	void (*unload)(TcorePlugin *);
+};
+
+const struct tcore_plugin_define_desc *tcore_plugin_get_description(TcorePlugin *plugin);
+
+TReturn tcore_plugin_link_user_data(TcorePlugin *plugin, void *user_data);
+void *tcore_plugin_ref_user_data(TcorePlugin *plugin);
+
+#endif
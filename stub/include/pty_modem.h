@@ -0,0 +1,95 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PTY_MODEM_H__
+#define __PTY_MODEM_H__
+
+/*
+ * Scripted AT responder on a pty master, for off-target drivers and
+ * benchmarks. The plugin opens pty_modem_slave() as its vdpram device
+ * (with [device] emulated). Each command line ("...\r") is handed to the
+ * handler, which answers with pty_modem_reply(); AT+CMGS=/AT+CMGW= get
+ * the "> " prompt here and the handler sees the body (up to Ctrl-Z) as
+ * a line with body set. Replies leave latency_ms after they are queued,
+ * in order. Everything runs on the default main context.
+ */
+
+struct pty_modem;
+
+typedef void (*PtyModemHandler)(struct pty_modem *m, const char *line, gboolean body,
+		void *user_data);
+
+struct pty_modem_stats {
+	unsigned long commands;
+	unsigned long bodies;
+	unsigned long long bytes_in;
+	unsigned long long bytes_out;
+};
+
+/* handler NULL: pty_modem_default() for everything */
+struct pty_modem *pty_modem_new(PtyModemHandler handler, void *user_data);
+void pty_modem_free(struct pty_modem *m);
+
+/*
+ * The same responder behind a shared memory mailbox (vdpram_shm.h)
+ * instead of a pty. pty_modem_device_conf() is the [device] group that
+ * points the plugin at it, to pass as (part of) the host's extra_conf.
+ */
+struct pty_modem *pty_modem_new_mailbox(PtyModemHandler handler, void *user_data,
+		unsigned int ring_size);
+const char *pty_modem_device_conf(struct pty_modem *m);
+
+const char *pty_modem_slave(struct pty_modem *m);
+void pty_modem_set_latency(struct pty_modem *m, guint latency_ms);
+
+/*
+ * The modem was just powered on and takes boot_ms to come up: commands
+ * are taken meanwhile, their answers leave once it is up.
+ */
+void pty_modem_set_booting(struct pty_modem *m, guint boot_ms);
+
+/*
+ * A pty moves data as fast as it is read, whatever its termios speed:
+ * pace both directions to bytes_per_s (baud / 10 for 8N1) to emulate
+ * the line. Input is read no faster, so a fast writer backs up and
+ * sees the fd full as it would behind a deasserted CTS. 0 turns pacing
+ * off.
+ */
+void pty_modem_set_rate(struct pty_modem *m, guint bytes_per_s);
+
+void pty_modem_reply(struct pty_modem *m, const char *data, unsigned int len);
+
+/*
+ * Data mode stand-in: with loopback on, whatever the plugin sends is
+ * sent straight back (bytes_in/bytes_out count it) instead of being
+ * parsed as AT commands. Turn it on once CONNECT was replied.
+ */
+void pty_modem_set_loopback(struct pty_modem *m, gboolean on);
+
+/*
+ * Canned answers: AT+CPBR=<i>[,<j>] lists entries i..j, AT+CMGR=<i>
+ * returns one stored PDU, anything else is OK; a body gets +CMGS: <n>.
+ * Every answer ends with OK.
+ */
+void pty_modem_default(struct pty_modem *m, const char *line, gboolean body);
+
+void pty_modem_get_stats(struct pty_modem *m, struct pty_modem_stats *stats);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_H__
+#define __TCORE_H__
+
+/*
+ * Off-target stand-in for libtcore's tcore.h: only the types and
+ * return codes this plugin uses.
+ */
+
+#include <glib.h>
+
+typedef enum {
+	TCORE_RETURN_SUCCESS = 0,
+	TCORE_RETURN_FAILURE = -1,
+	TCORE_RETURN_EINVAL = 1,
+	TCORE_RETURN_ENOMEM,
+	TCORE_RETURN_EPERM,
+	TCORE_RETURN_ENOSYS,
+} TReturn;
+
+typedef struct tcore_plugin_type TcorePlugin;
+typedef struct tcore_hal_type TcoreHal;
+
+#include <log.h>
+
+#endif
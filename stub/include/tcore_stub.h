@@ -0,0 +1,44 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_STUB_H__
+#define __TCORE_STUB_H__
+
+/*
+ * Host side of the off-target tcore stub. A driver loads the plugin
+ * the way the telephony server does:
+ *
+ *	desc = dlsym(dlopen("vmodem-plugin.so", RTLD_NOW), "plugin_define_desc");
+ *	desc->load();
+ *	plugin = tcore_stub_plugin_new(desc);
+ *	desc->init(plugin);
+ *	hal = tcore_stub_plugin_ref_hal(plugin);
+ *	tcore_hal_add_recv_callback(hal, on_recv, NULL);
+ *	... run a GMainLoop, tcore_hal_send_data(hal, ...) ...
+ *	tcore_stub_plugin_free(plugin);
+ */
+
+TcorePlugin *tcore_stub_plugin_new(const struct tcore_plugin_define_desc *desc);
+void tcore_stub_plugin_free(TcorePlugin *plugin);
+
+/* the most recent HAL created by the plugin */
+TcoreHal *tcore_stub_plugin_ref_hal(TcorePlugin *plugin);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VMODEM_HOST_H__
+#define __VMODEM_HOST_H__
+
+/*
+ * Loads the plugin the way the telephony server does, against the tcore
+ * stub, with a throwaway config that points [device] at a pty slave in
+ * emulated mode. extra_conf (may be NULL) is appended to that config;
+ * GKeyFile merges a repeated group and the last value of a key wins, so
+ * it may add to or override [device] and [state] too. The modem is
+ * powered on.
+ */
+
+struct vmodem_host;
+
+struct vmodem_host *vmodem_host_new(const char *plugin_path, const char *slave,
+		const char *extra_conf);
+void vmodem_host_free(struct vmodem_host *h);
+
+TcoreHal *vmodem_host_hal(struct vmodem_host *h);
+
+/* a symbol of the loaded plugin, e.g. vdpram_get_io_stats */
+void *vmodem_host_sym(struct vmodem_host *h, const char *name);
+
+#endif
@@ -0,0 +1,635 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "vdpram_shm.h"
+#include "pty_modem.h"
+
+#define PTY_MODEM_CTRL_Z	0x1a
+#define PTY_MODEM_ESC		0x1b
+
+/* a full mailbox ring cannot be polled for room */
+#define PTY_MODEM_RETRY_MS	1
+
+/* loopback: stop reading while this much echo is still queued */
+#define PTY_MODEM_LOOP_HIGH	(256 * 1024)
+
+/* a paced line idle for longer may burst this much line time at once */
+#define PTY_MODEM_RATE_BURST_US	10000
+
+struct pty_rate {
+	gint64 t0;
+	unsigned long long sent;
+};
+
+struct pty_reply {
+	gint64 due;		/* monotonic usec */
+	unsigned int len;
+	char data[];
+};
+
+struct pty_modem {
+	int fd;				/* master */
+	int hold_fd;		/* slave, kept open so the master never hangs up */
+	char slave[64];
+
+	/* mailbox mode: fd and hold_fd are -1 */
+	struct vdpram_shm *shm;
+	int mem_fd;
+	int bell_fd[2];		/* ours: we ring [0], the plugin rings [1] */
+	char dir[32];
+	char bell_path[2][64];	/* the plugin's rx and tx doorbells */
+	char device_conf[512];
+
+	guint watch_in;
+	guint watch_out;
+	guint timer_id;
+	guint latency_ms;
+	gint64 boot_until;	/* monotonic, replies held while booting */
+
+	/* paced line: bytes per second each way, 0 for as fast as the pty goes */
+	guint rate;
+	struct pty_rate rate_in;
+	struct pty_rate rate_out;
+	guint timer_in;		/* reading paused until the line caught up */
+
+	GString *line;
+	gboolean in_body;
+	gboolean loopback;
+
+	GQueue pending;		/* struct pty_reply, waiting for latency_ms */
+	GString *out;		/* due, not yet taken by the slave */
+
+	PtyModemHandler handler;
+	void *user_data;
+
+	unsigned long cmgs_ref;
+	struct pty_modem_stats stats;
+};
+
+static gboolean on_writable(GIOChannel *channel, GIOCondition condition, gpointer data);
+static gboolean on_reply_due(gpointer data);
+static gboolean on_readable(GIOChannel *channel, GIOCondition condition, gpointer data);
+
+static guint __add_watch(int fd, GIOCondition cond, GIOFunc func, void *user_data)
+{
+	GIOChannel *channel;
+	guint source;
+
+	channel = g_io_channel_unix_new(fd);
+	source = g_io_add_watch(channel, cond, func, user_data);
+	g_io_channel_unref(channel);
+
+	return source;
+}
+
+static gboolean on_retry(gpointer data);
+
+static ssize_t __write(struct pty_modem *m, const void *data, size_t len)
+{
+	if (m->shm)
+		return vdpram_shm_write(m->shm, data, len);
+
+	return write(m->fd, data, len);
+}
+
+static ssize_t __read(struct pty_modem *m, void *buf, size_t len)
+{
+	ssize_t n;
+
+	if (!m->shm)
+		return read(m->fd, buf, len);
+
+	/* an empty ring is not a hangup */
+	n = vdpram_shm_read(m->shm, buf, len);
+	if (n == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return n;
+}
+
+/* what the paced line may carry now in one direction */
+static gint64 __rate_budget(struct pty_modem *m, struct pty_rate *r)
+{
+	gint64 now = g_get_monotonic_time();
+	gint64 budget;
+
+	budget = (now - r->t0) * m->rate / 1000000 - (gint64)r->sent;
+	if (budget > (gint64)m->rate * PTY_MODEM_RATE_BURST_US / 1000000) {
+		r->t0 = now - PTY_MODEM_RATE_BURST_US;
+		r->sent = 0;
+		budget = (gint64)m->rate * PTY_MODEM_RATE_BURST_US / 1000000;
+	}
+
+	return budget;
+}
+
+static int __in_fd(struct pty_modem *m)
+{
+	return m->shm ? vdpram_shm_fd(m->shm) : m->fd;
+}
+
+static void __flush(struct pty_modem *m)
+{
+	gboolean paced = FALSE;
+	gint64 len;
+	ssize_t n;
+
+	while (m->out->len) {
+		len = m->out->len;
+		if (m->rate) {
+			len = MIN(len, __rate_budget(m, &m->rate_out));
+			if (len <= 0) {
+				paced = TRUE;
+				break;
+			}
+		}
+
+		n = __write(m, m->out->str, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+
+		m->stats.bytes_out += n;
+		m->rate_out.sent += n;
+		g_string_erase(m->out, 0, n);
+	}
+
+	/* loopback input was paused on a full echo queue */
+	if (m->loopback && !m->watch_in && !m->timer_in && m->out->len < PTY_MODEM_LOOP_HIGH)
+		m->watch_in = __add_watch(__in_fd(m), G_IO_IN, on_readable, m);
+
+	if (!m->out->len || m->watch_out)
+		return;
+
+	if (m->shm || paced)
+		m->watch_out = g_timeout_add(PTY_MODEM_RETRY_MS, on_retry, m);
+	else
+		m->watch_out = __add_watch(m->fd, G_IO_OUT, on_writable, m);
+}
+
+static void __arm_timer(struct pty_modem *m)
+{
+	struct pty_reply *r;
+	gint64 wait;
+
+	r = g_queue_peek_head(&m->pending);
+	if (!r || m->timer_id)
+		return;
+
+	wait = (r->due - g_get_monotonic_time() + 999) / 1000;
+	m->timer_id = g_timeout_add(wait > 0 ? wait : 0, on_reply_due, m);
+}
+
+static gboolean on_reply_due(gpointer data)
+{
+	struct pty_modem *m = data;
+	struct pty_reply *r;
+	gint64 now = g_get_monotonic_time();
+
+	m->timer_id = 0;
+
+	while ((r = g_queue_peek_head(&m->pending)) != NULL && r->due <= now) {
+		g_queue_pop_head(&m->pending);
+		g_string_append_len(m->out, r->data, r->len);
+		free(r);
+	}
+
+	__flush(m);
+	__arm_timer(m);
+
+	return FALSE;
+}
+
+static gboolean on_writable(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+	struct pty_modem *m = data;
+
+	m->watch_out = 0;
+	__flush(m);
+
+	return FALSE;
+}
+
+static gboolean on_retry(gpointer data)
+{
+	struct pty_modem *m = data;
+
+	m->watch_out = 0;
+	__flush(m);
+
+	return FALSE;
+}
+
+static gboolean __is_body_cmd(const char *line)
+{
+	return g_ascii_strncasecmp(line, "AT+CMGS=", 8) == 0
+		|| g_ascii_strncasecmp(line, "AT+CMGW=", 8) == 0;
+}
+
+static void __dispatch(struct pty_modem *m, gboolean body)
+{
+	if (m->handler)
+		m->handler(m, m->line->str, body, m->user_data);
+	else
+		pty_modem_default(m, m->line->str, body);
+}
+
+static void __parse(struct pty_modem *m, const char *buf, ssize_t len)
+{
+	ssize_t i;
+	char c;
+
+	for (i = 0; i < len; i++) {
+		c = buf[i];
+
+		if (m->in_body) {
+			if (c == PTY_MODEM_ESC) {
+				m->in_body = FALSE;
+				g_string_truncate(m->line, 0);
+				pty_modem_reply(m, "\r\nOK\r\n", 6);
+			}
+			else if (c == PTY_MODEM_CTRL_Z) {
+				m->in_body = FALSE;
+				m->stats.bodies++;
+				__dispatch(m, TRUE);
+				g_string_truncate(m->line, 0);
+			}
+			else {
+				g_string_append_len(m->line, &c, 1);
+			}
+			continue;
+		}
+
+		if (c != '\r' && c != '\n') {
+			g_string_append_len(m->line, &c, 1);
+			continue;
+		}
+
+		if (m->line->len == 0)
+			continue;
+
+		m->stats.commands++;
+
+		if (__is_body_cmd(m->line->str)) {
+			m->in_body = TRUE;
+			pty_modem_reply(m, "\r\n> ", 4);
+		}
+		else {
+			__dispatch(m, FALSE);
+		}
+
+		g_string_truncate(m->line, 0);
+	}
+}
+
+static gboolean on_read_due(gpointer data)
+{
+	struct pty_modem *m = data;
+
+	m->timer_in = 0;
+	m->watch_in = __add_watch(__in_fd(m), G_IO_IN, on_readable, m);
+
+	return FALSE;
+}
+
+static gboolean on_readable(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+	struct pty_modem *m = data;
+	char buf[4096];
+	gint64 len;
+	ssize_t n;
+
+	while (1) {
+		len = sizeof(buf);
+		if (m->rate) {
+			/* unread, the data backs up into the writer like on a slow line */
+			len = MIN(len, __rate_budget(m, &m->rate_in));
+			if (len <= 0) {
+				m->watch_in = 0;
+				m->timer_in = g_timeout_add(PTY_MODEM_RETRY_MS, on_read_due, m);
+				return FALSE;
+			}
+		}
+
+		n = __read(m, buf, len);
+		if (n <= 0)
+			break;
+
+		m->rate_in.sent += n;
+		m->stats.bytes_in += n;
+		if (!m->loopback) {
+			__parse(m, buf, n);
+			continue;
+		}
+
+		g_string_append_len(m->out, buf, n);
+		if (m->out->len >= PTY_MODEM_LOOP_HIGH) {
+			/* __flush() resumes reading once the echo drained */
+			m->watch_in = 0;
+			__flush(m);
+			return FALSE;
+		}
+	}
+
+	if (m->loopback)
+		__flush(m);
+
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+		m->watch_in = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+struct pty_modem *pty_modem_new(PtyModemHandler handler, void *user_data)
+{
+	struct pty_modem *m;
+
+	m = calloc(sizeof(struct pty_modem), 1);
+	if (!m)
+		return NULL;
+
+	m->hold_fd = -1;
+	m->mem_fd = -1;
+	m->bell_fd[0] = m->bell_fd[1] = -1;
+	m->fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (m->fd < 0)
+		goto fail;
+
+	if (grantpt(m->fd) < 0 || unlockpt(m->fd) < 0
+			|| ptsname_r(m->fd, m->slave, sizeof(m->slave)) != 0)
+		goto fail;
+
+	m->hold_fd = open(m->slave, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (m->hold_fd < 0)
+		goto fail;
+
+	fcntl(m->fd, F_SETFL, fcntl(m->fd, F_GETFL) | O_NONBLOCK);
+
+	m->line = g_string_sized_new(256);
+	m->out = g_string_sized_new(4096);
+	g_queue_init(&m->pending);
+	m->handler = handler;
+	m->user_data = user_data;
+
+	m->watch_in = __add_watch(__in_fd(m), G_IO_IN, on_readable, m);
+
+	return m;
+
+fail:
+	if (m->fd >= 0)
+		close(m->fd);
+	free(m);
+	return NULL;
+}
+
+void pty_modem_free(struct pty_modem *m)
+{
+	struct pty_reply *r;
+
+	if (!m)
+		return;
+
+	if (m->watch_in)
+		g_source_remove(m->watch_in);
+	if (m->watch_out)
+		g_source_remove(m->watch_out);
+	if (m->timer_id)
+		g_source_remove(m->timer_id);
+	if (m->timer_in)
+		g_source_remove(m->timer_in);
+
+	while ((r = g_queue_pop_head(&m->pending)) != NULL)
+		free(r);
+
+	g_string_free(m->line, TRUE);
+	g_string_free(m->out, TRUE);
+	if (m->shm) {
+		vdpram_shm_detach(m->shm);
+		close(m->mem_fd);
+		close(m->bell_fd[0]);
+		close(m->bell_fd[1]);
+		unlink(m->bell_path[0]);
+		unlink(m->bell_path[1]);
+		rmdir(m->dir);
+	}
+	else {
+		close(m->hold_fd);
+		close(m->fd);
+	}
+
+	free(m);
+}
+
+/*
+ * The region is an emulated mailbox from vdpram_shm_create_memfd(); the
+ * plugin opens it through /proc (same process). Its eventfd doorbells
+ * have no path to open, so the plugin gets a FIFO per direction instead.
+ */
+struct pty_modem *pty_modem_new_mailbox(PtyModemHandler handler, void *user_data,
+		unsigned int ring_size)
+{
+	struct pty_modem *m;
+	int bells[2];
+	int i;
+
+	m = calloc(sizeof(struct pty_modem), 1);
+	if (!m)
+		return NULL;
+
+	m->fd = m->hold_fd = -1;
+	m->bell_fd[0] = m->bell_fd[1] = -1;
+
+	if (vdpram_shm_create_memfd(ring_size, &m->mem_fd, bells) < 0) {
+		free(m);
+		return NULL;
+	}
+	close(bells[0]);
+	close(bells[1]);
+
+	snprintf(m->dir, sizeof(m->dir), "/tmp/pty-modem.XXXXXX");
+	if (!mkdtemp(m->dir))
+		goto fail;
+
+	snprintf(m->bell_path[0], sizeof(m->bell_path[0]), "%s/bell_rx", m->dir);
+	snprintf(m->bell_path[1], sizeof(m->bell_path[1]), "%s/bell_tx", m->dir);
+
+	for (i = 0; i < 2; i++) {
+		if (mkfifo(m->bell_path[i], 0600) < 0)
+			goto fail;
+		m->bell_fd[i] = open(m->bell_path[i], O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (m->bell_fd[i] < 0)
+			goto fail;
+	}
+
+	/* the plugin's rx doorbell is the one we ring */
+	m->shm = vdpram_shm_attach(m->mem_fd, VDPRAM_SHM_SIDE_MODEM, m->bell_fd[0], m->bell_fd[1]);
+	if (!m->shm)
+		goto fail;
+
+	snprintf(m->slave, sizeof(m->slave), "/proc/%d/fd/%d", (int)getpid(), m->mem_fd);
+	snprintf(m->device_conf, sizeof(m->device_conf),
+			"[device]\nbackend=shm\nshm_path=%s\nshm_doorbell_rx=%s\nshm_doorbell_tx=%s\n",
+			m->slave, m->bell_path[0], m->bell_path[1]);
+
+	m->line = g_string_sized_new(256);
+	m->out = g_string_sized_new(4096);
+	g_queue_init(&m->pending);
+	m->handler = handler;
+	m->user_data = user_data;
+
+	m->watch_in = __add_watch(__in_fd(m), G_IO_IN, on_readable, m);
+
+	return m;
+
+fail:
+	for (i = 0; i < 2; i++) {
+		if (m->bell_fd[i] >= 0)
+			close(m->bell_fd[i]);
+		unlink(m->bell_path[i]);
+	}
+	rmdir(m->dir);
+	close(m->mem_fd);
+	free(m);
+	return NULL;
+}
+
+const char *pty_modem_device_conf(struct pty_modem *m)
+{
+	return m && m->shm ? m->device_conf : NULL;
+}
+
+const char *pty_modem_slave(struct pty_modem *m)
+{
+	return m ? m->slave : NULL;
+}
+
+void pty_modem_set_latency(struct pty_modem *m, guint latency_ms)
+{
+	if (m)
+		m->latency_ms = latency_ms;
+}
+
+void pty_modem_set_booting(struct pty_modem *m, guint boot_ms)
+{
+	if (m)
+		m->boot_until = g_get_monotonic_time() + boot_ms * 1000LL;
+}
+
+void pty_modem_set_rate(struct pty_modem *m, guint bytes_per_s)
+{
+	if (!m)
+		return;
+
+	m->rate = bytes_per_s;
+	m->rate_in.t0 = m->rate_out.t0 = g_get_monotonic_time();
+	m->rate_in.sent = m->rate_out.sent = 0;
+}
+
+void pty_modem_set_loopback(struct pty_modem *m, gboolean on)
+{
+	if (m)
+		m->loopback = on;
+}
+
+void pty_modem_reply(struct pty_modem *m, const char *data, unsigned int len)
+{
+	struct pty_reply *r;
+	gint64 now;
+
+	if (!m || !data || len == 0)
+		return;
+
+	now = g_get_monotonic_time();
+
+	/* nothing held back: straight out, keeping order */
+	if (m->latency_ms == 0 && g_queue_is_empty(&m->pending) && now >= m->boot_until) {
+		g_string_append_len(m->out, data, len);
+		__flush(m);
+		return;
+	}
+
+	r = malloc(sizeof(struct pty_reply) + len);
+	if (!r)
+		return;
+
+	r->due = MAX(now + m->latency_ms * 1000LL, m->boot_until);
+	r->len = len;
+	memcpy(r->data, data, len);
+
+	g_queue_push_tail(&m->pending, r);
+	__arm_timer(m);
+}
+
+void pty_modem_default(struct pty_modem *m, const char *line, gboolean body)
+{
+	GString *ans;
+	int first;
+	int last;
+	int i;
+
+	ans = g_string_sized_new(128);
+
+	if (body) {
+		g_string_append_printf(ans, "\r\n+CMGS: %lu\r\n", ++m->cmgs_ref % 256);
+	}
+	else if (g_ascii_strncasecmp(line, "AT+CPBR=", 8) == 0) {
+		first = last = atoi(line + 8);
+		if (strchr(line, ','))
+			last = atoi(strchr(line, ',') + 1);
+
+		g_string_append(ans, "\r\n");
+		for (i = first; i <= last; i++)
+			g_string_append_printf(ans, "+CPBR: %d,\"+8210555%05d\",145,\"Contact %d\"\r\n",
+					i, i, i);
+	}
+	else if (g_ascii_strncasecmp(line, "AT+CMGR=", 8) == 0) {
+		g_string_append(ans, "\r\n+CMGR: 1,,24\r\n"
+				"07912180958729F6040B912180551622F000003210211185450A04D4F29C0E\r\n");
+	}
+
+	g_string_append(ans, "\r\nOK\r\n");
+	pty_modem_reply(m, ans->str, ans->len);
+	g_string_free(ans, TRUE);
+}
+
+void pty_modem_get_stats(struct pty_modem *m, struct pty_modem_stats *stats)
+{
+	if (m && stats)
+		*stats = m->stats;
+}
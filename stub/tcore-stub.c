@@ -0,0 +1,318 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "tcore_stub.h"
+
+struct tcore_plugin_type {
+	const struct tcore_plugin_define_desc *desc;
+	void *user_data;
+	TcoreHal *hal;
+};
+
+struct tcore_hal_recv_callback_item {
+	TcoreHalReceiveCallback func;
+	void *user_data;
+};
+
+struct tcore_hal_type {
+	TcorePlugin *parent_plugin;
+	char *name;
+	struct tcore_hal_operations *ops;
+	enum tcore_hal_mode mode;
+	void *user_data;
+	gboolean power_state;
+	GSList *callbacks;
+};
+
+int tcore_stub_log_enabled(void)
+{
+	static int enabled = -1;
+
+	if (enabled < 0)
+		enabled = getenv("TCORE_STUB_QUIET") ? 0 : 1;
+
+	return enabled;
+}
+
+TcorePlugin *tcore_stub_plugin_new(const struct tcore_plugin_define_desc *desc)
+{
+	TcorePlugin *p;
+
+	p = calloc(sizeof(struct tcore_plugin_type), 1);
+	if (!p)
+		return NULL;
+
+	p->desc = desc;
+
+	return p;
+}
+
+void tcore_stub_plugin_free(TcorePlugin *plugin)
+{
+	if (!plugin)
+		return;
+
+	if (plugin->desc && plugin->desc->unload)
+		plugin->desc->unload(plugin);
+
+	if (plugin->hal)
+		tcore_hal_free(plugin->hal);
+
+	free(plugin);
+}
+
+TcoreHal *tcore_stub_plugin_ref_hal(TcorePlugin *plugin)
+{
+	if (!plugin)
+		return NULL;
+
+	return plugin->hal;
+}
+
+const struct tcore_plugin_define_desc *tcore_plugin_get_description(TcorePlugin *plugin)
+{
+	if (!plugin)
+		return NULL;
+
+	return plugin->desc;
+}
+
+TReturn tcore_plugin_link_user_data(TcorePlugin *plugin, void *user_data)
+{
+	if (!plugin)
+		return TCORE_RETURN_EINVAL;
+
+	plugin->user_data = user_data;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+void *tcore_plugin_ref_user_data(TcorePlugin *plugin)
+{
+	if (!plugin)
+		return NULL;
+
+	return plugin->user_data;
+}
+
+TcoreHal *tcore_hal_new(TcorePlugin *plugin, const char *name,
+		struct tcore_hal_operations *hops, enum tcore_hal_mode mode)
+{
+	TcoreHal *h;
+
+	if (!name)
+		return NULL;
+
+	h = calloc(sizeof(struct tcore_hal_type), 1);
+	if (!h)
+		return NULL;
+
+	h->parent_plugin = plugin;
+	h->name = strdup(name);
+	h->ops = hops;
+	h->mode = mode;
+
+	if (plugin)
+		plugin->hal = h;
+
+	return h;
+}
+
+void tcore_hal_free(TcoreHal *hal)
+{
+	GSList *l;
+
+	if (!hal)
+		return;
+
+	if (hal->parent_plugin && hal->parent_plugin->hal == hal)
+		hal->parent_plugin->hal = NULL;
+
+	for (l = hal->callbacks; l; l = l->next)
+		free(l->data);
+	g_slist_free(hal->callbacks);
+
+	free(hal->name);
+	free(hal);
+}
+
+char *tcore_hal_get_name(TcoreHal *hal)
+{
+	if (!hal)
+		return NULL;
+
+	return strdup(hal->name);
+}
+
+enum tcore_hal_mode tcore_hal_get_mode(TcoreHal *hal)
+{
+	if (!hal)
+		return TCORE_HAL_MODE_UNKNOWN;
+
+	return hal->mode;
+}
+
+TReturn tcore_hal_set_mode(TcoreHal *hal, enum tcore_hal_mode mode)
+{
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	hal->mode = mode;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_hal_link_user_data(TcoreHal *hal, void *user_data)
+{
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	hal->user_data = user_data;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+void *tcore_hal_ref_user_data(TcoreHal *hal)
+{
+	if (!hal)
+		return NULL;
+
+	return hal->user_data;
+}
+
+TcorePlugin *tcore_hal_ref_plugin(TcoreHal *hal)
+{
+	if (!hal)
+		return NULL;
+
+	return hal->parent_plugin;
+}
+
+TReturn tcore_hal_send_data(TcoreHal *hal, unsigned int data_len, void *data)
+{
+	if (!hal || !hal->ops || !hal->ops->send)
+		return TCORE_RETURN_EINVAL;
+
+	return hal->ops->send(hal, data_len, data);
+}
+
+TReturn tcore_hal_add_recv_callback(TcoreHal *hal, TcoreHalReceiveCallback func, void *user_data)
+{
+	struct tcore_hal_recv_callback_item *item;
+
+	if (!hal || !func)
+		return TCORE_RETURN_EINVAL;
+
+	item = calloc(sizeof(struct tcore_hal_recv_callback_item), 1);
+	if (!item)
+		return TCORE_RETURN_ENOMEM;
+
+	item->func = func;
+	item->user_data = user_data;
+
+	hal->callbacks = g_slist_append(hal->callbacks, item);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_hal_remove_recv_callback(TcoreHal *hal, TcoreHalReceiveCallback func)
+{
+	GSList *l;
+	struct tcore_hal_recv_callback_item *item;
+
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	l = hal->callbacks;
+	while (l) {
+		item = l->data;
+		l = l->next;
+
+		if (item->func == func) {
+			hal->callbacks = g_slist_remove(hal->callbacks, item);
+			free(item);
+		}
+	}
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_hal_emit_recv_callback(TcoreHal *hal, unsigned int data_len, const void *data)
+{
+	GSList *list;
+	GSList *l;
+	struct tcore_hal_recv_callback_item *item;
+
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	/*
+	 * A callback may remove itself or others: walk a copy, and skip
+	 * whatever was removed (and freed) meanwhile.
+	 */
+	list = g_slist_copy(hal->callbacks);
+	for (l = list; l; l = l->next) {
+		if (!g_slist_find(hal->callbacks, l->data))
+			continue;
+
+		item = l->data;
+		item->func(hal, data_len, data, item->user_data);
+	}
+	g_slist_free(list);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_hal_set_power_state(TcoreHal *hal, gboolean flag)
+{
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	hal->power_state = flag;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+gboolean tcore_hal_get_power_state(TcoreHal *hal)
+{
+	if (!hal)
+		return FALSE;
+
+	return hal->power_state;
+}
+
+TReturn tcore_hal_set_power(TcoreHal *hal, gboolean flag)
+{
+	if (!hal || !hal->ops || !hal->ops->power)
+		return TCORE_RETURN_EINVAL;
+
+	return hal->ops->power(hal, flag);
+}
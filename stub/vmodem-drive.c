@@ -0,0 +1,118 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Off-target smoke driver: loads the plugin against the tcore stub,
+ * points it at a pty answered by pty-modem, and round-trips "AT".
+ *
+ *	vmodem-drive [path/to/vmodem-plugin.so]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "pty_modem.h"
+#include "vmodem_host.h"
+
+#define DRIVE_TIMEOUT_MS	2000
+
+struct drive {
+	GMainLoop *loop;
+	GString *rx;
+	gboolean ok;
+};
+
+static void on_recv(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	struct drive *d = user_data;
+
+	g_string_append_len(d->rx, data, data_len);
+
+	if (strstr(d->rx->str, "\r\nOK\r\n")) {
+		d->ok = TRUE;
+		g_main_loop_quit(d->loop);
+	}
+}
+
+static gboolean on_timeout(gpointer data)
+{
+	struct drive *d = data;
+
+	g_main_loop_quit(d->loop);
+
+	return FALSE;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plugin_path = argc > 1 ? argv[1] : "./vmodem-plugin.so";
+	struct pty_modem *modem;
+	struct vmodem_host *host;
+	struct drive d;
+	TcoreHal *hal;
+	gint64 sent;
+
+	memset(&d, 0, sizeof(d));
+
+	modem = pty_modem_new(NULL, NULL);
+	if (!modem) {
+		fprintf(stderr, "pty setup failed\n");
+		return 1;
+	}
+
+	host = vmodem_host_new(plugin_path, pty_modem_slave(modem), NULL);
+	if (!host)
+		return 1;
+
+	hal = vmodem_host_hal(host);
+	tcore_hal_add_recv_callback(hal, on_recv, &d);
+
+	d.loop = g_main_loop_new(NULL, FALSE);
+	d.rx = g_string_sized_new(64);
+
+	sent = g_get_monotonic_time();
+	if (tcore_hal_send_data(hal, 3, "AT\r") != TCORE_RETURN_SUCCESS) {
+		fprintf(stderr, "hal send failed\n");
+		return 1;
+	}
+
+	g_timeout_add(DRIVE_TIMEOUT_MS, on_timeout, &d);
+	g_main_loop_run(d.loop);
+
+	if (d.ok)
+		printf("AT -> OK in %lld us over %s\n",
+				(long long)(g_get_monotonic_time() - sent), pty_modem_slave(modem));
+	else
+		printf("AT: no OK within %d ms (got %u bytes)\n", DRIVE_TIMEOUT_MS, (unsigned int)d.rx->len);
+
+	vmodem_host_free(host);
+	pty_modem_free(modem);
+	g_string_free(d.rx, TRUE);
+	g_main_loop_unref(d.loop);
+
+	return d.ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <plugin.h>
+#include <hal.h>
+
+#include "tcore_stub.h"
+#include "vmodem_host.h"
+
+struct vmodem_host {
+	char dir[32];
+	char conf[64];
+	char state[64];
+
+	void *handle;
+	const struct tcore_plugin_define_desc *desc;
+	TcorePlugin *plugin;
+	TcoreHal *hal;
+};
+
+static gboolean __write_conf(struct vmodem_host *h, const char *slave, const char *extra_conf)
+{
+	FILE *fp;
+
+	fp = fopen(h->conf, "w");
+	if (!fp)
+		return FALSE;
+
+	fprintf(fp, "[device]\npath=%s\nemulated=true\n\n", slave);
+	fprintf(fp, "[state]\npath=%s\nwarm_restart=false\n\n", h->state);
+	if (extra_conf)
+		fprintf(fp, "%s\n", extra_conf);
+
+	fclose(fp);
+
+	return TRUE;
+}
+
+struct vmodem_host *vmodem_host_new(const char *plugin_path, const char *slave,
+		const char *extra_conf)
+{
+	struct vmodem_host *h;
+
+	if (!plugin_path || !slave)
+		return NULL;
+
+	h = calloc(sizeof(struct vmodem_host), 1);
+	if (!h)
+		return NULL;
+
+	snprintf(h->dir, sizeof(h->dir), "/tmp/vmodem-host.XXXXXX");
+	if (!mkdtemp(h->dir)) {
+		free(h);
+		return NULL;
+	}
+
+	snprintf(h->conf, sizeof(h->conf), "%s/vmodem.conf", h->dir);
+	snprintf(h->state, sizeof(h->state), "%s/vmodem.state", h->dir);
+
+	if (!__write_conf(h, slave, extra_conf))
+		goto fail;
+
+	setenv("VMODEM_CONFIG", h->conf, 1);
+
+	/* stays loaded: the plugin leaves nothing behind that a reload would reset */
+	h->handle = dlopen(plugin_path, RTLD_NOW);
+	if (!h->handle) {
+		fprintf(stderr, "dlopen %s: %s\n", plugin_path, dlerror());
+		goto fail;
+	}
+
+	h->desc = dlsym(h->handle, "plugin_define_desc");
+	if (!h->desc || !h->desc->load()) {
+		fprintf(stderr, "no plugin_define_desc in %s\n", plugin_path);
+		goto fail;
+	}
+
+	h->plugin = tcore_stub_plugin_new(h->desc);
+	if (!h->plugin || !h->desc->init(h->plugin)) {
+		fprintf(stderr, "plugin init failed\n");
+		goto fail;
+	}
+
+	h->hal = tcore_stub_plugin_ref_hal(h->plugin);
+
+	/* a cold init powers the modem but leaves the tcore power state to the server */
+	if (tcore_hal_set_power(h->hal, TRUE) != TCORE_RETURN_SUCCESS) {
+		fprintf(stderr, "power on failed\n");
+		goto fail;
+	}
+
+	return h;
+
+fail:
+	vmodem_host_free(h);
+	return NULL;
+}
+
+void vmodem_host_free(struct vmodem_host *h)
+{
+	if (!h)
+		return;
+
+	tcore_stub_plugin_free(h->plugin);
+
+	unlink(h->state);
+	unlink(h->conf);
+	rmdir(h->dir);
+	free(h);
+}
+
+TcoreHal *vmodem_host_hal(struct vmodem_host *h)
+{
+	return h ? h->hal : NULL;
+}
+
+void *vmodem_host_sym(struct vmodem_host *h, const char *name)
+{
+	if (!h || !h->handle || !name)
+		return NULL;
+
+	return dlsym(h->handle, name);
+}
@@ -0,0 +1,168 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A cached query that times out in the pipeline must not leave its
+ * cache entry filling: the collapsed duplicate gets an answer, and the
+ * next copy of the query goes to the modem and refills the entry.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "vmodem_cache.h"
+#include "vmodem_pipeline.h"
+
+#define TEST_TIMEOUT_MS		50
+#define TEST_GUARD_MS		2000
+
+#define CSQ		"AT+CSQ\r"
+
+struct test {
+	GMainLoop *loop;
+	struct vmodem_pipeline *pipeline;
+	struct vmodem_cache *cache;
+
+	guint kicks;
+	guint emitted;
+	GString *last;
+};
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+static void on_kick(void *user_data)
+{
+	struct test *t = user_data;
+
+	t->kicks++;
+	g_main_loop_quit(t->loop);
+}
+
+static void on_line(void *tag, const char *line, unsigned int len, gboolean final, void *user_data)
+{
+	struct test *t = user_data;
+
+	vmodem_cache_line(t->cache, tag, line, len, final);
+}
+
+static void on_emit(const char *data, unsigned int len, void *user_data)
+{
+	struct test *t = user_data;
+
+	t->emitted++;
+	g_string_assign(t->last, data);
+}
+
+static gboolean on_guard(gpointer data)
+{
+	struct test *t = data;
+
+	g_main_loop_quit(t->loop);
+
+	return FALSE;
+}
+
+static enum vmodem_cache_result __lookup(struct test *t)
+{
+	return vmodem_cache_lookup(t->cache, CSQ, strlen(CSQ),
+			vmodem_pipeline_inflight(t->pipeline) == 0,
+			vmodem_pipeline_tail_tag(t->pipeline));
+}
+
+static void __send(struct test *t)
+{
+	vmodem_pipeline_sent(t->pipeline, CSQ, strlen(CSQ),
+			vmodem_cache_sent(t->cache, CSQ, strlen(CSQ)));
+}
+
+static void __drain_idle(void)
+{
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+}
+
+int main(void)
+{
+	const char *answer = "\r\n+CSQ: 17,99\r\n\r\nOK\r\n";
+	struct test t;
+	guint guard;
+
+	setenv("TCORE_STUB_QUIET", "1", 1);
+
+	memset(&t, 0, sizeof(t));
+	t.loop = g_main_loop_new(NULL, FALSE);
+	t.last = g_string_new(NULL);
+
+	t.pipeline = vmodem_pipeline_new(1, TEST_TIMEOUT_MS, on_kick, &t);
+	t.cache = vmodem_cache_new(on_emit, &t);
+	CHECK(t.pipeline && t.cache);
+
+	vmodem_pipeline_set_line_hook(t.pipeline, on_line);
+	vmodem_cache_set_enabled(t.cache, TRUE);
+
+	/* first query goes out, a duplicate collapses into it */
+	CHECK(__lookup(&t) == VMODEM_CACHE_MISS);
+	__send(&t);
+	CHECK(__lookup(&t) == VMODEM_CACHE_COLLAPSED);
+
+	/* the modem never answers: the window is full until the timeout */
+	CHECK(!vmodem_pipeline_may_send(t.pipeline, FALSE));
+
+	guard = g_timeout_add(TEST_GUARD_MS, on_guard, &t);
+	g_main_loop_run(t.loop);
+	CHECK(t.kicks == 1);
+	g_source_remove(guard);
+
+	/* the collapsed waiter is failed rather than left without an answer */
+	__drain_idle();
+	CHECK(t.emitted == 1);
+	CHECK(strstr(t.last->str, "ERROR") != NULL);
+	CHECK(vmodem_pipeline_inflight(t.pipeline) == 0);
+
+	/* the next query is sent and its answer refills the entry */
+	CHECK(vmodem_pipeline_may_send(t.pipeline, FALSE));
+	CHECK(__lookup(&t) == VMODEM_CACHE_MISS);
+	__send(&t);
+	CHECK(vmodem_pipeline_inflight(t.pipeline) == 1);
+	CHECK(vmodem_pipeline_rx(t.pipeline, answer, strlen(answer)) == 1);
+
+	CHECK(__lookup(&t) == VMODEM_CACHE_HIT);
+	__drain_idle();
+	CHECK(t.emitted == 2);
+	CHECK(strstr(t.last->str, "+CSQ: 17,99") != NULL);
+
+	vmodem_cache_free(t.cache);
+	vmodem_pipeline_free(t.pipeline);
+	g_string_free(t.last, TRUE);
+	g_main_loop_unref(t.loop);
+
+	printf("cache expiry: ok\n");
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * A held RX batch is flushed as soon as it ends in a complete line that
+ * answers nothing: a URC does not wait out the window, a response that
+ * is still streaming in does.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "vmodem_coalesce.h"
+
+#define TEST_WINDOW_MS	1000
+#define TEST_SIZE		1024
+
+#define ENTRY_HEAD	"\r\n+CPBR: 1,\"12"
+#define ENTRY_TAIL	"34\",129,\"Alice\"\r\n"
+#define URC			"\r\n+CREG: 1\r\n"
+
+struct test {
+	GString *delivered;
+	guint deliveries;
+	gboolean held;
+};
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+static void on_deliver(const char *data, unsigned int len, void *user_data)
+{
+	struct test *t = user_data;
+
+	g_string_append_len(t->delivered, data, len);
+	t->deliveries++;
+}
+
+static void on_hold(gboolean hold, gboolean drain, void *user_data)
+{
+	struct test *t = user_data;
+
+	t->held = hold;
+}
+
+int main(void)
+{
+	struct vmodem_coalesce *c;
+	struct test t;
+
+	memset(&t, 0, sizeof(t));
+	t.delivered = g_string_new(NULL);
+
+	c = vmodem_coalesce_new(TEST_WINDOW_MS, TEST_SIZE, on_deliver, on_hold, &t);
+	CHECK(c);
+
+	/* from idle: a complete URC goes out at once */
+	vmodem_coalesce_push(c, URC, strlen(URC), NULL);
+	CHECK(t.deliveries == 1);
+	CHECK(!t.held);
+	CHECK(strcmp(t.delivered->str, URC) == 0);
+	g_string_truncate(t.delivered, 0);
+
+	/* an answer streaming in is held, also once its line is complete */
+	vmodem_coalesce_push(c, ENTRY_HEAD, strlen(ENTRY_HEAD), "+CPBR");
+	CHECK(t.deliveries == 1);
+	CHECK(t.held);
+	vmodem_coalesce_push(c, ENTRY_TAIL, strlen(ENTRY_TAIL), "+CPBR");
+	CHECK(t.deliveries == 1);
+	CHECK(t.held);
+
+	/* a URC landing behind it flushes the batch, answer first */
+	vmodem_coalesce_push(c, URC, strlen(URC), "+CPBR");
+	CHECK(t.deliveries == 2);
+	CHECK(!t.held);
+	CHECK(strcmp(t.delivered->str, ENTRY_HEAD ENTRY_TAIL URC) == 0);
+	g_string_truncate(t.delivered, 0);
+
+	/* a partial URC line still waits for the rest */
+	vmodem_coalesce_push(c, "\r\n+CREG: ", 9, "+CPBR");
+	CHECK(t.deliveries == 2);
+	CHECK(t.held);
+	vmodem_coalesce_push(c, "1\r\n", 3, "+CPBR");
+	CHECK(t.deliveries == 3);
+	CHECK(!t.held);
+
+	vmodem_coalesce_free(c);
+	g_string_free(t.delivered, TRUE);
+
+	printf("coalesce: ok\n");
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * The stub's HAL receive callbacks: one that removes itself, or another
+ * one, from inside the emit must not break the walk, and a removed
+ * callback is not called any more.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <tcore.h>
+#include <hal.h>
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+static int calls_self;
+static int calls_other;
+static int calls_last;
+
+static void on_last(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	calls_last++;
+}
+
+static void on_other(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	calls_other++;
+}
+
+/* removes itself and the callback right after it */
+static void on_self(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data)
+{
+	calls_self++;
+	tcore_hal_remove_recv_callback(hal, on_self);
+	tcore_hal_remove_recv_callback(hal, on_other);
+}
+
+int main(void)
+{
+	TcoreHal *hal;
+
+	hal = tcore_hal_new(NULL, "test", NULL, TCORE_HAL_MODE_CUSTOM);
+	CHECK(hal);
+
+	CHECK(tcore_hal_add_recv_callback(hal, on_self, NULL) == TCORE_RETURN_SUCCESS);
+	CHECK(tcore_hal_add_recv_callback(hal, on_other, NULL) == TCORE_RETURN_SUCCESS);
+	CHECK(tcore_hal_add_recv_callback(hal, on_last, NULL) == TCORE_RETURN_SUCCESS);
+
+	CHECK(tcore_hal_emit_recv_callback(hal, 2, "OK") == TCORE_RETURN_SUCCESS);
+	CHECK(calls_self == 1);
+	CHECK(calls_other == 0);
+	CHECK(calls_last == 1);
+
+	CHECK(tcore_hal_emit_recv_callback(hal, 2, "OK") == TCORE_RETURN_SUCCESS);
+	CHECK(calls_self == 1);
+	CHECK(calls_last == 2);
+
+	tcore_hal_free(hal);
+
+	printf("recv callbacks: ok\n");
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Mailbox backend on an emulated region (vdpram_shm_create_memfd):
+ * both sides attached in one process, each ring wakes only its reader,
+ * wrap-around keeps the bytes in order, a full ring takes what fits,
+ * data left behind keeps the reader awake, and corrupt indices fail.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+
+#include <glib.h>
+
+#include "vdpram_shm.h"
+
+#define TEST_RING	64
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+static gboolean __readable(struct vdpram_shm *shm)
+{
+	struct pollfd pfd;
+
+	pfd.fd = vdpram_shm_fd(shm);
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+int main(void)
+{
+	struct vdpram_shm_header *hdr;
+	struct vdpram_shm *ap;
+	struct vdpram_shm *modem;
+	char out[TEST_RING * 2];
+	char in[TEST_RING * 2];
+	int bells[2];
+	int mem_fd;
+	int i;
+
+	setenv("TCORE_STUB_QUIET", "1", 1);
+
+	CHECK(vdpram_shm_create_memfd(TEST_RING, &mem_fd, bells) == 0);
+
+	/* one node for both directions is refused */
+	CHECK(vdpram_shm_attach(mem_fd, VDPRAM_SHM_SIDE_AP, bells[0], bells[0]) == NULL);
+
+	/* bells[n] rings for ring n: the AP produces ring 0 */
+	ap = vdpram_shm_attach(mem_fd, VDPRAM_SHM_SIDE_AP, bells[0], bells[1]);
+	modem = vdpram_shm_attach(mem_fd, VDPRAM_SHM_SIDE_MODEM, bells[1], bells[0]);
+	CHECK(ap && modem);
+
+	/* a write wakes the peer, never the writer */
+	CHECK(vdpram_shm_write(ap, "AT\r", 3) == 3);
+	CHECK(__readable(modem));
+	CHECK(!__readable(ap));
+
+	CHECK(vdpram_shm_read(modem, in, sizeof(in)) == 3);
+	CHECK(memcmp(in, "AT\r", 3) == 0);
+	CHECK(!__readable(modem));
+
+	CHECK(vdpram_shm_write(modem, "\r\nOK\r\n", 6) == 6);
+	CHECK(__readable(ap));
+	CHECK(!__readable(modem));
+	CHECK(vdpram_shm_read(ap, in, sizeof(in)) == 6);
+	CHECK(memcmp(in, "\r\nOK\r\n", 6) == 0);
+
+	/* across the end of the ring */
+	for (i = 0; i < (int)sizeof(out); i++)
+		out[i] = 'a' + i % 26;
+
+	for (i = 0; i < 4; i++) {
+		CHECK(vdpram_shm_write(ap, out + i, 50) == 50);
+		CHECK(vdpram_shm_read(modem, in, sizeof(in)) == 50);
+		CHECK(memcmp(in, out + i, 50) == 0);
+	}
+
+	/* a full ring takes what fits, then nothing */
+	CHECK(vdpram_shm_write(ap, out, sizeof(out)) == TEST_RING);
+	CHECK(vdpram_shm_write(ap, out, 1) == 0);
+
+	/* data left behind keeps the reader readable, without ringing the writer */
+	CHECK(vdpram_shm_read(modem, in, 10) == 10);
+	CHECK(memcmp(in, out, 10) == 0);
+	CHECK(__readable(modem));
+	CHECK(!__readable(ap));
+	CHECK(vdpram_shm_read(modem, in, sizeof(in)) == TEST_RING - 10);
+	CHECK(memcmp(in, out + 10, TEST_RING - 10) == 0);
+	CHECK(!__readable(modem));
+
+	/* the peer's indices are not trusted */
+	hdr = mmap(NULL, sizeof(*hdr), PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	CHECK(hdr != MAP_FAILED);
+	hdr->ring[1].head = hdr->ring[1].tail + TEST_RING * 4;
+	errno = 0;
+	CHECK(vdpram_shm_read(ap, in, sizeof(in)) < 0 && errno == EPROTO);
+	munmap(hdr, sizeof(*hdr));
+
+	vdpram_shm_detach(modem);
+	vdpram_shm_detach(ap);
+	close(bells[0]);
+	close(bells[1]);
+	close(mem_fd);
+
+	printf("mailbox: ok\n");
+
+	return 0;
+}
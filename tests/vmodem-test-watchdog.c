@@ -0,0 +1,178 @@
+/*
+ * tel-plugin-vmodem
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Junhwan An <jh48.an@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Only answers feed the watchdog: a modem that keeps sending URCs but
+ * answers no command is probed and reported, a final result ends the
+ * deadline, and with commands still outstanding the deadline restarts
+ * from the last answer.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "vmodem_watchdog.h"
+
+#define TEST_DEADLINE_MS	100
+#define TEST_RECOVER_MS		50
+#define TEST_TICK_MS		10
+
+#define URC		"\r\n+CREG: 1\r\n"
+#define FINAL	"\r\nOK\r\n"
+
+struct test {
+	GMainLoop *loop;
+	struct vmodem_watchdog *wd;
+	guint probes;
+	guint stalls;
+	guint ticks;
+	guint answer_at;	/* tick of the answer, 0: URCs only */
+	guint outstanding;	/* still outstanding after that answer */
+	guint answer2_at;
+};
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+static gboolean on_probe(void *user_data)
+{
+	struct test *t = user_data;
+
+	t->probes++;
+	return TRUE;
+}
+
+static void on_stall(void *user_data)
+{
+	struct test *t = user_data;
+
+	t->stalls++;
+	g_main_loop_quit(t->loop);
+}
+
+static const struct vmodem_watchdog_ops ops = {
+	.probe = on_probe,
+	.stall = on_stall,
+};
+
+static void __rx(struct test *t, const char *data)
+{
+	unsigned int len;
+	const char *out;
+
+	/* while the probe is pending, blank lines are dropped */
+	out = vmodem_watchdog_rx(t->wd, data, strlen(data), &len);
+	CHECK(out && len > 0);
+}
+
+/* the modem: a URC every tick, and the scripted answers */
+static gboolean on_tick(gpointer data)
+{
+	struct test *t = data;
+
+	t->ticks++;
+	__rx(t, URC);
+
+	if (t->ticks == t->answer_at) {
+		__rx(t, FINAL);
+		vmodem_watchdog_answered(t->wd, t->outstanding);
+	}
+
+	if (t->ticks == t->answer2_at) {
+		__rx(t, FINAL);
+		vmodem_watchdog_answered(t->wd, 0);
+	}
+
+	if (t->ticks * TEST_TICK_MS >= (TEST_DEADLINE_MS + TEST_RECOVER_MS) * 3) {
+		g_main_loop_quit(t->loop);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void __run(struct test *t, guint commands)
+{
+	guint tick;
+	guint i;
+
+	t->loop = g_main_loop_new(NULL, FALSE);
+	t->wd = vmodem_watchdog_new(TEST_DEADLINE_MS, TEST_RECOVER_MS, &ops, t);
+	CHECK(t->wd);
+
+	for (i = 0; i < commands; i++)
+		vmodem_watchdog_tx(t->wd);
+
+	tick = g_timeout_add(TEST_TICK_MS, on_tick, t);
+	g_main_loop_run(t->loop);
+	if (t->stalls)
+		g_source_remove(tick);
+
+	vmodem_watchdog_free(t->wd);
+	g_main_loop_unref(t->loop);
+}
+
+int main(void)
+{
+	struct test t;
+
+	/* URCs only: probed, then reported */
+	memset(&t, 0, sizeof(t));
+	__run(&t, 1);
+	CHECK(t.probes == 1);
+	CHECK(t.stalls == 1);
+
+	/* answered within the deadline */
+	memset(&t, 0, sizeof(t));
+	t.answer_at = 2;
+	__run(&t, 1);
+	CHECK(t.probes == 0);
+	CHECK(t.stalls == 0);
+
+	/* two in flight, answered at 40 and 120 ms: the deadline restarted at 40 */
+	memset(&t, 0, sizeof(t));
+	t.answer_at = 4;
+	t.outstanding = 1;
+	t.answer2_at = 12;
+	__run(&t, 2);
+	CHECK(t.probes == 0);
+	CHECK(t.stalls == 0);
+
+	/* the second one is never answered: probed, then reported */
+	memset(&t, 0, sizeof(t));
+	t.answer_at = 4;
+	t.outstanding = 1;
+	__run(&t, 2);
+	CHECK(t.probes == 1);
+	CHECK(t.stalls == 1);
+
+	printf("watchdog: ok\n");
+
+	return 0;
+}